@@ -0,0 +1,120 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "BenchmarkUtils.h"
+#include "SoundplaneModelA.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
+// count every allocation in the program, so that allocations in the hot path show up.
+
+static std::atomic<uint64_t> gAllocationCount{0};
+
+void* operator new(std::size_t size)
+{
+	gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	void* p = std::malloc(size ? size : 1);
+	if(!p) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](std::size_t size)
+{
+	gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	void* p = std::malloc(size ? size : 1);
+	if(!p) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+uint64_t getAllocationCount()
+{
+	return gAllocationCount.load(std::memory_order_relaxed);
+}
+
+// --------------------------------------------------------------------------------
+#pragma mark synthetic input
+
+const float kSyntheticTouchRadius = 1.5f;
+const float kSyntheticTouchPressure = 0.25f;
+
+void addSyntheticTouch(SensorFrame& frame, float cx, float cy, float z)
+{
+	const float r2max = 4.f*kSyntheticTouchRadius*kSyntheticTouchRadius;
+	for(int j = 0; j < SensorGeometry::height; ++j)
+	{
+		for(int i = 0; i < SensorGeometry::width; ++i)
+		{
+			float dx = i - cx;
+			float dy = j - cy;
+			float r2 = dx*dx + dy*dy;
+			if(r2 < r2max)
+			{
+				float p = z*expf(-r2/(2.f*kSyntheticTouchRadius*kSyntheticTouchRadius));
+				frame[j*SensorGeometry::width + i] += kSyntheticRestValue*p;
+			}
+		}
+	}
+}
+
+SensorFrame makeSyntheticFrame(int frameIdx, int touches)
+{
+	SensorFrame out;
+	out.fill(kSyntheticRestValue);
+
+	// touches on a grid of 8 columns and 2 rows, each moving on a small circle.
+	const float columnSpacing = SensorGeometry::width/8.f;
+	const float rowSpacing = SensorGeometry::height/2.f;
+	const float twoPi = 6.2831853f;
+
+	for(int t = 0; t < touches; ++t)
+	{
+		float phase = twoPi*(frameIdx*(0.25f + 0.05f*t)/1000.f + t/16.f);
+		float cx = (t%8 + 0.5f)*columnSpacing + 1.5f*cosf(phase);
+		float cy = ((t/8)%2 + 0.5f)*rowSpacing + 0.5f*sinf(phase);
+		float z = kSyntheticTouchPressure*(0.75f + 0.25f*sinf(phase*3.f));
+		addSyntheticTouch(out, cx, cy, z);
+	}
+	return out;
+}
+
+SensorFrame makeSyntheticCalibrationMean()
+{
+	SensorFrame mean;
+	mean.fill(kSyntheticRestValue);
+	return mean;
+}
+
+// --------------------------------------------------------------------------------
+#pragma mark recordings
+
+SensorFrame getRecordingCalibrationMean(const SoundplaneReplayDriver& replay)
+{
+	if(replay.hasCalibration()) return replay.getCalibrationMean();
+
+	SensorFrame sum{};
+	size_t n = std::min(replay.getFrameCount(), (size_t)kSoundplaneCalibrateSize);
+	for(size_t i = 0; i < n; ++i)
+	{
+		const SensorRecordingFrame& r = replay.getFrameRecord(i);
+		for(int k = 0; k < SensorGeometry::elements; ++k)
+		{
+			sum[k] += r.data[k];
+		}
+	}
+	return multiply(sum, n ? 1.f/n : 0.f);
+}
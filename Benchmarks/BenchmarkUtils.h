@@ -0,0 +1,70 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <stdint.h>
+
+#include "SensorFrame.h"
+#include "SoundplaneReplayDriver.h"
+
+// shared helpers for the headless runner and benchmarks.
+
+// number of calls to operator new since the program started.
+uint64_t getAllocationCount();
+
+inline int64_t benchmarkNanos()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the raw sensor value at rest used for synthetic input.
+const float kSyntheticRestValue = 0.5f;
+
+// a raw sensor frame with the given number of touches, each a round bump of pressure moving
+// slowly on its own circle. Touches are spread over the surface so that they stay apart.
+// Calibrated with a mean of kSyntheticRestValue everywhere, the pressure of each touch
+// peaks between about 0.125 and 0.25, a moderate finger pressure.
+SensorFrame makeSyntheticFrame(int frameIdx, int touches);
+
+// add a touch to a raw frame made by makeSyntheticFrame(), centered at sensor position x, y
+// with pressure z.
+void addSyntheticTouch(SensorFrame& frame, float x, float y, float z);
+
+// a calibration mean matching makeSyntheticFrame().
+SensorFrame makeSyntheticCalibrationMean();
+
+// a listener for the replay driver, which is only used here to read recordings.
+class NullDriverListener : public SoundplaneDriverListener
+{
+public:
+	void onStartup() override {}
+	void onFrame(const SensorFrame& frame) override {}
+	void onError(int error, const char* errStr) override {}
+	void onClose() override {}
+};
+
+// the calibration mean of a recording: the one stored with it, or else the mean of the
+// first frames, as calibration would make it.
+SensorFrame getRecordingCalibrationMean(const SoundplaneReplayDriver& replay);
+
+// accumulates the time taken by one stage of a pipeline.
+struct StageTimer
+{
+	const char* name;
+	int64_t totalNanos{0};
+	int64_t maxNanos{0};
+	uint64_t count{0};
+
+	void add(int64_t nanos)
+	{
+		totalNanos += nanos;
+		if(nanos > maxNanos) maxNanos = nanos;
+		count++;
+	}
+
+	double meanNanos() const { return count ? (double)totalNanos/count : 0.; }
+};
@@ -0,0 +1,1237 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// soundplane-bench: times each hot function of the 1 kHz loop on fixed inputs, at 1, 4
+// and 16 active touches, then the touch finders and process() in their worst cases, and
+// prints ns/call and allocations/call. soundplane-bench-32 and soundplane-bench-64 are built
+// with those touch capacities, and also time each function at the capacity.
+//
+// usage: soundplane-bench [-iterations n] [-recording file] [name filter]
+//
+// The inputs are made once from synthetic frames run through the tracker until its filters
+// have settled, then cycled, so that every run of a case sees exactly the same data.
+// MIDI output has no device open, so its messages are made and dropped. OSC is sent to
+// the default port on localhost. Before timing, the peak kernels are checked against a
+// brute-force reference, and the program fails if they differ. The note-on latency of the
+// onset detector and the lag and overshoot of touch prediction are measured on the recording
+// if one is given. The time the process thread takes to publish the view signals is measured
+// while views read them, with every core kept busy.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <bitset>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+
+#include "TouchTracker.h"
+#include "SensorFrameKernels.h"
+#include "Zone.h"
+#include "ZoneSet.h"
+#include "SoundplaneMIDIOutput.h"
+#include "SoundplaneOSCOutput.h"
+#include "SoundplaneBinaryData.h"
+#include "SensorFramePool.h"
+#include "SignalPublisher.h"
+#include "TouchHistory.h"
+#include "LatencyHistogram.h"
+#include "ThreadUtility.h"
+#include "BenchmarkUtils.h"
+
+// results are added here so that the compiler can't remove the work.
+volatile float gBenchmarkSink;
+
+const int kBenchmarkFrames = 64;
+const int kBenchmarkSettleFrames = 500;
+const int kBenchmarkBatches = 5;
+const int kBenchmarkTouchCounts[] = {1, 4, 16};
+const float kBenchmarkTileThreshold = 0.0001f;
+
+struct BenchmarkOptions
+{
+	int iterations{20000};
+	std::string filter;
+	std::string recordingPath;
+};
+
+// run the body in batches after a warmup, and print the best mean time per call.
+template< typename F >
+void runBenchmark(const BenchmarkOptions& opts, const char* name, int touches, F body)
+{
+	if(!opts.filter.empty() && (std::string(name).find(opts.filter) == std::string::npos)) return;
+
+	for(int i = 0; i < opts.iterations/10; ++i)
+	{
+		body(i);
+	}
+
+	double bestNanos = 1e30;
+	uint64_t allocations = 0;
+	for(int b = 0; b < kBenchmarkBatches; ++b)
+	{
+		uint64_t startAllocations = getAllocationCount();
+		int64_t startTime = benchmarkNanos();
+		for(int i = 0; i < opts.iterations; ++i)
+		{
+			body(i);
+		}
+		int64_t elapsed = benchmarkNanos() - startTime;
+		allocations += getAllocationCount() - startAllocations;
+		bestNanos = std::min(bestNanos, (double)elapsed/opts.iterations);
+	}
+	printf("%-36s %8d %12.1f %12.3f\n", name, touches, bestNanos, (double)allocations/(kBenchmarkBatches*opts.iterations));
+}
+
+// the geometry of a surface known only at run time, as the tracker had before it was a
+// template over its traits. Read from volatiles so the compiler can't make them constants.
+volatile int gGenericWidth = SoundplaneATrackerTraits::width;
+volatile int gGenericHeight = SoundplaneATrackerTraits::height;
+volatile int gGenericPassesX = SoundplaneATrackerTraits::smoothPassesX;
+volatile int gGenericPassesY = SoundplaneATrackerTraits::smoothPassesY;
+
+struct GenericGeometry
+{
+	int width{gGenericWidth};
+	int height{gGenericHeight};
+	int passesX{gGenericPassesX};
+	int passesY{gGenericPassesY};
+};
+
+// the scalar smoothing kernel with all loop bounds and edges found at run time, for comparison
+// with SensorFrameKernels::scalar. a and b are workspaces of width*height floats.
+void smoothPressureGeneric(const GenericGeometry& g, const float* pIn, float* pZ1, float k, float* pOut, float* a, float* b)
+{
+	const int w = g.width;
+	const int h = g.height;
+	const float k1 = 1.f - k;
+	for(int n = 0; n < w*h; ++n)
+	{
+		float y = pIn[n]*k + pZ1[n]*k1;
+		pZ1[n] = y;
+		a[n] = std::max(y, 0.f);
+	}
+	for(int p = 0; p < g.passesX; ++p)
+	{
+		for(int j = 0; j < h; ++j)
+		{
+			const float* r = a + j*w;
+			float* o = b + j*w;
+			for(int i = 0; i < w; ++i)
+			{
+				o[i] = (i > 0 ? r[i - 1] : -0.f) + r[i] + (i < w - 1 ? r[i + 1] : -0.f);
+			}
+		}
+		std::swap(a, b);
+	}
+	for(int p = 0; p < g.passesY; ++p)
+	{
+		for(int j = 0; j < h; ++j)
+		{
+			for(int i = 0; i < w; ++i)
+			{
+				b[j*w + i] = (j > 0 ? a[(j - 1)*w + i] : -0.f) + a[j*w + i] + (j < h - 1 ? a[(j + 1)*w + i] : -0.f);
+			}
+		}
+		std::swap(a, b);
+	}
+	for(int n = 0; n < w*h; ++n)
+	{
+		pOut[n] = a[n]*(1.f/64.f);
+	}
+}
+
+// an output that keeps the touches sent to it, to make inputs for the real outputs.
+class CaptureOutput : public SoundplaneOutput
+{
+public:
+	void beginOutputFrame(time_point<system_clock> now) override { mTouches = TouchArray{}; }
+	void processTouch(int i, int offset, const Touch& m) override { mTouches[i] = m; mOffsets[i] = offset; }
+	void processController(int z, int offset, const ZoneMessage& m) override {}
+	void endOutputFrame() override {}
+	void clear() override {}
+
+	TouchArray mTouches{};
+	std::array< int, kMaxTouches > mOffsets{};
+};
+
+// the input of each stage, for each of kBenchmarkFrames consecutive frames.
+struct BenchmarkInputs
+{
+	std::vector< SensorFrame > raw;
+	std::vector< SensorFrame > calibrated;
+	std::vector< SensorFrame > curvature;
+	std::vector< TouchArray > found;
+	std::vector< TouchFrame > match1;
+	std::vector< TouchFrame > matched;
+	std::vector< TouchFrame > filteredXY;
+	std::vector< TouchFrame > touches2;
+	std::vector< TouchArray > tracked;
+	std::vector< CaptureOutput > zoneOutputs;
+};
+
+class TouchTrackerBenchmark
+{
+public:
+	static void setupTracker(TouchTracker& t, int touches)
+	{
+		t.setThresh(0.05f);
+		t.setLopassZ(100.f);
+		t.setMaxTouches(touches);
+	}
+
+	static BenchmarkInputs makeInputs(int touches)
+	{
+		BenchmarkInputs in;
+		TouchTracker tracker;
+		setupTracker(tracker, touches);
+		ZoneSet zones;
+		zones.loadFromString(SoundplaneBinaryData::chromatic_json);
+
+		SensorFrame meanInv = divide(fill(1.f), makeSyntheticCalibrationMean());
+		for(int f = 0; f < kBenchmarkSettleFrames + kBenchmarkFrames; ++f)
+		{
+			SensorFrame raw = makeSyntheticFrame(f, touches);
+			SensorFrame calibrated = subtract(multiply(raw, meanInv), 1.0f);
+			SensorFrame curvature = tracker.preprocess(calibrated);
+
+			// the stages of process(), which change nothing in the tracker, then process() itself.
+			const TouchFrame& match1 = tracker.mTouchesMatch[tracker.mMatchIdx];
+			TouchArray found;
+			TouchFrame matched;
+			tracker.findTouches(curvature, found);
+			tracker.matchTouches(found, match1, matched);
+			TouchFrame filteredXY = matched;
+			tracker.filterTouchesXYAdaptive(filteredXY, match1);
+			if(f >= kBenchmarkSettleFrames)
+			{
+				in.raw.push_back(raw);
+				in.calibrated.push_back(calibrated);
+				in.curvature.push_back(curvature);
+				in.found.push_back(found);
+				in.match1.push_back(match1);
+				in.matched.push_back(matched);
+				in.filteredXY.push_back(filteredXY);
+				in.touches2.push_back(tracker.mTouchesZ[tracker.mZIdx]);
+			}
+
+			TouchArray tracked = scaleTouchPressure(tracker.process(curvature, touches), 1.f, 0.5f);
+			zones.processTouches(tracked, 0.5f);
+			if(f >= kBenchmarkSettleFrames)
+			{
+				CaptureOutput capture;
+				capture.beginOutputFrame(system_clock::now());
+				zones.sendToOutput(capture);
+				in.tracked.push_back(tracked);
+				in.zoneOutputs.push_back(capture);
+			}
+		}
+		return in;
+	}
+
+	static void run(const BenchmarkOptions& opts, int touches)
+	{
+		const BenchmarkInputs in = makeInputs(touches);
+		const int m = kBenchmarkFrames - 1;
+
+		runBenchmark(opts, "smoothPressureX", touches, [&](int i)
+		{
+			gBenchmarkSink = gBenchmarkSink + smoothPressureX(in.calibrated[i & m])[i & m];
+		});
+
+		runBenchmark(opts, "smoothPressureY", touches, [&](int i)
+		{
+			gBenchmarkSink = gBenchmarkSink + smoothPressureY(in.calibrated[i & m])[i & m];
+		});
+
+		SensorFrame inputZ1{}, smoothed;
+		runBenchmark(opts, "smoothPressureFused", touches, [&](int i)
+		{
+			smoothPressureFused(in.calibrated[i & m], inputZ1, 0.25f, smoothed);
+			gBenchmarkSink = gBenchmarkSink + smoothed[i & m];
+		});
+
+		// the same smoothing with the geometry known at compile time and at run time.
+		typedef SoundplaneATrackerTraits T;
+		runBenchmark(opts, "smoothing scalar, traits geometry", touches, [&](int i)
+		{
+			SensorFrameKernels::scalar::calibrateAndSmoothPressure< T::width, T::height, T::smoothPassesX, T::smoothPassesY >
+				(in.calibrated[i & m], nullptr, nullptr, inputZ1, 0.25f, smoothed);
+			gBenchmarkSink = gBenchmarkSink + smoothed[i & m];
+		});
+
+		GenericGeometry g;
+		SensorFrame genericA, genericB;
+		runBenchmark(opts, "smoothing scalar, runtime geometry", touches, [&](int i)
+		{
+			smoothPressureGeneric(g, in.calibrated[i & m].data(), inputZ1.data(), 0.25f, smoothed.data(), genericA.data(), genericB.data());
+			gBenchmarkSink = gBenchmarkSink + smoothed[i & m];
+		});
+
+		TouchTracker tracker;
+		setupTracker(tracker, touches);
+
+		runBenchmark(opts, "TouchTracker::preprocess", touches, [&](int i)
+		{
+			gBenchmarkSink = gBenchmarkSink + tracker.preprocess(in.calibrated[i & m])[i & m];
+		});
+
+		SensorFrame calibrated;
+		tracker.setCalibration(makeSyntheticCalibrationMean());
+		runBenchmark(opts, "TouchTracker::preprocessRaw", touches, [&](int i)
+		{
+			gBenchmarkSink = gBenchmarkSink + tracker.preprocessRaw(in.raw[i & m], &calibrated)[i & m];
+		});
+
+		// as the Model does when no view shows the calibrated frame and the matrix is not sent.
+		runBenchmark(opts, "TouchTracker::preprocessRaw (no copy)", touches, [&](int i)
+		{
+			gBenchmarkSink = gBenchmarkSink + tracker.preprocessRaw(in.raw[i & m])[i & m];
+		});
+
+		// with tiles, moving touches keep some tiles dirty, and the rest are skipped.
+		TouchTracker tiledTracker;
+		setupTracker(tiledTracker, touches);
+		tiledTracker.setCalibration(makeSyntheticCalibrationMean());
+		tiledTracker.setTileThreshold(kBenchmarkTileThreshold);
+		runBenchmark(opts, "TouchTracker::preprocessRaw (tiles)", touches, [&](int i)
+		{
+			gBenchmarkSink = gBenchmarkSink + tiledTracker.preprocessRaw(in.raw[i & m], &calibrated)[i & m];
+		});
+
+		TouchArray out;
+		runBenchmark(opts, "TouchTracker::findTouches", touches, [&](int i)
+		{
+			tracker.findTouches(in.curvature[i & m], out);
+			gBenchmarkSink = gBenchmarkSink + out[0].z;
+		});
+
+		runBenchmark(opts, "TouchTracker::findTouchesBlobs", touches, [&](int i)
+		{
+			tracker.findTouchesBlobs(in.curvature[i & m], out);
+			gBenchmarkSink = gBenchmarkSink + out[0].z;
+		});
+
+		TouchFrame outFrame;
+		runBenchmark(opts, "TouchTracker::matchTouches", touches, [&](int i)
+		{
+			tracker.matchTouches(in.found[i & m], in.match1[i & m], outFrame);
+			gBenchmarkSink = gBenchmarkSink + outFrame.z[0];
+		});
+
+		runBenchmark(opts, "TouchTracker::matchTouchesOptimal", touches, [&](int i)
+		{
+			tracker.matchTouchesOptimal(in.found[i & m], in.match1[i & m], outFrame);
+			gBenchmarkSink = gBenchmarkSink + outFrame.z[0];
+		});
+
+		// filtered in place, over and over. The positions converge on the previous frame's,
+		// but the ages that decide the work done stay the same.
+		std::vector< TouchFrame > filteredXY = in.matched;
+		runBenchmark(opts, "TouchTracker::filterTouchesXYAdaptive", touches, [&](int i)
+		{
+			tracker.filterTouchesXYAdaptive(filteredXY[i & m], in.match1[i & m]);
+			gBenchmarkSink = gBenchmarkSink + filteredXY[i & m].x[0];
+		});
+
+		runBenchmark(opts, "TouchTracker::filterTouchesZ", touches, [&](int i)
+		{
+			tracker.filterTouchesZ(in.filteredXY[i & m], in.touches2[i & m], outFrame);
+			gBenchmarkSink = gBenchmarkSink + outFrame.z[0];
+		});
+
+		// the xy and z filters and exiling in one pass, as process() runs them.
+		std::vector< TouchFrame > filtered = in.matched;
+		runBenchmark(opts, "TouchTracker::filterTouches", touches, [&](int i)
+		{
+			tracker.filterTouches(filtered[i & m], in.match1[i & m], in.touches2[i & m], outFrame);
+			gBenchmarkSink = gBenchmarkSink + outFrame.z[0];
+		});
+
+		runBenchmark(opts, "TouchTracker::clampAndScaleTouches", touches, [&](int i)
+		{
+			tracker.clampAndScaleTouches(in.touches2[i & m], out);
+			gBenchmarkSink = gBenchmarkSink + out[0].z;
+		});
+
+		TouchTracker predictor;
+		setupTracker(predictor, touches);
+		predictor.setPredictTime(10.f);
+		runBenchmark(opts, "TouchTracker::predictTouches", touches, [&](int i)
+		{
+			predictor.predictTouches(in.touches2[i & m], outFrame);
+			gBenchmarkSink = gBenchmarkSink + outFrame.x[0];
+		});
+
+		runBenchmark(opts, "scaleTouchPressure", touches, [&](int i)
+		{
+			gBenchmarkSink = gBenchmarkSink + scaleTouchPressure(in.tracked[i & m], 1.f, 0.5f)[0].z;
+		});
+
+		runBenchmark(opts, "TouchTracker::process", touches, [&](int i)
+		{
+			gBenchmarkSink = gBenchmarkSink + tracker.process(in.curvature[i & m], touches)[0].z;
+		});
+
+		// a zone over the whole surface, holding the same touches for two frames so that
+		// every active touch is continuing.
+		Zone zone;
+		zone.setBounds(MLRect(0, 0, kSoundplaneAKeyWidth, kSoundplaneAKeyHeight));
+		for(int f = 0; f < 2; ++f)
+		{
+			zone.newFrame();
+			for(int j = 0; j < kMaxTouches; ++j)
+			{
+				Touch t = in.tracked[0][j];
+				if(touchIsActive(t))
+				{
+					t.kx = (int)t.x;
+					t.ky = (int)t.y;
+					zone.addTouchToFrame(j, t);
+				}
+			}
+			zone.storeAnyNewTouches();
+		}
+		const std::bitset<kMaxTouches> freedTouches;
+		runBenchmark(opts, "Zone::processTouchesNoteRow", touches, [&](int i)
+		{
+			zone.processTouchesNoteRow(freedTouches);
+		});
+
+		auto sendFrame = [&](SoundplaneOutput& output, int i)
+		{
+			const CaptureOutput& c = in.zoneOutputs[i & m];
+			output.beginOutputFrame(system_clock::now());
+			for(int j = 0; j < kMaxTouches; ++j)
+			{
+				if(touchIsActive(c.mTouches[j]))
+				{
+					output.processTouch(j, c.mOffsets[j], c.mTouches[j]);
+				}
+			}
+			output.endOutputFrame();
+		};
+
+		SoundplaneMIDIOutput midiOutput;
+		midiOutput.setMPE(true);
+		midiOutput.setMaxTouches(touches);
+		midiOutput.setActive(true);
+		runBenchmark(opts, "SoundplaneMIDIOutput (null sink)", touches, [&](int i)
+		{
+			sendFrame(midiOutput, i);
+		});
+
+		// sendFrame() is private, and is what endOutputFrame() does when not in Kyma mode.
+		SoundplaneOSCOutput oscOutput;
+		oscOutput.setHostName(kDefaultHostnameString);
+		oscOutput.setPort(kDefaultUDPPort);
+		oscOutput.setMaxTouches(touches);
+		oscOutput.reconnect();
+		if(oscOutput.isActive())
+		{
+			runBenchmark(opts, "SoundplaneOSCOutput (loopback)", touches, [&](int i)
+			{
+				sendFrame(oscOutput, i);
+			});
+		}
+	}
+
+	// the worst cases for the touch finders and process(): a forearm over the whole surface,
+	// and the most peaks the surface can have, rising in z so that each one found is the
+	// strongest so far.
+	static void runWorstCase(const BenchmarkOptions& opts)
+	{
+		typedef SoundplaneATrackerTraits T;
+		TouchTracker tracker;
+		setupTracker(tracker, kMaxTouches);
+		tracker.setCalibration(makeSyntheticCalibrationMean());
+
+		SensorFrame forearm = makeSyntheticFrame(0, 0);
+		for(float y = 0.5f; y < T::height; y += 1.5f)
+		{
+			for(float x = 0.5f; x < T::width; x += 1.5f)
+			{
+				addSyntheticTouch(forearm, x, y, 0.2f);
+			}
+		}
+		SensorFrame forearmCurvature;
+		for(int f = 0; f < kBenchmarkSettleFrames; ++f)
+		{
+			forearmCurvature = tracker.preprocessRaw(forearm);
+		}
+
+		SensorFrame peakGrid{};
+		int nPeaks = 0;
+		for(int j = 0; j < T::height; j += 2)
+		{
+			for(int i = 1; i < T::width - 1; i += 2)
+			{
+				peakGrid[j*T::width + i] = 0.1f + 0.001f*nPeaks++;
+			}
+		}
+
+		TouchArray out;
+		runBenchmark(opts, "TouchTracker::findTouches (peak grid)", kMaxTouches, [&](int i)
+		{
+			tracker.findTouches(peakGrid, out);
+			gBenchmarkSink = gBenchmarkSink + out[0].z;
+		});
+
+		runBenchmark(opts, "TouchTracker::findTouchesBlobs (grid)", kMaxTouches, [&](int i)
+		{
+			tracker.findTouchesBlobs(peakGrid, out);
+			gBenchmarkSink = gBenchmarkSink + out[0].z;
+		});
+
+		runBenchmark(opts, "TouchTracker::process (peak grid)", kMaxTouches, [&](int i)
+		{
+			gBenchmarkSink = gBenchmarkSink + tracker.process(peakGrid, kMaxTouches)[0].z;
+		});
+
+		runBenchmark(opts, "TouchTracker::process (forearm)", kMaxTouches, [&](int i)
+		{
+			gBenchmarkSink = gBenchmarkSink + tracker.process(forearmCurvature, kMaxTouches)[0].z;
+		});
+	}
+
+	// the lag and overshoot of touch prediction, for a range of predict times. Each output
+	// touch is compared with the matched touch in its slot before any filtering. Lag is the
+	// delay of the output that best fits the matched positions, and overshoot is how far the
+	// output goes past the range the matched touch covers within kWindow frames either side.
+	// The input is the recording if there is one, otherwise three touches sliding with vibrato.
+	static void printPredictionTradeoff(const std::string& recordingPath)
+	{
+		const int kMaxFrames = 60000;
+		const int kMinShift = -20;
+		const int kMaxShift = 60;
+		const int kWindow = 30;
+		const float kPredictTimes[] = {0.f, 5.f, 10.f, 20.f, 40.f};
+		const float kNaN = std::numeric_limits<float>::quiet_NaN();
+		const float twoPi = 6.2831853f;
+
+		NullDriverListener listener;
+		std::unique_ptr< SoundplaneReplayDriver > pReplay;
+		SensorFrame calibrateMean = makeSyntheticCalibrationMean();
+		int frames = 20000;
+		if(!recordingPath.empty())
+		{
+			pReplay = std::unique_ptr< SoundplaneReplayDriver >(new SoundplaneReplayDriver(listener, recordingPath, false));
+			if(!pReplay->isOpen() || !pReplay->getFrameCount())
+			{
+				printf("could not read recording %s\n\n", recordingPath.c_str());
+				return;
+			}
+			calibrateMean = getRecordingCalibrationMean(*pReplay);
+			frames = std::min((int)pReplay->getFrameCount(), kMaxFrames);
+		}
+
+		auto makeFrame = [&](int f)
+		{
+			SensorFrame frame = makeSyntheticFrame(0, 0);
+			if(pReplay)
+			{
+				const SensorRecordingFrame& r = pReplay->getFrameRecord(f);
+				std::copy(r.data, r.data + SensorGeometry::elements, frame.begin());
+			}
+			else
+			{
+				const float t = f*0.001f;
+				for(int k = 0; k < 3; ++k)
+				{
+					float x = 16.f + 16.f*k + 6.f*sinf(twoPi*0.5f*t + k) + 0.5f*sinf(twoPi*5.f*t);
+					float z = 0.2f + 0.05f*sinf(twoPi*t + k);
+					addSyntheticTouch(frame, x, 1.f + 2.5f*k, z);
+				}
+			}
+			return frame;
+		};
+
+		// the shift of out against ref with the least mean squared difference.
+		typedef std::vector< std::array<float, kMaxTouches> > SlotTracks;
+		auto bestShift = [&](const SlotTracks& ref, const SlotTracks& out)
+		{
+			int best = 0;
+			double bestError = std::numeric_limits<double>::max();
+			for(int d = kMinShift; d <= kMaxShift; ++d)
+			{
+				double sum = 0.;
+				int n = 0;
+				for(int f = std::max(0, d); f < std::min(frames, frames + d); ++f)
+				{
+					for(int i = 0; i < kMaxTouches; ++i)
+					{
+						float e = out[f][i] - ref[f - d][i];
+						if(e == e)
+						{
+							sum += e*e;
+							n++;
+						}
+					}
+				}
+				if(n && (sum/n < bestError))
+				{
+					bestError = sum/n;
+					best = d;
+				}
+			}
+			return best;
+		};
+
+		printf("touch prediction on %s, against matched touches:\n", pReplay ? recordingPath.c_str() : "synthetic vibrato");
+		printf("%12s %12s %12s %12s %12s\n", "predict ms", "x lag ms", "x over mean", "x over max", "z lag ms");
+		for(float predictTime : kPredictTimes)
+		{
+			TouchTracker tracker;
+			setupTracker(tracker, kMaxTouches);
+			tracker.setCalibration(clamp(calibrateMean, 0.0001f, 1.f));
+			tracker.setPredictTime(predictTime);
+
+			// the tracks of each slot, NaN where the output touch is not continuing.
+			std::array<float, kMaxTouches> none;
+			none.fill(kNaN);
+			SlotTracks refX(frames, none), outX(frames, none), refZ(frames, none), outZ(frames, none);
+			for(int f = 0; f < frames; ++f)
+			{
+				const SensorFrame& curvature = tracker.preprocessRaw(makeFrame(f));
+				TouchArray found;
+				TouchFrame matched;
+				tracker.findTouches(curvature, found);
+				tracker.matchTouches(found, tracker.mTouchesMatch[tracker.mMatchIdx], matched);
+				const TouchArray& t = tracker.process(curvature, kMaxTouches);
+				for(int i = 0; i < kMaxTouches; ++i)
+				{
+					if(t[i].state == kTouchStateContinue)
+					{
+						refX[f][i] = matched.x[i];
+						outX[f][i] = t[i].x;
+
+						// the output scaling of clampAndScaleTouches(), without the clamp.
+						refZ[f][i] = (matched.z[i] - tracker.mOnThreshold)*4.f;
+						outZ[f][i] = t[i].z;
+					}
+				}
+			}
+
+			double overSum = 0.;
+			float overMax = 0.f;
+			int overCount = 0;
+			for(int f = 0; f < frames; ++f)
+			{
+				for(int i = 0; i < kMaxTouches; ++i)
+				{
+					if(outX[f][i] != outX[f][i]) continue;
+					float lo = std::numeric_limits<float>::max();
+					float hi = -lo;
+					for(int g = std::max(0, f - kWindow); g < std::min(frames, f + kWindow + 1); ++g)
+					{
+						if(refX[g][i] == refX[g][i])
+						{
+							lo = std::min(lo, refX[g][i]);
+							hi = std::max(hi, refX[g][i]);
+						}
+					}
+					float over = std::max(0.f, std::max(outX[f][i] - hi, lo - outX[f][i]));
+					overSum += over;
+					overMax = std::max(overMax, over);
+					overCount++;
+				}
+			}
+
+			printf("%12.0f %12d %12.4f %12.4f %12d\n", predictTime, bestShift(refX, outX),
+				overCount ? overSum/overCount : 0., overMax, bestShift(refZ, outZ));
+		}
+		printf("\n");
+	}
+};
+
+// the accuracy of each touch finder on chords of nearby keys in one row. Each chord is held
+// still until the tracker has settled, then the touches found are compared with the keys.
+// prints the fraction of chords with the right number of touches, and the mean distance in
+// keys from each key to the nearest touch.
+void printChordAccuracy()
+{
+	typedef SoundplaneATrackerTraits T;
+	const int kSettleFrames = 300;
+	const float sensorY = 3.5f;
+	const float keyToSensorX = (T::sensorMaxX - T::sensorMinX)/(T::keyMaxX - T::keyMinX);
+
+	struct Chord
+	{
+		const char* name;
+		int keys;
+		int spacing;
+	};
+	const Chord chords[] = {{"1 key", 1, 1}, {"2 adjacent keys", 2, 1}, {"3 adjacent keys", 3, 1}, {"2 keys, 1 apart", 2, 2}, {"3 keys, 1 apart", 3, 2}};
+	const TouchFinder finders[] = {kFindPeaks, kFindBlobs};
+
+	printf("chord accuracy: right number of touches, mean x error in keys\n");
+	printf("%-20s %20s %20s\n", "chord", "peaks", "blobs");
+	for(const Chord& chord : chords)
+	{
+		printf("%-20s", chord.name);
+		for(TouchFinder finder : finders)
+		{
+			int chordsRight = 0;
+			int nChords = 0;
+			float errorSum = 0.f;
+			int nErrors = 0;
+
+			// each chord at a range of positions, on and between key centers.
+			for(float firstKey = 4.5f; firstKey < 20.f; firstKey += 0.75f)
+			{
+				SensorFrame frame = makeSyntheticFrame(0, 0);
+				std::array<float, 3> keyX;
+				for(int k = 0; k < chord.keys; ++k)
+				{
+					keyX[k] = firstKey + k*chord.spacing;
+					addSyntheticTouch(frame, T::sensorMinX + (keyX[k] - T::keyMinX)*keyToSensorX, sensorY, 0.2f);
+				}
+
+				TouchTracker tracker;
+				tracker.setThresh(0.05f);
+				tracker.setLopassZ(100.f);
+				tracker.setTouchFinder(finder);
+				tracker.setCalibration(makeSyntheticCalibrationMean());
+				TouchArray t{};
+				for(int f = 0; f < kSettleFrames; ++f)
+				{
+					t = tracker.process(tracker.preprocessRaw(frame), kMaxTouches);
+				}
+
+				int active = 0;
+				for(const Touch& touch : t)
+				{
+					active += touchIsActive(touch);
+				}
+				chordsRight += (active == chord.keys);
+				nChords++;
+
+				for(int k = 0; k < chord.keys; ++k)
+				{
+					float minDist = 1e6f;
+					for(const Touch& touch : t)
+					{
+						if(touchIsActive(touch)) minDist = std::min(minDist, fabsf(touch.x - keyX[k]));
+					}
+					if(active)
+					{
+						errorSum += minDist;
+						nErrors++;
+					}
+				}
+			}
+			printf(" %10.0f%% %8.3f", 100.f*chordsRight/nChords, nErrors ? errorSum/nErrors : 0.f);
+		}
+		printf("\n");
+	}
+	printf("\n");
+}
+
+// identity swaps made by each matcher, on touches gliding past each other in neighboring
+// rows, each put down and lifted at its own times. A swap is a frame where a touch that is
+// being tracked moves to another output slot, which makes a note-off and note-on that the
+// player didn't. Frames where the finder loses a touch are not counted, so that only the
+// matching is measured.
+void printMatcherSwaps()
+{
+	typedef SoundplaneATrackerTraits T;
+	const int kFrames = 20000;
+	const int kTouches = 3;
+	const int kCycleFrames = 2000;
+	const int kDownFrames = 1600;
+	const int kSettleFrames = 50;
+	const float kMaxTrackedDist = 1.f;
+	const float twoPi = 6.2831853f;
+	const float keyToSensorX = (T::sensorMaxX - T::sensorMinX)/(T::keyMaxX - T::keyMinX);
+
+	auto sensorToKeyY = [](float sy)
+	{
+		int i = 1;
+		while((i < T::yMapSize - 1) && (sy > T::sensorYMap[i])) ++i;
+		float m = (sy - T::sensorYMap[i - 1])/(T::sensorYMap[i] - T::sensorYMap[i - 1]);
+		return T::keyYMap[i - 1] + m*(T::keyYMap[i] - T::keyYMap[i - 1]);
+	};
+
+	const TouchMatcher matchers[] = {kMatchNearest, kMatchOptimal};
+	const char* names[] = {"nearest", "optimal"};
+	printf("identity swaps of tracked touches in %d frames:", kFrames);
+	for(int n = 0; n < 2; ++n)
+	{
+		TouchTracker tracker;
+		tracker.setThresh(0.05f);
+		tracker.setLopassZ(100.f);
+		tracker.setCalibration(makeSyntheticCalibrationMean());
+		tracker.setTouchMatcher(matchers[n]);
+
+		// the output slot of each touch in the last frame, or -1 if it was not tracked.
+		std::array<int, kTouches> lastSlot;
+		lastSlot.fill(-1);
+		int swaps = 0;
+		for(int f = 0; f < kFrames; ++f)
+		{
+			SensorFrame frame = makeSyntheticFrame(0, 0);
+			std::array<float, kTouches> x, y;
+			std::array<bool, kTouches> held;
+			for(int k = 0; k < kTouches; ++k)
+			{
+				const int phase = (f + k*kCycleFrames/kTouches) % kCycleFrames;
+				x[k] = 32.f + 20.f*sinf(twoPi*f/(800.f + 150.f*k) + k);
+				y[k] = 1.f + 2.5f*k;
+				held[k] = (phase >= kSettleFrames) && (phase < kDownFrames);
+				if(phase < kDownFrames)
+				{
+					addSyntheticTouch(frame, x[k], y[k], 0.2f);
+				}
+			}
+
+			const TouchArray& t = tracker.process(tracker.preprocessRaw(frame), kMaxTouches);
+			for(int k = 0; k < kTouches; ++k)
+			{
+				const float kx = T::keyMinX + (x[k] - T::sensorMinX)/keyToSensorX;
+				const float ky = sensorToKeyY(y[k]);
+				int slot = -1;
+				float minDist = kMaxTrackedDist;
+				for(int j = 0; j < kMaxTouches; ++j)
+				{
+					float d = fabsf(t[j].x - kx) + fabsf(t[j].y - ky);
+					if(touchIsActive(t[j]) && (d < minDist))
+					{
+						minDist = d;
+						slot = j;
+					}
+				}
+				if(!held[k]) slot = -1;
+				swaps += (lastSlot[k] >= 0) && (slot >= 0) && (slot != lastSlot[k]);
+				lastSlot[k] = slot;
+			}
+		}
+		printf(" %s %d", names[n], swaps);
+	}
+	printf("\n\n");
+}
+
+// the note-on latency of the onset detector, for a range of thresholds. On synthetic strikes
+// of several peaks and rise times, one at a time, the delay is from the start of each strike
+// to its note-on. On a recording, it is from each note-on of the tracker without onsets to
+// the nearest note-on of the same touch, so that a negative delay is the time gained. Extra
+// note-ons are those not matched to any strike or reference note-on.
+void printOnsetLatency(const std::string& recordingPath)
+{
+	const int kMaxFrames = 60000;
+	const int kStrikeFrames = 400;
+	const int kHoldFrames = 200;
+	const int kMaxEarly = 20;
+	const int kMaxLate = 40;
+	const float kMaxDist = 1.f;
+	const float kPeaks[] = {0.05f, 0.1f, 0.25f};
+	const int kRises[] = {1, 5, 20};
+	const float kThresholds[] = {0.f, 0.005f, 0.01f, 0.02f};
+	const int kStrikes = 3*3*4;
+
+	NullDriverListener listener;
+	std::unique_ptr< SoundplaneReplayDriver > pReplay;
+	SensorFrame calibrateMean = makeSyntheticCalibrationMean();
+	int frames = kStrikes*kStrikeFrames;
+	if(!recordingPath.empty())
+	{
+		pReplay = std::unique_ptr< SoundplaneReplayDriver >(new SoundplaneReplayDriver(listener, recordingPath, false));
+		if(!pReplay->isOpen() || !pReplay->getFrameCount())
+		{
+			printf("could not read recording %s\n\n", recordingPath.c_str());
+			return;
+		}
+		calibrateMean = getRecordingCalibrationMean(*pReplay);
+		frames = std::min((int)pReplay->getFrameCount(), kMaxFrames);
+	}
+
+	auto makeFrame = [&](int f)
+	{
+		SensorFrame frame = makeSyntheticFrame(0, 0);
+		if(pReplay)
+		{
+			const SensorRecordingFrame& r = pReplay->getFrameRecord(f);
+			std::copy(r.data, r.data + SensorGeometry::elements, frame.begin());
+		}
+		else
+		{
+			const int s = f/kStrikeFrames;
+			const int t = f % kStrikeFrames;
+			const float peak = kPeaks[s % 3];
+			const int rise = kRises[(s/3) % 3];
+			if(t < kHoldFrames)
+			{
+				addSyntheticTouch(frame, 30.3f, 3.2f, peak*std::min(1.f, (t + 1)/(float)rise));
+			}
+		}
+		return frame;
+	};
+
+	struct NoteOn
+	{
+		int frame;
+		float x;
+		float y;
+	};
+	auto getNoteOns = [&](float threshold)
+	{
+		TouchTracker tracker;
+		tracker.setThresh(0.05f);
+		tracker.setLopassZ(100.f);
+		tracker.setCalibration(clamp(calibrateMean, 0.0001f, 1.f));
+		tracker.setOnsetThreshold(threshold);
+		std::vector< NoteOn > ons;
+		for(int f = 0; f < frames; ++f)
+		{
+			const TouchArray& t = tracker.process(tracker.preprocessRaw(makeFrame(f)), kMaxTouches);
+			for(int i = 0; i < kMaxTouches; ++i)
+			{
+				if(t[i].state == kTouchStateOn)
+				{
+					ons.push_back(NoteOn{f, t[i].x, t[i].y});
+				}
+			}
+		}
+		return ons;
+	};
+
+	// the reference events: strike starts, which match a note-on anywhere, or note-ons
+	// without onsets.
+	std::vector< NoteOn > refs;
+	if(pReplay)
+	{
+		refs = getNoteOns(0.f);
+	}
+	else
+	{
+		const float kNaN = std::numeric_limits<float>::quiet_NaN();
+		for(int s = 0; s < kStrikes; ++s)
+		{
+			refs.push_back(NoteOn{s*kStrikeFrames, kNaN, kNaN});
+		}
+	}
+
+	printf("onset note-on latency on %s, %d %s:\n", pReplay ? recordingPath.c_str() : "synthetic strikes",
+		(int)refs.size(), pReplay ? "note-ons" : "strikes");
+	printf("%12s %12s %12s %12s %12s\n", "threshold", "delay mean", "delay max", "missed", "extra");
+	for(float threshold : kThresholds)
+	{
+		std::vector< NoteOn > ons = getNoteOns(threshold);
+		std::vector< bool > used(ons.size(), false);
+		double delaySum = 0.;
+		int delayMax = -kMaxEarly;
+		int matched = 0;
+		for(const NoteOn& r : refs)
+		{
+			// the nearest unused note-on in time, within the window and near enough.
+			int best = -1;
+			for(size_t j = 0; j < ons.size(); ++j)
+			{
+				const int d = ons[j].frame - r.frame;
+				if(used[j] || (d < -kMaxEarly) || (d > kMaxLate)) continue;
+				if((r.x == r.x) && (fabsf(ons[j].x - r.x) + fabsf(ons[j].y - r.y) > kMaxDist)) continue;
+				if((best < 0) || (abs(d) < abs(ons[best].frame - r.frame))) best = j;
+			}
+			if(best >= 0)
+			{
+				used[best] = true;
+				const int d = ons[best].frame - r.frame;
+				delaySum += d;
+				delayMax = std::max(delayMax, d);
+				matched++;
+			}
+		}
+		printf("%12g %12.2f %12d %12d %12d\n", threshold, matched ? delaySum/matched : 0., matched ? delayMax : 0,
+			(int)refs.size() - matched, (int)ons.size() - matched);
+	}
+	printf("\n");
+}
+
+const int kViewStressFrames = 3000;
+const int kViewStressViews = 3;
+const int kViewStressHistoryFrames = 500;
+
+// the signals the process thread makes for the views in one frame.
+struct ViewStressFrame
+{
+	SensorFrameHandle raw;
+	SensorFrameHandle calibrated;
+	SensorFrameHandle smoothed;
+	TouchArray touches{};
+};
+
+// runs a process thread at 1 kHz and realtime priority, which passes each frame to publish(),
+// while kViewStressViews views call read() at 60 Hz and draw the touch history as the grid
+// view does. A busy thread on every core keeps the views from running whenever they like.
+// Prints the time taken to publish each frame.
+template< typename Publish, typename Read >
+void runViewStress(const char* name, SensorFramePool& pool, Publish publish, Read read)
+{
+	TouchHistory history;
+	LatencyHistogram publishTime;
+	std::atomic<bool> done{false};
+
+	std::vector< std::thread > threads;
+	const int cores = std::max(1, (int)std::thread::hardware_concurrency());
+	for(int i = 0; i < cores; ++i)
+	{
+		threads.emplace_back([&]()
+		{
+			volatile uint64_t spin = 0;
+			while(!done) { spin = spin + 1; }
+		});
+	}
+	for(int v = 0; v < kViewStressViews; ++v)
+	{
+		threads.emplace_back([&, v]()
+		{
+			volatile float sink = 0.f;
+			while(!done)
+			{
+				float sum = read(v);
+				const uint64_t newest = history.getSequence();
+				for(int i = 0; i < kMaxTouches; ++i)
+				{
+					for(int t = 0; t < kViewStressHistoryFrames; ++t)
+					{
+						sum += history.getPoint(newest, t, i).x;
+					}
+				}
+				sink = sink + sum;
+				std::this_thread::sleep_for(microseconds(1000*1000/60));
+			}
+		});
+	}
+
+	std::thread writer([&]()
+	{
+		const SensorFrame frame = makeSyntheticFrame(0, 4);
+		auto next = steady_clock::now();
+		for(int f = 0; f < kViewStressFrames; ++f)
+		{
+			next += microseconds(1000);
+			std::this_thread::sleep_until(next);
+
+			ViewStressFrame out;
+			out.raw = pool.acquire();
+			out.calibrated = pool.acquire();
+			out.smoothed = pool.acquire();
+			for(SensorFrameHandle* h : {&out.raw, &out.calibrated, &out.smoothed})
+			{
+				if(*h) h->getFrameForWriting() = frame;
+			}
+			out.touches[f % kMaxTouches].age = f;
+
+			int64_t startTime = benchmarkNanos();
+			publish(out);
+			history.add(out.touches);
+			publishTime.record(benchmarkNanos() - startTime);
+		}
+	});
+	SetPriorityRealtimeAudio(writer.native_handle());
+	writer.join();
+
+	done = true;
+	for(auto& t : threads)
+	{
+		t.join();
+	}
+	printf("%-36s %10.1f %10.1f %10.1f\n", name, publishTime.getValueAtPercentile(50.)/1000.,
+		publishTime.getValueAtPercentile(99.)/1000., publishTime.getMax()/1000.);
+}
+
+// the time the process thread spends publishing the view signals, with the SignalPublishers
+// of the Model and with the handles under mutexes they replaced. With the mutexes, a view
+// preempted while holding one keeps the process thread waiting until the view runs again,
+// which on a busy machine can be many milliseconds: a priority inversion. The publishers
+// never wait, so their worst case should stay near their median.
+void printViewStress()
+{
+	typedef SignalPublisher< SensorFrameHandle > FramePublisher;
+	typedef SignalPublisher< TouchArray > TouchPublisher;
+
+	printf("publish time of view signals, %d views at 60 Hz, all cores busy:\n", kViewStressViews);
+	printf("%-36s %10s %10s %10s\n", "", "p50 us", "p99 us", "max us");
+
+	// the pool must outlive the frames held by the signals.
+	SensorFramePool pool(128);
+
+	auto readFrame = [](const SensorFrameHandle& h)
+	{
+		if(!h) return 0.f;
+		SensorFrame copy = *h;
+		return copy[0];
+	};
+
+	{
+		std::mutex mutexes[4];
+		ViewStressFrame shared;
+		runViewStress("mutex", pool, [&](const ViewStressFrame& f)
+		{
+			{ std::lock_guard<std::mutex> lock(mutexes[0]); shared.raw = f.raw; }
+			{ std::lock_guard<std::mutex> lock(mutexes[1]); shared.calibrated = f.calibrated; }
+			{ std::lock_guard<std::mutex> lock(mutexes[2]); shared.smoothed = f.smoothed; }
+			{ std::lock_guard<std::mutex> lock(mutexes[3]); shared.touches = f.touches; }
+		},
+		[&](int v)
+		{
+			SensorFrameHandle raw, calibrated, smoothed;
+			TouchArray touches;
+			{ std::lock_guard<std::mutex> lock(mutexes[0]); raw = shared.raw; }
+			{ std::lock_guard<std::mutex> lock(mutexes[1]); calibrated = shared.calibrated; }
+			{ std::lock_guard<std::mutex> lock(mutexes[2]); smoothed = shared.smoothed; }
+			{ std::lock_guard<std::mutex> lock(mutexes[3]); touches = shared.touches; }
+			return readFrame(raw) + readFrame(calibrated) + readFrame(smoothed) + touches[0].x;
+		});
+	}
+
+	{
+		FramePublisher raw, calibrated, smoothed;
+		TouchPublisher touches;
+		struct Subscriptions
+		{
+			Subscriptions(FramePublisher& r, FramePublisher& c, FramePublisher& s, TouchPublisher& t) :
+			raw(r), calibrated(c), smoothed(s), touches(t) {}
+			FramePublisher::Subscription raw, calibrated, smoothed;
+			TouchPublisher::Subscription touches;
+		};
+		std::vector< std::unique_ptr< Subscriptions > > views;
+		for(int v = 0; v < kViewStressViews; ++v)
+		{
+			views.emplace_back(new Subscriptions(raw, calibrated, smoothed, touches));
+		}
+
+		runViewStress("SignalPublisher", pool, [&](const ViewStressFrame& f)
+		{
+			raw.publish(f.raw);
+			calibrated.publish(f.calibrated);
+			smoothed.publish(f.smoothed);
+			touches.publish(f.touches);
+		},
+		[&](int v)
+		{
+			// as the views do, convert only the frames that changed.
+			Subscriptions& s = *views[v];
+			float sum = 0.f;
+			if(s.raw.update()) sum += readFrame(s.raw.get());
+			if(s.calibrated.update()) sum += readFrame(s.calibrated.get());
+			if(s.smoothed.update()) sum += readFrame(s.smoothed.get());
+			s.touches.update();
+			return sum + s.touches.get()[0].x;
+		});
+	}
+	printf("\n");
+}
+
+// checks the peak kernels against a brute-force reference, on random frames with and without
+// ties between neighbors and on partial column ranges. Returns the number of frames that differ.
+int checkPeakKernels()
+{
+	typedef SoundplaneATrackerTraits T;
+	constexpr int w = T::width;
+	constexpr int h = T::height;
+	typedef SensorFrameKernels::PeakMap<w, h> PeakMap;
+	const int kFrames = 2000;
+
+	auto isPeak = [&](const SensorFrame& in, float threshold, int i, int j)
+	{
+		if((i < 1) || (i > w - 2) || !(in[j*w + i] > threshold)) return false;
+		for(int dj = -1; dj <= 1; ++dj)
+		{
+			for(int di = -1; di <= 1; ++di)
+			{
+				const int y = j + dj;
+				if((di == 0) && (dj == 0)) continue;
+				if((y < 0) || (y >= h)) continue;
+				if(!(in[j*w + i] > in[y*w + i + di])) return false;
+			}
+		}
+		return true;
+	};
+
+	srand(1);
+	int failures = 0;
+	for(int f = 0; f < kFrames; ++f)
+	{
+		// every other frame has values from a few levels, so that neighbors are often equal.
+		SensorFrame in;
+		for(float& z : in)
+		{
+			z = (f & 1) ? (rand() % 4)*0.25f : rand()/(float)RAND_MAX;
+		}
+		const float threshold = (rand() % 4)*0.2f;
+		const int c0 = (rand() % (w/4))*4;
+		const int c1 = c0 + (rand() % ((w - c0)/4) + 1)*4;
+
+		// bits outside [c0, c1) must be kept.
+		PeakMap initial;
+		for(auto& row : initial)
+		{
+			for(auto& word : row)
+			{
+				word = ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+			}
+		}
+
+		PeakMap ref = initial;
+		for(int j = 0; j < h; ++j)
+		{
+			for(int i = c0; i < c1; ++i)
+			{
+				uint64_t bit = uint64_t(1) << (i & 63);
+				ref[j][i >> 6] = isPeak(in, threshold, i, j) ? (ref[j][i >> 6] | bit) : (ref[j][i >> 6] & ~bit);
+			}
+		}
+
+		PeakMap scalarPeaks = initial;
+		PeakMap fastestPeaks = initial;
+		SensorFrameKernels::scalar::findPeaks<w, h>(in, threshold, c0, c1, scalarPeaks);
+		SensorFrameKernels::fastest::findPeaks<w, h>(in, threshold, c0, c1, fastestPeaks);
+		failures += (scalarPeaks != ref) || (fastestPeaks != ref);
+	}
+
+	printf("peak kernels vs. reference: %d of %d frames differ\n\n", failures, kFrames);
+	return failures;
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkOptions opts;
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if((arg == "-iterations") && (i + 1 < argc)) opts.iterations = std::max(10, atoi(argv[++i]));
+		else if((arg == "-recording") && (i + 1 < argc)) opts.recordingPath = argv[++i];
+		else if(arg[0] != '-') opts.filter = arg;
+		else
+		{
+			printf("usage: %s [-iterations n] [-recording file] [name filter]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	printChordAccuracy();
+	printMatcherSwaps();
+	printOnsetLatency(opts.recordingPath);
+	TouchTrackerBenchmark::printPredictionTradeoff(opts.recordingPath);
+	printViewStress();
+	if(checkPeakKernels()) return 1;
+	printf("touch capacity: %d\n", kMaxTouches);
+	printf("%-36s %8s %12s %12s\n", "function", "touches", "ns/call", "allocs/call");
+	for(int touches : kBenchmarkTouchCounts)
+	{
+		TouchTrackerBenchmark::run(opts, touches);
+	}
+	if(kMaxTouches > 16)
+	{
+		TouchTrackerBenchmark::run(opts, kMaxTouches);
+	}
+	TouchTrackerBenchmark::runWorstCase(opts);
+	return 0;
+}
@@ -0,0 +1,541 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// soundplane-headless: runs the tracking pipeline without any GUI, as fast as possible,
+// on a recording or on synthetic frames, and reports throughput, time per stage and
+// allocations per frame.
+//
+// usage: soundplane-headless [-frames n] [-touches n] [-zones name|file] [-tiles threshold] [-blobs] [-optimal] [-predict ms] [-onset threshold] [-osc] [-instruments n] [-wakeup seconds] [recording]
+//
+// Unlike the application, every frame is sent to the outputs regardless of the data rate,
+// so the output times are a worst case. MIDI messages are made but dropped, since no
+// device is opened. With -osc, OSC is sent to the default port on localhost. With -tiles,
+// the tracker skips the tiles of the surface whose input changes less than the threshold,
+// and the mean fraction of tiles processed is reported. With -blobs, touches are found by
+// the blob finder instead of the peak finder. With -optimal, touches are matched between
+// frames by the optimal assignment instead of by nearest neighbors. With -predict, touches
+// are extrapolated ahead by the given time. With -onset, touches are started early when the
+// calibrated pressure of a taxel rises by more than the threshold in one frame.
+//
+// With -instruments, the input is fed to n SoundplaneInstruments at once, each tracked on
+// its own thread and sending MIDI through the first one's output, as the application does
+// with several devices. Throughput is measured with one instrument and then with n, and the
+// scaling reported is the speedup divided by n.
+//
+// With -wakeup, the process thread's wait for frames is compared with the loop it replaced,
+// which took at most one frame from the queue and then slept for 500 us. Each loop is run
+// idle for the given time, and its wakeups and CPU time are reported. Then frames are fed
+// to it at 1 kHz for the same time, and the time from each frame's arrival to the end of
+// its output is reported. The frames are tracked and sent to MIDI as in the application.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <time.h>
+
+#include "TouchTracker.h"
+#include "ZoneSet.h"
+#include "SoundplaneMIDIOutput.h"
+#include "SoundplaneOSCOutput.h"
+#include "SoundplaneReplayDriver.h"
+#include "SoundplaneInstrument.h"
+#include "SoundplaneBinaryData.h"
+#include "SensorFramePool.h"
+#include "LatencyHistogram.h"
+#include "ThreadUtility.h"
+#include "BenchmarkUtils.h"
+
+using namespace std::chrono;
+
+enum HeadlessStage
+{
+	kStagePreprocess = 0,
+	kStageTrack,
+	kStageZones,
+	kStageOutputs,
+	kNumHeadlessStages
+};
+
+static std::string getZoneJSON(const std::string& name)
+{
+	if(name == "chromatic") return SoundplaneBinaryData::chromatic_json;
+	if(name == "rows in fourths") return SoundplaneBinaryData::rows_in_fourths_json;
+	if(name == "rows in octaves") return SoundplaneBinaryData::rows_in_octaves_json;
+
+	std::ifstream f(name);
+	std::stringstream s;
+	s << f.rdbuf();
+	return s.str();
+}
+
+// the input frames, made up front so that feeding them costs only a copy.
+static std::vector< SensorFrame > makeInput(const SoundplaneReplayDriver* pReplay, int touches)
+{
+	std::vector< SensorFrame > input;
+	size_t inputFrames = pReplay ? pReplay->getFrameCount() : 1000;
+	for(size_t f = 0; f < inputFrames; ++f)
+	{
+		if(pReplay)
+		{
+			const SensorRecordingFrame& r = pReplay->getFrameRecord(f);
+			SensorFrame frame;
+			std::copy(r.data, r.data + SensorGeometry::elements, frame.begin());
+			input.push_back(frame);
+		}
+		else
+		{
+			input.push_back(makeSyntheticFrame(f, touches));
+		}
+	}
+	return input;
+}
+
+// CPU time used by the calling thread, or 0 where that can't be read.
+static int64_t threadCPUNanos()
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	timespec t;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+	return (int64_t)t.tv_sec*1000*1000*1000 + t.tv_nsec;
+#else
+	return 0;
+#endif
+}
+
+// a process thread fed through a frame pool and queue as the Model's is. It either polls as
+// the Model did before it waited for frames, or waits as the Model and SoundplaneInstrument
+// do now: a lock-free check of the queue, then a condition variable that push() signals
+// only when the thread has said it is waiting.
+class WakeupLoop
+{
+public:
+	WakeupLoop(bool polling, std::function< void(const SensorFrame&) > process) :
+	mPolling(polling),
+	mProcess(process),
+	mPool(32),
+	mQueue(16)
+	{
+		mThread = std::thread(&WakeupLoop::run, this);
+		SetPriorityRealtimeAudio(mThread.native_handle());
+	}
+
+	~WakeupLoop()
+	{
+		mTerminating = true;
+		{
+			std::lock_guard<std::mutex> lock(mWakeMutex);
+			mWakeCondition.notify_one();
+		}
+		mThread.join();
+	}
+
+	// as SoundplaneModel::onFrame().
+	void push(const SensorFrame& frame)
+	{
+		SensorFrameHandle buffer = mPool.acquire();
+		if(!buffer) return;
+		buffer.getFrameForWriting() = frame;
+		buffer.setTimestamp(benchmarkNanos());
+		mQueue.push(buffer.detach());
+		if(!mPolling)
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if(mWaiting)
+			{
+				std::lock_guard<std::mutex> lock(mWakeMutex);
+				mWakeCondition.notify_one();
+			}
+		}
+	}
+
+	uint64_t getWakeups() const { return mWakeups; }
+	int64_t getCPUNanos() const { return mCPUNanos; }
+	uint64_t getFramesProcessed() const { return mFramesProcessed; }
+
+	// from push() to the end of the frame's output.
+	const LatencyHistogram& getLatency() const { return mLatency; }
+
+private:
+	bool hasWork() { return mTerminating || (mQueue.elementsAvailable() > 0); }
+
+	void run()
+	{
+		int64_t startCPU = threadCPUNanos();
+		while(!mTerminating)
+		{
+			if(mPolling)
+			{
+				// the old loop: at most one frame, then a sleep of less than one frame interval.
+				processFrames(1);
+				std::this_thread::sleep_for(microseconds(500));
+			}
+			else
+			{
+				if(!hasWork())
+				{
+					std::unique_lock<std::mutex> lock(mWakeMutex);
+					mWaiting = true;
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					mWakeCondition.wait_for(lock, milliseconds(kProcessThreadIdleTimeoutMillis), [&](){ return hasWork(); });
+					mWaiting = false;
+				}
+				processFrames(mQueue.getCapacity());
+			}
+			mWakeups++;
+			mCPUNanos = threadCPUNanos() - startCPU;
+		}
+	}
+
+	void processFrames(size_t maxFrames)
+	{
+		SensorFrameBuffer* pBuffer;
+		for(size_t i = 0; (i < maxFrames) && mQueue.pop(pBuffer); ++i)
+		{
+			SensorFrameHandle frame = SensorFrameHandle::adopt(pBuffer);
+			mProcess(*frame);
+			mLatency.record(benchmarkNanos() - frame.getTimestamp());
+			mFramesProcessed++;
+		}
+	}
+
+	// the Model's longest sleep when no frames are arriving.
+	static constexpr int kProcessThreadIdleTimeoutMillis = 100;
+
+	const bool mPolling;
+	std::function< void(const SensorFrame&) > mProcess;
+	SensorFramePool mPool;
+	SensorFrameBufferRing mQueue;
+	LatencyHistogram mLatency;
+	std::atomic<uint64_t> mWakeups{0};
+	std::atomic<int64_t> mCPUNanos{0};
+	std::atomic<uint64_t> mFramesProcessed{0};
+	std::atomic<bool> mTerminating{false};
+	std::atomic<bool> mWaiting{false};
+	std::mutex mWakeMutex;
+	std::condition_variable mWakeCondition;
+	std::thread mThread;
+};
+
+// run each loop idle, then fed at 1 kHz, for the given time, and print a row for each.
+static void runWakeupComparison(double seconds, const std::vector< SensorFrame >& input,
+	std::function< void(const SensorFrame&) > process)
+{
+	printf("%-14s %12s %12s %10s %10s %10s %8s\n", "loop", "idle wake/s", "idle CPU %", "p50 us", "p99 us", "max us", "dropped");
+	for(bool polling : {true, false})
+	{
+		double idleWakeups, idleCPU;
+		{
+			WakeupLoop idle(polling, process);
+			std::this_thread::sleep_for(duration<double>(seconds));
+			idleWakeups = idle.getWakeups()/seconds;
+			idleCPU = 100.*idle.getCPUNanos()*1e-9/seconds;
+		}
+
+		WakeupLoop fed(polling, process);
+		const int frames = (int)(seconds*1000);
+		auto next = steady_clock::now();
+		for(int f = 0; f < frames; ++f)
+		{
+			next += microseconds(1000);
+			std::this_thread::sleep_until(next);
+			fed.push(input[f % input.size()]);
+		}
+		std::this_thread::sleep_for(milliseconds(10));
+		const LatencyHistogram& h = fed.getLatency();
+		printf("%-14s %12.0f %12.3f %10.1f %10.1f %10.1f %8lld\n", polling ? "poll 500 us" : "wait", idleWakeups, idleCPU,
+			h.getValueAtPercentile(50.)/1000., h.getValueAtPercentile(99.)/1000., h.getMax()/1000.,
+			(long long)(frames - fed.getFramesProcessed()));
+	}
+}
+
+struct InstrumentsResult
+{
+	double framesPerSecond;
+	int64_t p50Nanos;
+	int64_t p99Nanos;
+};
+
+// feed the same input to n instruments, one feeder thread each, without dropping any frames.
+static InstrumentsResult runInstruments(int n, int frames, int touches, const std::string& zoneJSON,
+	const std::vector< SensorFrame >& input, const SensorFrame& calibrateMean)
+{
+	std::vector< std::unique_ptr< SoundplaneInstrument > > instruments;
+	for(int i = 0; i < n; ++i)
+	{
+		std::unique_ptr< SoundplaneInstrument > pInstrument(new SoundplaneInstrument(i));
+		pInstrument->setCalibration(clamp(calibrateMean, 0.0001f, 1.f));
+		
+		// the application's defaults, but with the zones and MIDI output of the single
+		// pipeline run, sending every frame, and no OSC.
+		pInstrument->getPublishedZones().load(zoneJSON, 0);
+		RealtimeParams params;
+		params.maxTouches = touches;
+		params.dataRate = 1000*1000;
+		params.quantize = false;
+		params.snap = 100.f;
+		params.midiActive = true;
+		params.oscActive = false;
+		pInstrument->publishParams(params);
+		
+		SoundplaneMIDIOutput& midi = pInstrument->getMIDIOutput();
+		if(i > 0)
+		{
+			midi.sendThrough(&instruments[0]->getMIDIOutput());
+		}
+		midi.setMPEZone(i, n);
+		instruments.push_back(std::move(pInstrument));
+	}
+	for(auto& pInstrument : instruments)
+	{
+		pInstrument->start();
+	}
+
+	int64_t startTime = benchmarkNanos();
+	std::vector< std::thread > feeders;
+	for(auto& pInstrument : instruments)
+	{
+		SoundplaneInstrument* p = pInstrument.get();
+		feeders.push_back(std::thread([p, frames, &input]()
+		{
+			for(int f = 0; f < frames; ++f)
+			{
+				while(p->getFramesWaiting() >= p->getInputCapacity() - 1)
+				{
+					std::this_thread::yield();
+				}
+				p->onFrame(input[f % input.size()]);
+			}
+			while(p->getFramesProcessed() < (uint64_t)frames)
+			{
+				std::this_thread::yield();
+			}
+		}));
+	}
+	for(auto& t : feeders)
+	{
+		t.join();
+	}
+	int64_t elapsed = benchmarkNanos() - startTime;
+
+	InstrumentsResult r{};
+	r.framesPerSecond = (double)n*frames/(elapsed*1e-9);
+	for(auto& pInstrument : instruments)
+	{
+		const LatencyHistogram& h = pInstrument->getLatencyHistogram();
+		r.p50Nanos = std::max(r.p50Nanos, h.getValueAtPercentile(50.));
+		r.p99Nanos = std::max(r.p99Nanos, h.getValueAtPercentile(99.));
+	}
+
+	// the others send through the first instrument's MIDI output, so all are stopped before any is destroyed.
+	for(auto& pInstrument : instruments)
+	{
+		pInstrument->stop();
+	}
+	return r;
+}
+
+int main(int argc, char** argv)
+{
+	int frames = 100000;
+	int touches = 4;
+	bool sendOSC = false;
+	float tileThreshold = 0.f;
+	bool blobs = false;
+	bool optimal = false;
+	float predictTime = 0.f;
+	float onsetThreshold = 0.f;
+	int instruments = 0;
+	double wakeupSeconds = 0.;
+	std::string zoneName = "chromatic";
+	std::string recordingPath;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if((arg == "-frames") && (i + 1 < argc)) frames = atoi(argv[++i]);
+		else if((arg == "-touches") && (i + 1 < argc)) touches = atoi(argv[++i]);
+		else if((arg == "-zones") && (i + 1 < argc)) zoneName = argv[++i];
+		else if((arg == "-tiles") && (i + 1 < argc)) tileThreshold = atof(argv[++i]);
+		else if(arg == "-blobs") blobs = true;
+		else if(arg == "-optimal") optimal = true;
+		else if((arg == "-predict") && (i + 1 < argc)) predictTime = atof(argv[++i]);
+		else if((arg == "-onset") && (i + 1 < argc)) onsetThreshold = atof(argv[++i]);
+		else if(arg == "-osc") sendOSC = true;
+		else if((arg == "-instruments") && (i + 1 < argc)) instruments = atoi(argv[++i]);
+		else if((arg == "-wakeup") && (i + 1 < argc)) wakeupSeconds = atof(argv[++i]);
+		else if(arg[0] != '-') recordingPath = arg;
+		else
+		{
+			printf("usage: %s [-frames n] [-touches n] [-zones name|file] [-tiles threshold] [-blobs] [-optimal] [-predict ms] [-onset threshold] [-osc] [-instruments n] [-wakeup seconds] [recording]\n", argv[0]);
+			return 1;
+		}
+	}
+	touches = std::max(1, std::min(touches, (int)kMaxTouches));
+
+	// input
+	NullDriverListener listener;
+	std::unique_ptr< SoundplaneReplayDriver > pReplay;
+	SensorFrame calibrateMean = makeSyntheticCalibrationMean();
+	if(!recordingPath.empty())
+	{
+		pReplay = std::unique_ptr< SoundplaneReplayDriver >(new SoundplaneReplayDriver(listener, recordingPath, false));
+		if(!pReplay->isOpen() || !pReplay->getFrameCount()) return 1;
+		calibrateMean = getRecordingCalibrationMean(*pReplay);
+	}
+
+	// pipeline, with the application's default settings
+	TouchTracker tracker;
+	tracker.setThresh(0.05f);
+	tracker.setLopassZ(100.f);
+	tracker.setCalibration(clamp(calibrateMean, 0.0001f, 1.f));
+	tracker.setTileThreshold(tileThreshold);
+	tracker.setTouchFinder(blobs ? kFindBlobs : kFindPeaks);
+	tracker.setTouchMatcher(optimal ? kMatchOptimal : kMatchNearest);
+	tracker.setPredictTime(predictTime);
+	tracker.setOnsetThreshold(onsetThreshold);
+
+	ZoneSet zones;
+	if(!zones.loadFromString(getZoneJSON(zoneName)) || !zones.size())
+	{
+		printf("could not load zones %s\n", zoneName.c_str());
+		return 1;
+	}
+
+	if(instruments > 0)
+	{
+		std::vector< SensorFrame > input = makeInput(pReplay.get(), touches);
+
+		printf("input: %s, %d touches, zones: %s, %d frames per instrument\n", recordingPath.empty() ? "synthetic" : recordingPath.c_str(),
+			touches, zoneName.c_str(), frames);
+		printf("%-12s %14s %12s %12s %10s\n", "instruments", "frames/s", "p50 us", "p99 us", "scaling");
+		InstrumentsResult one = runInstruments(1, frames, touches, getZoneJSON(zoneName), input, calibrateMean);
+		printf("%-12d %14.0f %12.1f %12.1f %10.2f\n", 1, one.framesPerSecond, one.p50Nanos/1000., one.p99Nanos/1000., 1.);
+		if(instruments > 1)
+		{
+			InstrumentsResult r = runInstruments(instruments, frames, touches, getZoneJSON(zoneName), input, calibrateMean);
+			printf("%-12d %14.0f %12.1f %12.1f %10.2f\n", instruments, r.framesPerSecond, r.p50Nanos/1000., r.p99Nanos/1000.,
+				r.framesPerSecond/(one.framesPerSecond*instruments));
+		}
+		return 0;
+	}
+	const float hysteresis = 0.5f;
+	zones.setParameters(0.5f, hysteresis, false, false, 0, 100.f);
+
+	SoundplaneMIDIOutput midiOutput;
+	midiOutput.setMPE(true);
+	midiOutput.setMaxTouches(touches);
+	midiOutput.setActive(true);
+
+	SoundplaneOSCOutput oscOutput;
+	if(sendOSC)
+	{
+		oscOutput.setHostName(kDefaultHostnameString);
+		oscOutput.setPort(kDefaultUDPPort);
+		oscOutput.setMaxTouches(touches);
+		oscOutput.reconnect();
+	}
+
+	if(wakeupSeconds > 0.)
+	{
+		printf("input: %s, %d touches, zones: %s, %g s idle and %g s at 1 kHz per loop\n", recordingPath.empty() ? "synthetic" : recordingPath.c_str(),
+			touches, zoneName.c_str(), wakeupSeconds, wakeupSeconds);
+		runWakeupComparison(wakeupSeconds, makeInput(pReplay.get(), touches), [&](const SensorFrame& raw)
+		{
+			TouchArray t = scaleTouchPressure(tracker.process(tracker.preprocessRaw(raw), touches), 1.f, 0.5f);
+			zones.processTouches(t, hysteresis);
+			midiOutput.beginOutputFrame(system_clock::now());
+			zones.sendToOutput(midiOutput);
+			midiOutput.endOutputFrame();
+		});
+		return 0;
+	}
+
+	StageTimer stages[kNumHeadlessStages] = {{"preprocess"}, {"track"}, {"zones"}, {"outputs"}};
+
+	// the first frames are not timed, so that filters and allocations settle.
+	const int warmupFrames = std::min(frames, 1000);
+	uint64_t startAllocations = 0;
+	int64_t startTime = 0;
+	SensorFrame raw;
+	double tileFractionSum = 0.;
+
+	for(int f = 0; f < warmupFrames + frames; ++f)
+	{
+		if(f == warmupFrames)
+		{
+			for(auto& s : stages) s = StageTimer{s.name};
+			startAllocations = getAllocationCount();
+			startTime = benchmarkNanos();
+			tileFractionSum = 0.;
+		}
+
+		if(pReplay)
+		{
+			const SensorRecordingFrame& r = pReplay->getFrameRecord(f % pReplay->getFrameCount());
+			std::copy(r.data, r.data + SensorGeometry::elements, raw.begin());
+		}
+		else
+		{
+			raw = makeSyntheticFrame(f, touches);
+		}
+
+		// calibration is done with preprocessing. As in the app with no view of the calibrated
+		// signal and the matrix not sent, the calibrated frame is not kept.
+		int64_t t1 = benchmarkNanos();
+		const SensorFrame& curvature = tracker.preprocessRaw(raw);
+		int64_t t2 = benchmarkNanos();
+		tileFractionSum += tracker.getTileFraction();
+		TouchArray t = tracker.process(curvature, touches);
+		t = scaleTouchPressure(t, 1.f, 0.5f);
+		int64_t t3 = benchmarkNanos();
+		zones.processTouches(t, hysteresis);
+		int64_t t4 = benchmarkNanos();
+
+		auto now = system_clock::now();
+		midiOutput.beginOutputFrame(now);
+		zones.sendToOutput(midiOutput);
+		midiOutput.endOutputFrame();
+		if(oscOutput.isActive())
+		{
+			oscOutput.beginOutputFrame(now);
+			zones.sendToOutput(oscOutput);
+			oscOutput.endOutputFrame();
+		}
+		int64_t t5 = benchmarkNanos();
+
+		stages[kStagePreprocess].add(t2 - t1);
+		stages[kStageTrack].add(t3 - t2);
+		stages[kStageZones].add(t4 - t3);
+		stages[kStageOutputs].add(t5 - t4);
+	}
+
+	int64_t elapsed = benchmarkNanos() - startTime;
+	uint64_t allocations = getAllocationCount() - startAllocations;
+
+	printf("input: %s, %d touches, zones: %s, %s finder, %s matcher, predict %g ms, onset %g%s\n", recordingPath.empty() ? "synthetic" : recordingPath.c_str(), touches,
+		zoneName.c_str(), blobs ? "blob" : "peak", optimal ? "optimal" : "nearest", predictTime, onsetThreshold, sendOSC ? ", OSC on" : "");
+	printf("%d frames in %.3f s: %.0f frames/s\n", frames, elapsed*1e-9, frames/(elapsed*1e-9));
+	printf("allocations/frame: %.3f\n", (double)allocations/frames);
+	printf("MIDI messages: %llu\n", (unsigned long long)midiOutput.getMessagesSent());
+	printf("tiles processed/frame: %.3f\n", tileFractionSum/frames);
+	printf("%-12s %12s %12s\n", "stage", "mean ns", "max ns");
+	int64_t totalMean = 0;
+	for(const auto& s : stages)
+	{
+		printf("%-12s %12.0f %12lld\n", s.name, s.meanNanos(), (long long)s.maxNanos);
+		totalMean += (int64_t)s.meanNanos();
+	}
+	printf("%-12s %12lld\n", "total", (long long)totalMean);
+	return 0;
+}
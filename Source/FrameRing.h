@@ -0,0 +1,248 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <type_traits>
+#include <stdint.h>
+
+// FrameRing: a single-producer, single-consumer ring buffer for passing frames from the
+// driver callback to the process thread without locks. The read and write indices are
+// monotonic 64-bit counters, each on its own cache line.
+//
+// When the ring is full, the overflow policy decides what is lost:
+// kDropOldest: the producer discards the oldest waiting frame. The consumer validates
+//   each read with a compare-and-swap on the read index and rereads if the producer dropped
+//   the frame it was reading. Since the producer may then be writing the slot the consumer
+//   is reading, the fields of a slot are atomics, and T must be trivially copyable.
+// kDropNewest: the incoming frame is discarded.
+// kCoalesce: as kDropOldest when full, and pop() always returns the most recent frame,
+//   discarding any older ones, so the consumer is never more than one frame behind.
+//
+// Counters for drops, high water mark and residency time are always kept.
+//
+// Items discarded by the ring itself are passed to Disposer::dispose(), so that rings of
+// owning pointers can give them back.
+
+enum FrameRingOverflowPolicy
+{
+	kFrameRingDropOldest = 0,
+	kFrameRingDropNewest,
+	kFrameRingCoalesce
+};
+
+struct FrameRingStats
+{
+	uint64_t pushed;
+	uint64_t popped;
+	uint64_t dropped;
+	uint64_t coalesced;
+	uint64_t highWater;
+	int64_t maxResidencyNanos;
+	int64_t totalResidencyNanos;
+
+	int64_t meanResidencyNanos() const { return popped ? totalResidencyNanos / (int64_t)popped : 0; }
+};
+
+constexpr size_t kCacheLineSize = 64;
+
+template< class T >
+struct FrameRingKeepItems
+{
+	static void dispose(T&) {}
+};
+
+template< class T, class Disposer = FrameRingKeepItems< T > >
+class FrameRing
+{
+public:
+	explicit FrameRing(size_t capacity) :
+	mCapacity(std::max(capacity, size_t(1))),
+	mSlots(mCapacity + 1)
+	{
+		resetStats();
+	}
+
+	~FrameRing() {}
+
+	void setPolicy(FrameRingOverflowPolicy p) { mPolicy = p; }
+	FrameRingOverflowPolicy getPolicy() const { return mPolicy.load(); }
+
+	size_t getCapacity() const { return mCapacity; }
+
+	size_t elementsAvailable() const
+	{
+		uint64_t w = mWriteIndex.load(std::memory_order_acquire);
+		uint64_t r = mReadIndex.load(std::memory_order_acquire);
+		return (w > r) ? (size_t)(w - r) : 0;
+	}
+
+	// producer side. returns false if the frame could not be stored, in which case it is disposed.
+	bool push(T item)
+	{
+		uint64_t w = mWriteIndex.load(std::memory_order_relaxed);
+		uint64_t r = mReadIndex.load(std::memory_order_acquire);
+
+		if(w - r >= mCapacity)
+		{
+			if(mPolicy == kFrameRingDropNewest)
+			{
+				Disposer::dispose(item);
+				mDropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			// drop the oldest frame. If the consumer took it first, there is room now anyway.
+			T oldest = mSlots[r % mSlots.size()].item.load(std::memory_order_relaxed);
+			if(mReadIndex.compare_exchange_strong(r, r + 1, std::memory_order_acq_rel))
+			{
+				Disposer::dispose(oldest);
+				mDropped.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		Slot& s = mSlots[w % mSlots.size()];
+		s.item.store(item, std::memory_order_relaxed);
+		s.pushTime.store(now(), std::memory_order_relaxed);
+		mWriteIndex.store(w + 1, std::memory_order_release);
+
+		mPushed.fetch_add(1, std::memory_order_relaxed);
+		uint64_t occupancy = w + 1 - mReadIndex.load(std::memory_order_relaxed);
+		if(occupancy > mHighWater.load(std::memory_order_relaxed))
+		{
+			mHighWater.store(occupancy, std::memory_order_relaxed);
+		}
+		return true;
+	}
+
+	// consumer side. returns false if no frame is waiting.
+	bool pop(T& item)
+	{
+		int64_t pushTime;
+		if(mPolicy == kFrameRingCoalesce)
+		{
+			// discard all but the most recent frame.
+			while(elementsAvailable() > 1)
+			{
+				T skipped;
+				if(takeOldest(skipped, pushTime))
+				{
+					Disposer::dispose(skipped);
+					mCoalesced.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+		}
+
+		if(!takeOldest(item, pushTime)) return false;
+
+		int64_t residency = now() - pushTime;
+		mPopped.fetch_add(1, std::memory_order_relaxed);
+		mTotalResidency.fetch_add(residency, std::memory_order_relaxed);
+		if(residency > mMaxResidency.load(std::memory_order_relaxed))
+		{
+			mMaxResidency.store(residency, std::memory_order_relaxed);
+		}
+		return true;
+	}
+
+	// discard all waiting frames. Frames are taken as pop() takes them, competing through the
+	// read index, so this may be called from a third thread while the producer and consumer
+	// are running: each frame is still either popped, dropped or discarded exactly once.
+	// Frames pushed while this runs may or may not be discarded. The stats are not changed.
+	void clear()
+	{
+		T item;
+		int64_t pushTime;
+		while(takeOldest(item, pushTime))
+		{
+			Disposer::dispose(item);
+		}
+	}
+
+	FrameRingStats getStats() const
+	{
+		FrameRingStats s;
+		s.pushed = mPushed.load(std::memory_order_relaxed);
+		s.popped = mPopped.load(std::memory_order_relaxed);
+		s.dropped = mDropped.load(std::memory_order_relaxed);
+		s.coalesced = mCoalesced.load(std::memory_order_relaxed);
+		s.highWater = mHighWater.load(std::memory_order_relaxed);
+		s.maxResidencyNanos = mMaxResidency.load(std::memory_order_relaxed);
+		s.totalResidencyNanos = mTotalResidency.load(std::memory_order_relaxed);
+		return s;
+	}
+
+	// reset the counters. The high water mark and residency are only written by one side
+	// each, so a reset racing with a push or pop can at worst lose one sample.
+	void resetStats()
+	{
+		mPushed = 0;
+		mPopped = 0;
+		mDropped = 0;
+		mCoalesced = 0;
+		mHighWater = 0;
+		mMaxResidency = 0;
+		mTotalResidency = 0;
+	}
+
+private:
+	static_assert(std::is_trivially_copyable< T >::value, "FrameRing items must be trivially copyable");
+
+	// written by the producer, read by the consumer and by the producer when dropping. The
+	// read index orders these accesses, so they can be relaxed.
+	struct Slot
+	{
+		std::atomic< T > item{T()};
+		std::atomic< int64_t > pushTime{0};
+	};
+
+	// take the oldest frame, competing with the producer which may drop it.
+	bool takeOldest(T& item, int64_t& pushTime)
+	{
+		uint64_t r = mReadIndex.load(std::memory_order_acquire);
+		while(true)
+		{
+			uint64_t w = mWriteIndex.load(std::memory_order_acquire);
+			if(r >= w) return false;
+
+			const Slot& s = mSlots[r % mSlots.size()];
+			item = s.item.load(std::memory_order_relaxed);
+			pushTime = s.pushTime.load(std::memory_order_relaxed);
+
+			// if the producer dropped this frame while we were reading it, the slot may have been
+			// written again and what we read is discarded. The slot is only written again after
+			// the read index has moved past r, so if the swap succeeds, we read the frame at r.
+			if(mReadIndex.compare_exchange_weak(r, r + 1, std::memory_order_acq_rel))
+			{
+				return true;
+			}
+		}
+	}
+
+	static int64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	const size_t mCapacity;
+	std::vector< Slot > mSlots;
+	std::atomic<FrameRingOverflowPolicy> mPolicy{kFrameRingDropOldest};
+
+	alignas(kCacheLineSize) std::atomic<uint64_t> mWriteIndex{0};
+	std::atomic<uint64_t> mPushed;
+	std::atomic<uint64_t> mDropped;
+	std::atomic<uint64_t> mHighWater;
+
+	alignas(kCacheLineSize) std::atomic<uint64_t> mReadIndex{0};
+	std::atomic<uint64_t> mPopped;
+	std::atomic<uint64_t> mCoalesced;
+	std::atomic<int64_t> mMaxResidency;
+	std::atomic<int64_t> mTotalResidency;
+
+	char mPad[kCacheLineSize];
+};
@@ -0,0 +1,113 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// LatencyHistogram: a fixed size histogram of latencies in nanoseconds, in the style of
+// HdrHistogram. Values are grouped by their highest set bit and each group is split into
+// kSubBuckets linear buckets, so any value is reported within 1/kSubBuckets of its true
+// size from 1ns up to about 18 minutes. Values below kSubBuckets are exact.
+//
+// One thread records while any other thread reads or resets. All counts are relaxed
+// atomics, so a reader sees a consistent enough picture without ever blocking the
+// recording thread. A reset racing with a record can at worst lose that sample.
+
+class LatencyHistogram
+{
+public:
+	static constexpr int kSubBucketBits = 4;
+	static constexpr int kSubBuckets = 1 << kSubBucketBits;
+	static constexpr int kMaxValueBits = 40;
+	static constexpr int64_t kMaxValue = (int64_t(1) << kMaxValueBits) - 1;
+	static constexpr int kNumBuckets = kSubBuckets + (kMaxValueBits - kSubBucketBits)*kSubBuckets;
+
+	LatencyHistogram() { reset(); }
+	~LatencyHistogram() {}
+
+	void record(int64_t nanos)
+	{
+		if(nanos < 0) nanos = 0;
+		if(nanos > kMaxValue) nanos = kMaxValue;
+
+		mCounts[bucketIndex(nanos)].fetch_add(1, std::memory_order_relaxed);
+		mTotalCount.fetch_add(1, std::memory_order_relaxed);
+		if(nanos > mMax.load(std::memory_order_relaxed))
+		{
+			mMax.store(nanos, std::memory_order_relaxed);
+		}
+	}
+
+	void reset()
+	{
+		for(auto& c : mCounts)
+		{
+			c.store(0, std::memory_order_relaxed);
+		}
+		mTotalCount = 0;
+		mMax = 0;
+	}
+
+	uint64_t getCount() const { return mTotalCount.load(std::memory_order_relaxed); }
+	int64_t getMax() const { return mMax.load(std::memory_order_relaxed); }
+
+	// the smallest value that at least the given percentage of samples are less than or
+	// equal to, reported as the highest value in its bucket.
+	int64_t getValueAtPercentile(double percentile) const
+	{
+		uint64_t total = getCount();
+		if(!total) return 0;
+
+		uint64_t target = (uint64_t)(percentile/100.*total + 0.5);
+		if(target < 1) target = 1;
+		if(target > total) target = total;
+
+		uint64_t sum = 0;
+		for(int i = 0; i < kNumBuckets; ++i)
+		{
+			sum += mCounts[i].load(std::memory_order_relaxed);
+			if(sum >= target)
+			{
+				int64_t v = bucketHighestValue(i);
+				int64_t max = getMax();
+				return (v < max) ? v : max;
+			}
+		}
+		return getMax();
+	}
+
+private:
+	static int highestBit(uint64_t v)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return 63 - __builtin_clzll(v);
+#else
+		int b = 0;
+		while(v >>= 1) b++;
+		return b;
+#endif
+	}
+
+	static int bucketIndex(int64_t v)
+	{
+		if(v < kSubBuckets) return (int)v;
+		int magnitude = highestBit(v) - kSubBucketBits;
+		int sub = (int)(v >> magnitude) - kSubBuckets;
+		return kSubBuckets + magnitude*kSubBuckets + sub;
+	}
+
+	static int64_t bucketHighestValue(int i)
+	{
+		if(i < kSubBuckets) return i;
+		int magnitude = (i - kSubBuckets)/kSubBuckets;
+		int sub = (i - kSubBuckets)%kSubBuckets;
+		return ((int64_t(kSubBuckets + sub) + 1) << magnitude) - 1;
+	}
+
+	std::atomic<uint64_t> mCounts[kNumBuckets];
+	std::atomic<uint64_t> mTotalCount;
+	std::atomic<int64_t> mMax;
+};
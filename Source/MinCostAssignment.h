@@ -0,0 +1,124 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2017 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <array>
+#include <limits>
+
+// MinCostAssignment: the assignment of rows to columns of a cost matrix with the lowest total
+// cost, found exactly by the Hungarian algorithm, for up to N rows and columns.
+//
+// All storage is in the object, so solving allocates nothing. For r rows and c columns,
+// solve() does at most r*r*c steps of constant work, so its time is bounded by the size
+// of the problem and not by the costs.
+
+template< int N >
+class MinCostAssignment
+{
+public:
+	MinCostAssignment() {}
+	~MinCostAssignment() {}
+
+	// the cost of assigning row i to column j.
+	float& cost(int i, int j) { return mCost[i][j]; }
+
+	// assign each of the first rows rows to a different one of the first cols columns, where
+	// rows <= cols <= N, and write the column of each row to rowToCol. Returns the total cost.
+	float solve(int rows, int cols, std::array<int, N>& rowToCol)
+	{
+		const float kInf = std::numeric_limits<float>::max();
+
+		// potentials of rows and columns, and the row in each column, 1-based. Column 0 is
+		// a virtual column holding the row being added.
+		for(int j = 0; j <= cols; ++j)
+		{
+			mV[j] = 0.f;
+			mColRow[j] = 0;
+		}
+		for(int i = 0; i <= rows; ++i)
+		{
+			mU[i] = 0.f;
+		}
+
+		// add the rows one by one, each time along the shortest augmenting path.
+		for(int i = 1; i <= rows; ++i)
+		{
+			mColRow[0] = i;
+			int j0 = 0;
+			for(int j = 0; j <= cols; ++j)
+			{
+				mMinV[j] = kInf;
+				mUsed[j] = false;
+			}
+			do
+			{
+				mUsed[j0] = true;
+				const int i0 = mColRow[j0];
+				float delta = kInf;
+				int j1 = 0;
+				for(int j = 1; j <= cols; ++j)
+				{
+					if(!mUsed[j])
+					{
+						const float reduced = mCost[i0 - 1][j - 1] - mU[i0] - mV[j];
+						if(reduced < mMinV[j])
+						{
+							mMinV[j] = reduced;
+							mWay[j] = j0;
+						}
+						if(mMinV[j] < delta)
+						{
+							delta = mMinV[j];
+							j1 = j;
+						}
+					}
+				}
+				for(int j = 0; j <= cols; ++j)
+				{
+					if(mUsed[j])
+					{
+						mU[mColRow[j]] += delta;
+						mV[j] -= delta;
+					}
+					else
+					{
+						mMinV[j] -= delta;
+					}
+				}
+				j0 = j1;
+			}
+			while(mColRow[j0] != 0);
+
+			// flip the path.
+			do
+			{
+				const int j1 = mWay[j0];
+				mColRow[j0] = mColRow[j1];
+				j0 = j1;
+			}
+			while(j0);
+		}
+
+		float total = 0.f;
+		for(int j = 1; j <= cols; ++j)
+		{
+			if(mColRow[j])
+			{
+				rowToCol[mColRow[j] - 1] = j - 1;
+				total += mCost[mColRow[j] - 1][j - 1];
+			}
+		}
+		return total;
+	}
+
+private:
+	float mCost[N][N];
+	float mU[N + 1];
+	float mV[N + 1];
+	float mMinV[N + 1];
+	int mColRow[N + 1];
+	int mWay[N + 1];
+	bool mUsed[N + 1];
+};
@@ -0,0 +1,94 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "ZoneSet.h"
+
+// PublishedZones: the zones of one process thread, owned by the thread that publishes its
+// parameters. A new zone map is parsed into a new ZoneSet by the publisher, and only a
+// pointer to it goes out with the parameters, so the process thread never parses, allocates
+// or frees zones: it swaps the pointer in and reports the version of each snapshot it has
+// applied. A replaced set is kept until the process thread has applied a snapshot at least as
+// new as the one that replaced it, then freed by the publisher.
+//
+// Readers such as the zone view get the current set from getForReading(). The lock here is
+// only taken by the publisher and those readers, never by the process thread.
+
+class PublishedZones
+{
+public:
+	PublishedZones() {}
+	~PublishedZones() {}
+
+	PublishedZones(const PublishedZones&) = delete;
+	PublishedZones& operator=(const PublishedZones&) = delete;
+
+	// publisher: parse a zone map into a new set, to be published in the snapshot numbered
+	// version. On a parse error the new set has no zones.
+	void load(const std::string& zoneJSON, uint64_t version)
+	{
+		std::shared_ptr< ZoneSet > pZones = std::make_shared< ZoneSet >();
+		pZones->loadFromString(zoneJSON);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		if(mpCurrent)
+		{
+			mRetired.push_back(Retired{mpCurrent, version});
+		}
+		mpCurrent = pZones;
+	}
+
+	// publisher: the set to publish, or null before any are loaded.
+	ZoneSet* getForPublishing()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mpCurrent.get();
+	}
+
+	// publisher: free the replaced sets the process thread can no longer be using.
+	void freeRetired()
+	{
+		const uint64_t applied = mAppliedVersion.load(std::memory_order_acquire);
+		std::vector< Retired > freed;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			auto firstFreed = std::partition(mRetired.begin(), mRetired.end(),
+				[&](const Retired& r){ return r.version > applied; });
+			std::move(firstFreed, mRetired.end(), std::back_inserter(freed));
+			mRetired.erase(firstFreed, mRetired.end());
+		}
+	}
+
+	// any thread but the process thread: the current set, kept alive while the caller holds it.
+	std::shared_ptr< const ZoneSet > getForReading()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mpCurrent;
+	}
+
+	// process thread: report the version of the snapshot just applied.
+	void setAppliedVersion(uint64_t version) { mAppliedVersion.store(version, std::memory_order_release); }
+
+private:
+	struct Retired
+	{
+		std::shared_ptr< ZoneSet > pZones;
+		uint64_t version;
+	};
+
+	std::mutex mMutex;
+	std::shared_ptr< ZoneSet > mpCurrent;
+	std::vector< Retired > mRetired;
+	std::atomic<uint64_t> mAppliedVersion{0};
+};
@@ -0,0 +1,137 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "TouchTracker.h"
+#include "ZoneSet.h"
+#include "SoundplaneMIDIOutput.h"
+#include "SoundplaneOSCOutput.h"
+#include "TripleBuffer.h"
+
+// RealtimeParams: every parameter that a process thread reads while tracking a frame.
+// Property changes are made to the Model's copy, which is then published whole to each
+// process thread through a TripleBuffer. A process thread takes the newest snapshot once
+// per frame and applies it itself, so nothing it uses is looked up in the property map
+// or written by another thread while it runs. This includes the zone and output settings,
+// since the outputs send MIDI. Zone maps are parsed by the publisher: see PublishedZones.h.
+
+struct RealtimeParams
+{
+	// incremented with every change.
+	uint64_t version{0};
+
+	// tracker
+	int maxTouches{4};
+	float zThresh{0.05f};
+	float lopassZ{100.f};
+	float tileThresh{0.f};
+	float onsetThresh{0.f};
+	float predictMs{0.f};
+	bool rotate{false};
+	TouchFinder touchFinder{kFindPeaks};
+	TouchMatcher touchMatcher{kMatchNearest};
+
+	// incremented to ask the Model's process thread to clear its tracker.
+	uint32_t trackerClears{0};
+
+	// pressure scaling, zones and outputs
+	float zScale{1.f};
+	float zCurve{0.5f};
+	float hysteresis{0.5f};
+	int dataRate{100};
+	bool sendMatrix{false};
+
+	// zones, owned by the publisher's PublishedZones. Each process thread is published its
+	// own set. With none, the zones are left as they are.
+	ZoneSet* zones{nullptr};
+	float vibrato{0.5f};
+	bool quantize{true};
+	bool noteLock{false};
+	int transpose{0};
+	float snap{250.f};
+
+	// MIDI and OSC outputs
+	bool midiActive{false};
+	bool midiMPE{true};
+	bool midiMPEExtended{false};
+	int midiChannel{1};
+	bool midiPressureActive{false};
+	bool glissando{false};
+	int bendRange{48};
+	bool oscActive{true};
+};
+
+typedef TripleBuffer< RealtimeParams > RealtimeParamsBuffer;
+
+// DeviceStartup: what a driver's onStartup() learns about the device. It is called on the
+// driver's thread, so this is handed to the process thread in the same way, and applied
+// there to the tracker and outputs.
+struct DeviceStartup
+{
+	int deviceID{0};
+	bool hasCalibration{false};
+	SensorFrame calibrationMean{};
+};
+
+typedef TripleBuffer< DeviceStartup > DeviceStartupBuffer;
+
+// set the tracker parameters in p that differ from those in prev, or all of them if prev
+// is null. Some setters do more than store a value, so unchanged ones are not called again.
+inline void applyTrackerParams(TouchTracker& tracker, const RealtimeParams& p, const RealtimeParams* prev)
+{
+	if(!prev || (p.zThresh != prev->zThresh)) tracker.setThresh(p.zThresh);
+	if(!prev || (p.lopassZ != prev->lopassZ)) tracker.setLopassZ(p.lopassZ);
+	if(!prev || (p.tileThresh != prev->tileThresh)) tracker.setTileThreshold(p.tileThresh);
+	if(!prev || (p.onsetThresh != prev->onsetThresh)) tracker.setOnsetThreshold(p.onsetThresh);
+	if(!prev || (p.predictMs != prev->predictMs)) tracker.setPredictTime(p.predictMs);
+	if(!prev || (p.rotate != prev->rotate)) tracker.setRotate(p.rotate);
+	if(!prev || (p.touchFinder != prev->touchFinder)) tracker.setTouchFinder(p.touchFinder);
+	if(!prev || (p.touchMatcher != prev->touchMatcher)) tracker.setTouchMatcher(p.touchMatcher);
+}
+
+// true if p has new zones, or new zone parameters.
+inline bool zonesChanged(const RealtimeParams& p, const RealtimeParams* prev)
+{
+	return p.zones && (!prev || (p.zones != prev->zones));
+}
+
+inline bool zoneParamsChanged(const RealtimeParams& p, const RealtimeParams* prev)
+{
+	return !prev || (p.vibrato != prev->vibrato) || (p.hysteresis != prev->hysteresis) ||
+		(p.quantize != prev->quantize) || (p.noteLock != prev->noteLock) ||
+		(p.transpose != prev->transpose) || (p.snap != prev->snap);
+}
+
+inline void applyZoneParams(ZoneSet& zones, const RealtimeParams& p)
+{
+	zones.setParameters(p.vibrato, p.hysteresis, p.quantize, p.noteLock, p.transpose, p.snap);
+}
+
+// set the output parameters in p that differ from those in prev, or all of them if prev is
+// null. Without MPE, an output sends on the channel channelOffset after p.midiChannel.
+inline void applyOutputParams(SoundplaneMIDIOutput& midi, SoundplaneOSCOutput& osc, const RealtimeParams& p, const RealtimeParams* prev, int channelOffset)
+{
+	if(!prev || (p.maxTouches != prev->maxTouches))
+	{
+		midi.setMaxTouches(p.maxTouches);
+		osc.setMaxTouches(p.maxTouches);
+	}
+	if(!prev || (p.dataRate != prev->dataRate))
+	{
+		midi.setDataRate(p.dataRate);
+		osc.setDataRate(p.dataRate);
+	}
+	if(!prev || (p.midiActive != prev->midiActive)) midi.setActive(p.midiActive);
+	if(!prev || (p.midiMPE != prev->midiMPE)) midi.setMPE(p.midiMPE);
+	if(!prev || (p.midiMPEExtended != prev->midiMPEExtended)) midi.setMPEExtended(p.midiMPEExtended);
+	if(!prev || (p.midiChannel != prev->midiChannel)) midi.setStartChannel(ml::clamp(p.midiChannel + channelOffset, 1, 16));
+	if(!prev || (p.midiPressureActive != prev->midiPressureActive)) midi.setPressureActive(p.midiPressureActive);
+	if(!prev || (p.glissando != prev->glissando)) midi.setGlissando(p.glissando);
+	if(!prev || (p.hysteresis != prev->hysteresis)) midi.setHysteresis(p.hysteresis);
+	if(!prev || (p.bendRange != prev->bendRange)) midi.setBendRange(p.bendRange);
+	if(!prev || (p.oscActive != prev->oscActive)) osc.setActive(p.oscActive);
+}
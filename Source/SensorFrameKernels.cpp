@@ -0,0 +1,494 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2017 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "SensorFrameKernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if SENSOR_FRAME_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+// to match the unfused operations bit for bit, products must be rounded before they are added,
+// even where the target has fused multiply-add.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize ("fp-contract=off")
+#else
+#pragma STDC FP_CONTRACT OFF
+#endif
+
+namespace
+{
+	// missing neighbors at the edges are taken to be -0. Adding -0 to any float x gives
+	// exactly x, including the sign of a zero, so a sum over two neighbors with a -0
+	// pad is the same as the edge sum of smoothPressureX() and smoothPressureY().
+	constexpr float kPad = -0.f;
+
+	// rows with room for a pad on either side. The pad is 4 floats to keep the rows aligned.
+	constexpr int kRowPad = 4;
+	template< int width, int height >
+	struct alignas(16) PaddedFrame
+	{
+		static constexpr int paddedWidth = kRowPad + width + kRowPad;
+		float data[height][paddedWidth];
+		float* row(int j) { return data[j] + kRowPad; }
+
+		// pad the columns [i0, i1). Inside the frame, the results within the number of
+		// x passes of a pad are not those of the whole frame.
+		void setPads(int i0, int i1)
+		{
+			for(int j = 0; j < height; ++j)
+			{
+				data[j][kRowPad + i0 - 1] = data[j][kRowPad + i1] = kPad;
+			}
+		}
+	};
+
+	// the input columns needed to smooth the output columns [c0, c1) with the given number of
+	// x passes, rounded out to groups of four.
+	template< int width, int passesX >
+	inline void getSmoothInputColumns(int c0, int c1, int& i0, int& i1)
+	{
+		i0 = std::max(0, c0 - passesX) & ~3;
+		i1 = std::min(width, (c1 + passesX + 3) & ~3);
+	}
+
+	// write the bits for the columns [i, i + 4) of a row mask. i is a multiple of 4, so the
+	// bits are all in one word.
+	template< int width >
+	inline void setRowMaskBits4(SensorFrameKernels::RowMask<width>& row, int i, uint64_t bits)
+	{
+		uint64_t& word = row[i >> 6];
+		const int shift = i & 63;
+		word = (word & ~(uint64_t(0xF) << shift)) | (bits << shift);
+	}
+}
+
+// --------------------------------------------------------------------------------
+#pragma mark scalar
+
+namespace SensorFrameKernels
+{
+namespace scalar
+{
+namespace
+{
+	// x smoothing of the columns [i0, i1). Returns the frame holding the result.
+	template< int kWidth, int kHeight, int kSmoothPassesX >
+	PaddedFrame<kWidth, kHeight>* smoothFrameX(PaddedFrame<kWidth, kHeight>* a, PaddedFrame<kWidth, kHeight>* b, int i0, int i1)
+	{
+		for(int p = 0; p < kSmoothPassesX; ++p)
+		{
+			for(int j = 0; j < kHeight; ++j)
+			{
+				const float* pIn = a->row(j);
+				float* pOut = b->row(j);
+				for(int i = i0; i < i1; ++i)
+				{
+					pOut[i] = pIn[i - 1] + pIn[i] + pIn[i + 1];
+				}
+			}
+			std::swap(a, b);
+		}
+		return a;
+	}
+
+	// y smoothing and scale of the columns [c0, c1), into out.
+	template< int kWidth, int kHeight, int kSmoothPassesY >
+	void smoothColumnsY(PaddedFrame<kWidth, kHeight>* a, PaddedFrame<kWidth, kHeight>* b, int c0, int c1,
+		Frame<kWidth, kHeight>& out)
+	{
+		for(int p = 0; p < kSmoothPassesY; ++p)
+		{
+			for(int j = 0; j < kHeight; ++j)
+			{
+				const float* pAbove = (j > 0) ? a->row(j - 1) : nullptr;
+				const float* pRow = a->row(j);
+				const float* pBelow = (j < kHeight - 1) ? a->row(j + 1) : nullptr;
+				float* pOut = b->row(j);
+				for(int i = c0; i < c1; ++i)
+				{
+					pOut[i] = (pAbove ? pAbove[i] : kPad) + pRow[i] + (pBelow ? pBelow[i] : kPad);
+				}
+			}
+			std::swap(a, b);
+		}
+
+		const float scale = 1.f/64.f;
+		for(int j = 0; j < kHeight; ++j)
+		{
+			const float* pRow = a->row(j);
+			for(int i = c0; i < c1; ++i)
+			{
+				out[j*kWidth + i] = pRow[i]*scale;
+			}
+		}
+	}
+}
+
+	template< int kWidth, int kHeight, int kSmoothPassesX, int kSmoothPassesY >
+	void calibrateAndSmoothPressure(const Frame<kWidth, kHeight>& in, const Frame<kWidth, kHeight>* pGain,
+		Frame<kWidth, kHeight>* pCalibrated, Frame<kWidth, kHeight>& inputZ1, float k, Frame<kWidth, kHeight>& out)
+	{
+		const float k1 = 1.f - k;
+		PaddedFrame<kWidth, kHeight> a, b;
+		a.setPads(0, kWidth);
+		b.setPads(0, kWidth);
+
+		// calibrate, IIR and clip.
+		for(int n = 0; n < kHeight*kWidth; ++n)
+		{
+			float x = in[n];
+			if(pGain)
+			{
+				x = x*(*pGain)[n] - 1.0f;
+				if(pCalibrated) (*pCalibrated)[n] = x;
+			}
+			float y = x*k + inputZ1[n]*k1;
+			inputZ1[n] = y;
+			a.row(n/kWidth)[n%kWidth] = std::max(y, 0.f);
+		}
+
+		PaddedFrame<kWidth, kHeight>* pa = smoothFrameX<kWidth, kHeight, kSmoothPassesX>(&a, &b, 0, kWidth);
+		PaddedFrame<kWidth, kHeight>* pb = (pa == &a) ? &b : &a;
+		smoothColumnsY<kWidth, kHeight, kSmoothPassesY>(pa, pb, 0, kWidth, out);
+	}
+
+	template< int kWidth, int kHeight, int kSmoothPassesX, int kSmoothPassesY >
+	void smoothPressureColumns(const Frame<kWidth, kHeight>& clipped, int c0, int c1, Frame<kWidth, kHeight>& out)
+	{
+		int i0, i1;
+		getSmoothInputColumns<kWidth, kSmoothPassesX>(c0, c1, i0, i1);
+		PaddedFrame<kWidth, kHeight> a, b;
+		a.setPads(i0, i1);
+		b.setPads(i0, i1);
+
+		for(int j = 0; j < kHeight; ++j)
+		{
+			std::copy(clipped.data() + j*kWidth + i0, clipped.data() + j*kWidth + i1, a.row(j) + i0);
+		}
+
+		PaddedFrame<kWidth, kHeight>* pa = smoothFrameX<kWidth, kHeight, kSmoothPassesX>(&a, &b, i0, i1);
+		PaddedFrame<kWidth, kHeight>* pb = (pa == &a) ? &b : &a;
+		smoothColumnsY<kWidth, kHeight, kSmoothPassesY>(pa, pb, c0, c1, out);
+	}
+	template< int kWidth, int kHeight >
+	void calibrate(const Frame<kWidth, kHeight>& raw, const Frame<kWidth, kHeight>& gain, Frame<kWidth, kHeight>& out)
+	{
+		for(int n = 0; n < kHeight*kWidth; ++n)
+		{
+			out[n] = raw[n]*gain[n] - 1.0f;
+		}
+	}
+
+	template< int kWidth, int kHeight >
+	std::bitset<kWidth> getChangedColumns(const Frame<kWidth, kHeight>& a, const Frame<kWidth, kHeight>& b, float threshold)
+	{
+		std::bitset<kWidth> changed;
+		for(int j = 0; j < kHeight; ++j)
+		{
+			for(int i = 0; i < kWidth; ++i)
+			{
+				if(std::fabs(a[j*kWidth + i] - b[j*kWidth + i]) > threshold) changed.set(i);
+			}
+		}
+		return changed;
+	}
+
+	template< int kWidth, int kHeight >
+	void findPeaks(const Frame<kWidth, kHeight>& in, float threshold, int c0, int c1, PeakMap<kWidth, kHeight>& peaks)
+	{
+		for(int j = 0; j < kHeight; ++j)
+		{
+			const float* pRow = in.data() + j*kWidth;
+			const float* pAbove = (j > 0) ? pRow - kWidth : nullptr;
+			const float* pBelow = (j < kHeight - 1) ? pRow + kWidth : nullptr;
+			for(int i = c0; i < c1; i += 4)
+			{
+				uint64_t bits = 0;
+				for(int k = 0; k < 4; ++k)
+				{
+					const int x = i + k;
+					if((x < 1) || (x > kWidth - 2)) continue;
+
+					const float z = pRow[x];
+					bool peak = (z > threshold) && (z > pRow[x - 1]) && (z > pRow[x + 1]);
+					if(pAbove)
+					{
+						peak = peak && (z > pAbove[x - 1]) && (z > pAbove[x]) && (z > pAbove[x + 1]);
+					}
+					if(pBelow)
+					{
+						peak = peak && (z > pBelow[x - 1]) && (z > pBelow[x]) && (z > pBelow[x + 1]);
+					}
+					if(peak) bits |= (uint64_t(1) << k);
+				}
+				setRowMaskBits4<kWidth>(peaks[j], i, bits);
+			}
+		}
+	}
+}
+}
+
+// --------------------------------------------------------------------------------
+#pragma mark SSE2
+
+#if SENSOR_FRAME_KERNELS_SSE2
+
+namespace SensorFrameKernels
+{
+namespace sse2
+{
+namespace
+{
+	// one smoothPressureX() pass over the columns [i0, i1). Passes are done over all rows in turn,
+	// so the stores of one pass have left the store buffer by the time the unaligned
+	// loads of the next pass read them.
+	template< int kWidth, int kHeight >
+	inline void smoothFrameX(PaddedFrame<kWidth, kHeight>& in, PaddedFrame<kWidth, kHeight>& out, int i0, int i1)
+	{
+		for(int j = 0; j < kHeight; ++j)
+		{
+			const float* pIn = in.row(j);
+			float* pOut = out.row(j);
+			for(int i = i0; i < i1; i += 4)
+			{
+				__m128 l = _mm_loadu_ps(pIn + i - 1);
+				__m128 c = _mm_load_ps(pIn + i);
+				__m128 r = _mm_loadu_ps(pIn + i + 1);
+				_mm_store_ps(pOut + i, _mm_add_ps(_mm_add_ps(l, c), r));
+			}
+		}
+	}
+
+	// y smoothing and scale of the columns [c0, c1), into out. Each group of four columns
+	// is held for all rows and all passes.
+	template< int kWidth, int kHeight, int kSmoothPassesY >
+	inline void smoothColumnsY(PaddedFrame<kWidth, kHeight>& a, int c0, int c1, Frame<kWidth, kHeight>& out)
+	{
+		const __m128 vScale = _mm_set1_ps(1.f/64.f);
+		const __m128 pad = _mm_set1_ps(kPad);
+		for(int i = c0; i < c1; i += 4)
+		{
+			__m128 c[kHeight], d[kHeight];
+			for(int j = 0; j < kHeight; ++j)
+			{
+				c[j] = _mm_load_ps(a.row(j) + i);
+			}
+			for(int p = 0; p < kSmoothPassesY; ++p)
+			{
+				for(int j = 0; j < kHeight; ++j)
+				{
+					__m128 above = (j > 0) ? c[j - 1] : pad;
+					__m128 below = (j < kHeight - 1) ? c[j + 1] : pad;
+					d[j] = _mm_add_ps(_mm_add_ps(above, c[j]), below);
+				}
+				std::copy(d, d + kHeight, c);
+			}
+			for(int j = 0; j < kHeight; ++j)
+			{
+				_mm_storeu_ps(out.data() + j*kWidth + i, _mm_mul_ps(c[j], vScale));
+			}
+		}
+	}
+
+	// the neighbors to the left and right of the columns [i, i + 4) of a row. Past the
+	// edges of the row, the lanes are shifted in as 0. Only the first and last columns see
+	// those, and they are never peaks.
+	template< int kWidth >
+	inline __m128 loadLeft(const float* pRow, int i)
+	{
+		return (i > 0) ? _mm_loadu_ps(pRow + i - 1) :
+			_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(_mm_loadu_ps(pRow)), 4));
+	}
+
+	template< int kWidth >
+	inline __m128 loadRight(const float* pRow, int i)
+	{
+		return (i + 4 < kWidth) ? _mm_loadu_ps(pRow + i + 1) :
+			_mm_castsi128_ps(_mm_srli_si128(_mm_castps_si128(_mm_loadu_ps(pRow + i)), 4));
+	}
+
+	// lanes where z is greater than the three neighbors in another row.
+	template< int kWidth >
+	inline __m128 greaterThanRow(__m128 z, const float* pRow, int i)
+	{
+		__m128 m = _mm_cmpgt_ps(z, _mm_loadu_ps(pRow + i));
+		m = _mm_and_ps(m, _mm_cmpgt_ps(z, loadLeft<kWidth>(pRow, i)));
+		return _mm_and_ps(m, _mm_cmpgt_ps(z, loadRight<kWidth>(pRow, i)));
+	}
+}
+
+	template< int kWidth, int kHeight, int kSmoothPassesX, int kSmoothPassesY >
+	void calibrateAndSmoothPressure(const Frame<kWidth, kHeight>& in, const Frame<kWidth, kHeight>* pGain,
+		Frame<kWidth, kHeight>* pCalibrated, Frame<kWidth, kHeight>& inputZ1, float k, Frame<kWidth, kHeight>& out)
+	{
+		static_assert(kWidth % 4 == 0, "SSE2 kernel needs a width that is a multiple of 4");
+		static_assert(kSmoothPassesX % 2 == 0, "SSE2 kernel needs an even number of x passes");
+
+		const __m128 vk = _mm_set1_ps(k);
+		const __m128 vk1 = _mm_set1_ps(1.f - k);
+		const __m128 vZero = _mm_setzero_ps();
+		const __m128 vOne = _mm_set1_ps(1.0f);
+
+		PaddedFrame<kWidth, kHeight> a, b;
+		a.setPads(0, kWidth);
+		b.setPads(0, kWidth);
+
+		// calibrate, IIR and clip.
+		for(int j = 0; j < kHeight; ++j)
+		{
+			const float* pIn = in.data() + j*kWidth;
+			const float* pGainRow = pGain ? pGain->data() + j*kWidth : nullptr;
+			float* pCalibratedRow = pCalibrated ? pCalibrated->data() + j*kWidth : nullptr;
+			float* pZ1 = inputZ1.data() + j*kWidth;
+			float* pa = a.row(j);
+			for(int i = 0; i < kWidth; i += 4)
+			{
+				__m128 x = _mm_loadu_ps(pIn + i);
+				if(pGainRow)
+				{
+					x = _mm_sub_ps(_mm_mul_ps(x, _mm_loadu_ps(pGainRow + i)), vOne);
+					if(pCalibratedRow) _mm_storeu_ps(pCalibratedRow + i, x);
+				}
+				__m128 y = _mm_add_ps(_mm_mul_ps(x, vk), _mm_mul_ps(_mm_loadu_ps(pZ1 + i), vk1));
+				_mm_storeu_ps(pZ1 + i, y);
+
+				// max(0, y) rather than max(y, 0) returns y for -0 and NaN, as std::max(y, 0.f) does.
+				_mm_store_ps(pa + i, _mm_max_ps(vZero, y));
+			}
+		}
+
+		// x smoothing.
+		for(int p = 0; p < kSmoothPassesX/2; ++p)
+		{
+			smoothFrameX(a, b, 0, kWidth);
+			smoothFrameX(b, a, 0, kWidth);
+		}
+
+		// y smoothing and scale.
+		smoothColumnsY<kWidth, kHeight, kSmoothPassesY>(a, 0, kWidth, out);
+	}
+
+	template< int kWidth, int kHeight, int kSmoothPassesX, int kSmoothPassesY >
+	void smoothPressureColumns(const Frame<kWidth, kHeight>& clipped, int c0, int c1, Frame<kWidth, kHeight>& out)
+	{
+		static_assert(kWidth % 4 == 0, "SSE2 kernel needs a width that is a multiple of 4");
+		static_assert(kSmoothPassesX % 2 == 0, "SSE2 kernel needs an even number of x passes");
+
+		int i0, i1;
+		getSmoothInputColumns<kWidth, kSmoothPassesX>(c0, c1, i0, i1);
+		PaddedFrame<kWidth, kHeight> a, b;
+		a.setPads(i0, i1);
+		b.setPads(i0, i1);
+
+		for(int j = 0; j < kHeight; ++j)
+		{
+			const float* pIn = clipped.data() + j*kWidth;
+			float* pa = a.row(j);
+			for(int i = i0; i < i1; i += 4)
+			{
+				_mm_store_ps(pa + i, _mm_loadu_ps(pIn + i));
+			}
+		}
+
+		for(int p = 0; p < kSmoothPassesX/2; ++p)
+		{
+			smoothFrameX(a, b, i0, i1);
+			smoothFrameX(b, a, i0, i1);
+		}
+		smoothColumnsY<kWidth, kHeight, kSmoothPassesY>(a, c0, c1, out);
+	}
+	template< int kWidth, int kHeight >
+	void calibrate(const Frame<kWidth, kHeight>& raw, const Frame<kWidth, kHeight>& gain, Frame<kWidth, kHeight>& out)
+	{
+		static_assert(kWidth % 4 == 0, "SSE2 kernel needs a width that is a multiple of 4");
+
+		const __m128 vOne = _mm_set1_ps(1.0f);
+		for(int n = 0; n < kHeight*kWidth; n += 4)
+		{
+			__m128 x = _mm_mul_ps(_mm_loadu_ps(raw.data() + n), _mm_loadu_ps(gain.data() + n));
+			_mm_storeu_ps(out.data() + n, _mm_sub_ps(x, vOne));
+		}
+	}
+
+	template< int kWidth, int kHeight >
+	std::bitset<kWidth> getChangedColumns(const Frame<kWidth, kHeight>& a, const Frame<kWidth, kHeight>& b, float threshold)
+	{
+		static_assert(kWidth % 4 == 0, "SSE2 kernel needs a width that is a multiple of 4");
+
+		// clearing the sign bit gives the absolute value.
+		const __m128 vAbsMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		const __m128 vThreshold = _mm_set1_ps(threshold);
+		std::bitset<kWidth> changed;
+		for(int i = 0; i < kWidth; i += 4)
+		{
+			__m128 any = _mm_setzero_ps();
+			for(int j = 0; j < kHeight; ++j)
+			{
+				__m128 d = _mm_sub_ps(_mm_loadu_ps(a.data() + j*kWidth + i), _mm_loadu_ps(b.data() + j*kWidth + i));
+				any = _mm_or_ps(any, _mm_cmpgt_ps(_mm_and_ps(d, vAbsMask), vThreshold));
+			}
+			int bits = _mm_movemask_ps(any);
+			for(int k = 0; k < 4; ++k)
+			{
+				if(bits & (1 << k)) changed.set(i + k);
+			}
+		}
+		return changed;
+	}
+
+	template< int kWidth, int kHeight >
+	void findPeaks(const Frame<kWidth, kHeight>& in, float threshold, int c0, int c1, PeakMap<kWidth, kHeight>& peaks)
+	{
+		static_assert(kWidth % 4 == 0, "SSE2 kernel needs a width that is a multiple of 4");
+
+		const __m128 vThreshold = _mm_set1_ps(threshold);
+		for(int j = 0; j < kHeight; ++j)
+		{
+			const float* pRow = in.data() + j*kWidth;
+			const float* pAbove = (j > 0) ? pRow - kWidth : nullptr;
+			const float* pBelow = (j < kHeight - 1) ? pRow + kWidth : nullptr;
+			for(int i = c0; i < c1; i += 4)
+			{
+				const __m128 z = _mm_loadu_ps(pRow + i);
+				__m128 m = _mm_cmpgt_ps(z, vThreshold);
+				m = _mm_and_ps(m, _mm_cmpgt_ps(z, loadLeft<kWidth>(pRow, i)));
+				m = _mm_and_ps(m, _mm_cmpgt_ps(z, loadRight<kWidth>(pRow, i)));
+				if(pAbove) m = _mm_and_ps(m, greaterThanRow<kWidth>(z, pAbove, i));
+				if(pBelow) m = _mm_and_ps(m, greaterThanRow<kWidth>(z, pBelow, i));
+
+				uint64_t bits = _mm_movemask_ps(m);
+				if(i == 0) bits &= ~uint64_t(1);
+				if(i + 4 == kWidth) bits &= ~uint64_t(8);
+				setRowMaskBits4<kWidth>(peaks[j], i, bits);
+			}
+		}
+	}
+}
+}
+
+#endif
+
+// --------------------------------------------------------------------------------
+#pragma mark instantiations
+
+// one for each surface.
+#define INSTANTIATE_SENSOR_FRAME_KERNELS(NS, T) \
+	template void SensorFrameKernels::NS::calibrateAndSmoothPressure< T::width, T::height, T::smoothPassesX, T::smoothPassesY > \
+		(const T::Frame&, const T::Frame*, T::Frame*, T::Frame&, float, T::Frame&); \
+	template void SensorFrameKernels::NS::smoothPressureColumns< T::width, T::height, T::smoothPassesX, T::smoothPassesY > \
+		(const T::Frame&, int, int, T::Frame&); \
+	template void SensorFrameKernels::NS::calibrate< T::width, T::height > \
+		(const T::Frame&, const T::Frame&, T::Frame&); \
+	template std::bitset< T::width > SensorFrameKernels::NS::getChangedColumns< T::width, T::height > \
+		(const T::Frame&, const T::Frame&, float); \
+	template void SensorFrameKernels::NS::findPeaks< T::width, T::height > \
+		(const T::Frame&, float, int, int, SensorFrameKernels::PeakMap< T::width, T::height >&);
+
+INSTANTIATE_SENSOR_FRAME_KERNELS(scalar, SoundplaneATrackerTraits)
+#if SENSOR_FRAME_KERNELS_SSE2
+INSTANTIATE_SENSOR_FRAME_KERNELS(sse2, SoundplaneATrackerTraits)
+#endif
@@ -0,0 +1,140 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2017 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+#include "SensorFrame.h"
+#include "TouchTrackerTraits.h"
+
+// SensorFrameKernels: fused, vectorized versions of chains of SensorFrame operations that
+// run every frame. Each gives the same result, bit for bit, as the chain it replaces:
+// the same float operations are done in the same order, only without the temporary frames.
+// Each kernel has a scalar variant and, where SSE2 is available, a SIMD variant. The
+// functions at global scope call the fastest one available.
+//
+// The kernels are templates over the frame size and number of passes, so that all loop
+// bounds are constants. They are instantiated in SensorFrameKernels.cpp for each surface.
+
+#if defined(__SSE2__)
+#define SENSOR_FRAME_KERNELS_SSE2 1
+#endif
+
+namespace SensorFrameKernels
+{
+	template< int width, int height >
+	using Frame = std::array< float, width*height >;
+
+	// one bit per column of a row, in 64-bit words, lowest column in the lowest bit of the
+	// first word. The set columns can be enumerated by counting trailing zeros.
+	template< int width >
+	using RowMask = std::array< uint64_t, (width + 63)/64 >;
+
+	template< int width, int height >
+	using PeakMap = std::array< RowMask<width>, height >;
+
+	// calibrateAndSmoothPressure: calibrate and smooth. If pGain is null, the input is already
+	// calibrated. See below.
+	//
+	// smoothPressureColumns: the smoothing part only, for the output columns [c0, c1). clipped
+	// is the input after the IIR filter and clip. Only the columns of out in the range are
+	// written, and they are the same as smoothing the whole frame would make. c0 and c1 must
+	// be multiples of 4.
+	//
+	// calibrate: out = raw*gain - 1, as calibrateAndSmoothPressure() calibrates.
+	//
+	// getChangedColumns: the columns where any value of a differs from b by more than threshold.
+	//
+	// findPeaks: the local maxima of in: the sensors greater than threshold and than each of
+	// their neighbors, in the columns [c0, c1). Rows above the first and below the last are
+	// missing and not compared. Sensors in the first and last columns are never peaks. Only
+	// the bits of peaks in the range are written. c0 and c1 must be multiples of 4.
+	namespace scalar
+	{
+		template< int width, int height, int passesX, int passesY >
+		void calibrateAndSmoothPressure(const Frame<width, height>& in, const Frame<width, height>* pGain,
+			Frame<width, height>* pCalibrated, Frame<width, height>& inputZ1, float k, Frame<width, height>& out);
+
+		template< int width, int height, int passesX, int passesY >
+		void smoothPressureColumns(const Frame<width, height>& clipped, int c0, int c1, Frame<width, height>& out);
+
+		template< int width, int height >
+		void calibrate(const Frame<width, height>& raw, const Frame<width, height>& gain, Frame<width, height>& out);
+
+		template< int width, int height >
+		std::bitset<width> getChangedColumns(const Frame<width, height>& a, const Frame<width, height>& b, float threshold);
+
+		template< int width, int height >
+		void findPeaks(const Frame<width, height>& in, float threshold, int c0, int c1, PeakMap<width, height>& peaks);
+	}
+
+#if SENSOR_FRAME_KERNELS_SSE2
+	namespace sse2
+	{
+		template< int width, int height, int passesX, int passesY >
+		void calibrateAndSmoothPressure(const Frame<width, height>& in, const Frame<width, height>* pGain,
+			Frame<width, height>* pCalibrated, Frame<width, height>& inputZ1, float k, Frame<width, height>& out);
+
+		template< int width, int height, int passesX, int passesY >
+		void smoothPressureColumns(const Frame<width, height>& clipped, int c0, int c1, Frame<width, height>& out);
+
+		template< int width, int height >
+		void calibrate(const Frame<width, height>& raw, const Frame<width, height>& gain, Frame<width, height>& out);
+
+		template< int width, int height >
+		std::bitset<width> getChangedColumns(const Frame<width, height>& a, const Frame<width, height>& b, float threshold);
+
+		template< int width, int height >
+		void findPeaks(const Frame<width, height>& in, float threshold, int c0, int c1, PeakMap<width, height>& peaks);
+	}
+	namespace fastest = sse2;
+#else
+	namespace fastest = scalar;
+#endif
+}
+
+// the smoothing part of TouchTracker::preprocess() for the Soundplane A, in one pass. Equivalent to:
+//
+//	y = add(multiply(in, k), multiply(inputZ1, 1 - k));
+//	inputZ1 = y;
+//	y = max(y, 0.f);
+//	y = smoothPressureX(smoothPressureX(smoothPressureX(smoothPressureX(y))));
+//	y = smoothPressureY(smoothPressureY(smoothPressureY(y)));
+//	out = multiply(y, 1.f/64.f);
+//
+// inputZ1 is the IIR filter state and is updated. out may not be the same frame as in.
+inline void smoothPressureFused(const SensorFrame& in, SensorFrame& inputZ1, float k, SensorFrame& out)
+{
+	typedef SoundplaneATrackerTraits T;
+	SensorFrameKernels::fastest::calibrateAndSmoothPressure< T::width, T::height, T::smoothPassesX, T::smoothPassesY >
+		(in, nullptr, nullptr, inputZ1, k, out);
+}
+
+// calibration followed by smoothPressureFused(), in the same pass. The calibrated input is
+//
+//	calibrated = subtract(multiply(raw, gain), 1.0f);
+//
+// where gain is the inverse of the mean sensor values at rest. The calibrated frame is also
+// written to pCalibrated, if it is not null.
+inline void calibrateAndSmoothPressureFused(const SensorFrame& raw, const SensorFrame& gain, SensorFrame* pCalibrated,
+	SensorFrame& inputZ1, float k, SensorFrame& out)
+{
+	typedef SoundplaneATrackerTraits T;
+	SensorFrameKernels::fastest::calibrateAndSmoothPressure< T::width, T::height, T::smoothPassesX, T::smoothPassesY >
+		(raw, &gain, pCalibrated, inputZ1, k, out);
+}
+
+// getCurvatureXY(in), written to out. getCurvatureXY() is in soundplanelib and returns a new
+// frame. Here that frame is constructed in the storage of out, so there is no temporary frame
+// and no copy of it. out may not be the same frame as in.
+inline void getCurvatureXYInto(const SensorFrame& in, SensorFrame& out)
+{
+	static_assert(std::is_trivially_destructible< SensorFrame >::value, "out is reused without being destroyed");
+	::new (static_cast< void* >(&out)) SensorFrame(getCurvatureXY(in));
+}
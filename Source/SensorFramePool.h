@@ -0,0 +1,145 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <cassert>
+#include <stdint.h>
+
+#include "SensorFrame.h"
+#include "FrameRing.h"
+
+// SensorFramePool: a fixed set of preallocated, reference counted sensor frame buffers.
+// A frame is written once into a buffer from the pool, then every consumer holds a
+// SensorFrameHandle to that buffer instead of a copy. The buffer goes back to the pool
+// when the last handle is released. Acquiring and releasing are lock-free and never
+// allocate, so they can be done from the driver callback.
+
+struct SensorFrameBuffer
+{
+	SensorFrame frame{};
+
+	// monotonic time at which the frame was received, in nanoseconds.
+	int64_t timestamp{0};
+
+	std::atomic<int> refCount{0};
+};
+
+class SensorFrameHandle
+{
+public:
+	SensorFrameHandle() {}
+	SensorFrameHandle(const SensorFrameHandle& b) : mpBuffer(b.mpBuffer) { retain(); }
+	SensorFrameHandle(SensorFrameHandle&& b) : mpBuffer(b.mpBuffer) { b.mpBuffer = nullptr; }
+	~SensorFrameHandle() { release(); }
+
+	SensorFrameHandle& operator=(SensorFrameHandle b)
+	{
+		std::swap(mpBuffer, b.mpBuffer);
+		return *this;
+	}
+
+	// take over a reference previously given up with detach().
+	static SensorFrameHandle adopt(SensorFrameBuffer* p) { return SensorFrameHandle(p); }
+
+	// give up our reference without releasing it, for passing through a FrameRing.
+	SensorFrameBuffer* detach()
+	{
+		SensorFrameBuffer* p = mpBuffer;
+		mpBuffer = nullptr;
+		return p;
+	}
+
+	void reset() { release(); }
+
+	explicit operator bool() const { return mpBuffer != nullptr; }
+
+	const SensorFrame& getFrame() const { return mpBuffer->frame; }
+	const SensorFrame& operator*() const { return mpBuffer->frame; }
+	int64_t getTimestamp() const { return mpBuffer->timestamp; }
+
+	// only the holder of a freshly acquired buffer may write to it.
+	SensorFrame& getFrameForWriting()
+	{
+		assert(mpBuffer->refCount.load() == 1);
+		return mpBuffer->frame;
+	}
+	void setTimestamp(int64_t t) { mpBuffer->timestamp = t; }
+
+private:
+	explicit SensorFrameHandle(SensorFrameBuffer* p) : mpBuffer(p) {}
+
+	void retain()
+	{
+		if(mpBuffer)
+		{
+			mpBuffer->refCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	void release()
+	{
+		if(mpBuffer)
+		{
+			mpBuffer->refCount.fetch_sub(1, std::memory_order_acq_rel);
+			mpBuffer = nullptr;
+		}
+	}
+
+	SensorFrameBuffer* mpBuffer{nullptr};
+};
+
+// release the reference held by a buffer pointer dropped from a FrameRing.
+struct SensorFrameBufferRelease
+{
+	static void dispose(SensorFrameBuffer*& p)
+	{
+		SensorFrameHandle dropped = SensorFrameHandle::adopt(p);
+		p = nullptr;
+	}
+};
+
+typedef FrameRing< SensorFrameBuffer*, SensorFrameBufferRelease > SensorFrameBufferRing;
+
+class SensorFramePool
+{
+public:
+	explicit SensorFramePool(int size) :
+	mSize(size),
+	mBuffers(new SensorFrameBuffer[size])
+	{
+	}
+
+	~SensorFramePool() {}
+
+	// get an unused buffer, or an empty handle if all buffers are in use.
+	SensorFrameHandle acquire()
+	{
+		int start = mNextIndex.load(std::memory_order_relaxed);
+		for(int n = 0; n < mSize; ++n)
+		{
+			int i = (start + n) % mSize;
+			int expected = 0;
+			if(mBuffers[i].refCount.compare_exchange_strong(expected, 1, std::memory_order_acq_rel))
+			{
+				mNextIndex.store((i + 1) % mSize, std::memory_order_relaxed);
+				return SensorFrameHandle::adopt(&mBuffers[i]);
+			}
+		}
+		mExhaustedCount.fetch_add(1, std::memory_order_relaxed);
+		return SensorFrameHandle();
+	}
+
+	int getSize() const { return mSize; }
+	int getExhaustedCount() const { return mExhaustedCount.load(std::memory_order_relaxed); }
+
+private:
+	const int mSize;
+	std::unique_ptr< SensorFrameBuffer[] > mBuffers;
+	std::atomic<int> mNextIndex{0};
+	std::atomic<int> mExhaustedCount{0};
+};
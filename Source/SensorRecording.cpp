@@ -0,0 +1,144 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "SensorRecording.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "MLDebug.h"
+
+// how long the writer sleeps when there are no frames to write.
+const int kSensorRecorderWriteIntervalMillis = 2;
+
+void initSensorRecordingHeader(SensorRecordingHeader& h)
+{
+	std::memset(&h, 0, sizeof(h));
+	std::memcpy(h.magic, kSensorRecordingMagic, sizeof(h.magic));
+	h.version = kSensorRecordingVersion;
+	h.headerSize = sizeof(SensorRecordingHeader);
+	h.frameRecordSize = sizeof(SensorRecordingFrame);
+	h.width = SensorGeometry::width;
+	h.height = SensorGeometry::height;
+}
+
+const char* validateSensorRecordingHeader(const SensorRecordingHeader& h, size_t fileSize)
+{
+	if(fileSize < sizeof(SensorRecordingHeader)) return "file too small";
+	if(std::memcmp(h.magic, kSensorRecordingMagic, sizeof(h.magic))) return "not a sensor recording";
+	if(h.version != kSensorRecordingVersion) return "unsupported version";
+	if(h.headerSize < sizeof(SensorRecordingHeader) || h.headerSize > fileSize) return "bad header size";
+	if(h.headerSize % alignof(SensorRecordingFrame)) return "misaligned header size";
+	if(h.frameRecordSize != sizeof(SensorRecordingFrame)) return "bad frame size";
+	if((h.width != SensorGeometry::width) || (h.height != SensorGeometry::height)) return "sensor geometry does not match";
+	if(h.numCarriers > kSensorRecordingMaxCarriers) return "bad carrier count";
+	return nullptr;
+}
+
+// --------------------------------------------------------------------------------
+#pragma mark SensorFrameRecorder
+
+SensorFrameRecorder::SensorFrameRecorder()
+{
+	// never make the driver wait for the disk.
+	mQueue.setPolicy(kFrameRingDropNewest);
+}
+
+SensorFrameRecorder::~SensorFrameRecorder()
+{
+	stop();
+}
+
+bool SensorFrameRecorder::start(const std::string& path, const SensorRecordingHeader& header)
+{
+	stop();
+
+	mpFile = fopen(path.c_str(), "wb");
+	if(!mpFile)
+	{
+		MLConsole() << "SensorFrameRecorder: could not create " << path << "\n";
+		return false;
+	}
+
+	if(fwrite(&header, sizeof(header), 1, mpFile) != 1)
+	{
+		MLConsole() << "SensorFrameRecorder: could not write header to " << path << "\n";
+		fclose(mpFile);
+		mpFile = nullptr;
+		return false;
+	}
+
+	mQueue.resetStats();
+	mFramesWritten = 0;
+	mStopWriting = false;
+	mStartTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	mRecording = true;
+	mWriteThread = std::thread(&SensorFrameRecorder::writeThread, this);
+	return true;
+}
+
+// after mRecording is cleared, wait for any addFrame() that saw it set to finish pushing.
+// Only then is the writer told to stop, so it drains every frame before it exits.
+void SensorFrameRecorder::stop()
+{
+	if(!mRecording) return;
+
+	mRecording = false;
+	while(mAddsInProgress > 0)
+	{
+		std::this_thread::yield();
+	}
+	mStopWriting = true;
+
+	if(mWriteThread.joinable())
+	{
+		mWriteThread.join();
+	}
+
+	fclose(mpFile);
+	mpFile = nullptr;
+
+	MLConsole() << "SensorFrameRecorder: wrote " << (int)mFramesWritten << " frames, dropped " << (int)getFramesDropped() << "\n";
+}
+
+void SensorFrameRecorder::addFrame(const SensorFrameHandle& frame)
+{
+	mAddsInProgress++;
+	if(mRecording)
+	{
+		SensorFrameHandle h(frame);
+		mQueue.push(h.detach());
+	}
+	mAddsInProgress--;
+}
+
+void SensorFrameRecorder::writeThread()
+{
+	SensorRecordingFrame record;
+	SensorFrameBuffer* pBuffer;
+	bool writeError = false;
+
+	while(true)
+	{
+		bool stopping = mStopWriting;
+		while(mQueue.pop(pBuffer))
+		{
+			SensorFrameHandle frame = SensorFrameHandle::adopt(pBuffer);
+			if(writeError) continue;
+
+			record.time = frame.getTimestamp() - mStartTime;
+			std::memcpy(record.data, frame.getFrame().data(), sizeof(record.data));
+			if(fwrite(&record, sizeof(record), 1, mpFile) != 1)
+			{
+				MLConsole() << "SensorFrameRecorder: write failed, recording stopped.\n";
+				writeError = true;
+				continue;
+			}
+			mFramesWritten++;
+		}
+
+		if(stopping) break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(kSensorRecorderWriteIntervalMillis));
+	}
+}
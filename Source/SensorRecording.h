@@ -0,0 +1,99 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <string>
+#include <cstdio>
+#include <stdint.h>
+
+#include "SensorFrame.h"
+#include "SoundplaneDriver.h"
+#include "SensorFramePool.h"
+
+// Raw sensor recordings: a fixed size header followed by one record per frame, each
+// the frame's time since the start of the recording and its data exactly as delivered
+// by the driver. All values are in the byte order of the recording machine, which in
+// practice is always little-endian. Records are a multiple of 8 bytes, so a recording
+// can be memory mapped and read in place.
+
+const char kSensorRecordingMagic[8] = {'S', 'P', 'F', 'R', 'A', 'M', 'E', 'S'};
+const uint32_t kSensorRecordingVersion = 1;
+const int kSensorRecordingMaxCarriers = 64;
+const int kSensorRecordingSerialSize = 32;
+
+struct SensorRecordingHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	uint32_t frameRecordSize;
+	uint32_t width;
+	uint32_t height;
+	uint32_t numCarriers;
+	uint8_t carriers[kSensorRecordingMaxCarriers];
+	char serialNumber[kSensorRecordingSerialSize];
+	uint32_t firmwareVersion;
+	uint32_t hasCalibration;
+
+	// system time at the start of the recording in nanoseconds since the epoch, for reference.
+	int64_t startTime;
+
+	// calibration in effect when the recording started, if hasCalibration is nonzero.
+	float calibrationMean[SensorGeometry::elements];
+};
+
+struct SensorRecordingFrame
+{
+	// time since the start of the recording in nanoseconds.
+	int64_t time;
+	float data[SensorGeometry::elements];
+};
+
+static_assert(sizeof(SensorRecordingHeader) % 8 == 0, "recording header must keep frames aligned");
+static_assert(sizeof(SensorRecordingFrame) == 8 + sizeof(SensorFrame), "unexpected frame record padding");
+
+// fill in the parts of a header that don't depend on the instrument.
+void initSensorRecordingHeader(SensorRecordingHeader& h);
+
+// returns nullptr if the header is valid for this build, otherwise a description of the problem.
+const char* validateSensorRecordingHeader(const SensorRecordingHeader& h, size_t fileSize);
+
+// SensorFrameRecorder: appends frames to a recording file. addFrame() is safe to call from
+// the driver callback: it only shares the pooled frame with a writer thread through a
+// lock-free ring, so recording never adds disk latency to the frame path. If the writer
+// falls behind, frames are dropped and counted.
+
+const int kSensorRecorderQueueSize = 64;
+
+class SensorFrameRecorder
+{
+public:
+	SensorFrameRecorder();
+	~SensorFrameRecorder();
+
+	// write the header and start recording. returns false if the file could not be created.
+	bool start(const std::string& path, const SensorRecordingHeader& header);
+	void stop();
+	bool isRecording() const { return mRecording.load(std::memory_order_acquire); }
+
+	void addFrame(const SensorFrameHandle& frame);
+
+	uint64_t getFramesWritten() const { return mFramesWritten; }
+	uint64_t getFramesDropped() const { return mQueue.getStats().dropped; }
+
+private:
+	void writeThread();
+
+	SensorFrameBufferRing mQueue{kSensorRecorderQueueSize};
+	std::atomic<bool> mRecording{false};
+	std::atomic<int> mAddsInProgress{0};
+	std::atomic<bool> mStopWriting{false};
+	std::atomic<uint64_t> mFramesWritten{0};
+	int64_t mStartTime{0};
+	FILE* mpFile{nullptr};
+	std::thread mWriteThread;
+};
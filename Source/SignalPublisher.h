@@ -0,0 +1,157 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+#include "TripleBuffer.h"
+
+// SignalPublisher: passes each new value of a signal from the process thread to any number
+// of readers, such as the views, without locks or waiting on either side. Each reader
+// subscribes and gets its own TripleBuffer, so publishing is a copy and an exchange for
+// each subscriber, and reading is an exchange when there is a new value.
+//
+// Values are numbered from 1 as they are published. A reader can compare the number of the
+// value it holds with the last one it used, and skip converting or drawing it again.
+//
+// Readers subscribe and unsubscribe from their own threads at any time. A free slot is
+// claimed with a compare and swap, and the writer skips slots not in use. The publisher
+// must outlive its subscriptions, and anything its values refer to must outlive both.
+//
+// A subscription is active while its reader keeps calling update(). The writer asks
+// hasActiveSubscribers() before making a value, so that a signal no one is reading, because
+// no view shows it or the views have stopped drawing, costs nothing to publish.
+
+template< class T, int kMaxSubscribers = 8 >
+class SignalPublisher
+{
+	struct Item
+	{
+		T value{};
+		uint64_t sequence{0};
+	};
+
+	struct Slot
+	{
+		std::atomic<bool> inUse{false};
+		std::atomic<int64_t> lastUpdateTime{0};
+		TripleBuffer< Item > buffer;
+	};
+
+	// a subscription that has not called update() for this long is idle.
+	static constexpr int64_t kIdleNanos = 250*1000*1000;
+
+	static int64_t nowNanos()
+	{
+		return std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+public:
+	// one reader's connection to the publisher. Only one thread at a time may use it.
+	class Subscription
+	{
+	public:
+		Subscription(SignalPublisher& publisher)
+		{
+			for(Slot& slot : publisher.mSlots)
+			{
+				bool expected = false;
+				if(slot.inUse.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+				{
+					mpSlot = &slot;
+					mpSlot->lastUpdateTime.store(nowNanos(), std::memory_order_relaxed);
+					break;
+				}
+			}
+
+			// the slot may hold values published to an earlier subscriber. Ignore them.
+			mLastSequence = publisher.getSequence();
+		}
+
+		~Subscription()
+		{
+			if(!mpSlot) return;
+			mpSlot->inUse.store(false, std::memory_order_release);
+		}
+
+		Subscription(const Subscription&) = delete;
+		Subscription& operator=(const Subscription&) = delete;
+
+		// false if all kMaxSubscribers slots were taken. Such a subscription never has a value.
+		bool isConnected() const { return mpSlot != nullptr; }
+
+		// take the newest value, if one has been published since the last update(), and keep
+		// the subscription active. Returns true if the value returned by get() changed.
+		bool update()
+		{
+			if(!mpSlot) return false;
+			mpSlot->lastUpdateTime.store(nowNanos(), std::memory_order_relaxed);
+			if(!mpSlot->buffer.update()) return false;
+			uint64_t sequence = mpSlot->buffer.getReadBuffer().sequence;
+			if(sequence <= mLastSequence) return false;
+			mLastSequence = sequence;
+			mHasValue = true;
+			return true;
+		}
+
+		// the value taken by the last update(), or T() before there is one.
+		const T& get() const { return mHasValue ? mpSlot->buffer.getReadBuffer().value : mEmpty; }
+
+		// the number of the value returned by get(), or 0 before there is one.
+		uint64_t getSequence() const { return mHasValue ? mLastSequence : 0; }
+
+	private:
+		Slot* mpSlot{nullptr};
+		uint64_t mLastSequence{0};
+		bool mHasValue{false};
+		T mEmpty{};
+	};
+
+	SignalPublisher() {}
+	~SignalPublisher() {}
+
+	SignalPublisher(const SignalPublisher&) = delete;
+	SignalPublisher& operator=(const SignalPublisher&) = delete;
+
+	// writer: publish a value to each subscriber. Only one thread may publish.
+	void publish(const T& value)
+	{
+		uint64_t sequence = mSequence.load(std::memory_order_relaxed) + 1;
+		mSequence.store(sequence, std::memory_order_release);
+		for(Slot& slot : mSlots)
+		{
+			if(!slot.inUse.load(std::memory_order_acquire)) continue;
+			Item& item = slot.buffer.getWriteBuffer();
+			item.value = value;
+			item.sequence = sequence;
+			slot.buffer.publish();
+		}
+	}
+
+	// true if any subscription has called update() recently, so that the writer can skip
+	// making values no one reads. A reader that becomes active again may miss a value.
+	bool hasActiveSubscribers() const
+	{
+		const int64_t now = nowNanos();
+		for(const Slot& slot : mSlots)
+		{
+			if(slot.inUse.load(std::memory_order_relaxed) &&
+				(now - slot.lastUpdateTime.load(std::memory_order_relaxed) < kIdleNanos))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// the number of the last value published, or 0 if there is none.
+	uint64_t getSequence() const { return mSequence.load(std::memory_order_acquire); }
+
+private:
+	Slot mSlots[kMaxSubscribers];
+	std::atomic<uint64_t> mSequence{0};
+};
@@ -11,9 +11,10 @@ SoundplaneApp::SoundplaneApp()
 
 SoundplaneApp::~SoundplaneApp()
 {
+	// the views read signals published by the Model, so they go first.
+	delete mpView;
 	delete mpController;
 	delete mpModel;
-	delete mpView;
 	delete mpBorder;
 	delete mpWindow;
 }
@@ -57,6 +57,24 @@ void SoundplaneController::handleWidgetAction(MLWidget* w, ml::Symbol action, ml
 		{
 			mpSoundplaneModel->beginCalibrate();
 		}
+		else if (p == "print_latency")
+		{
+			mpSoundplaneModel->printLatencyStats();
+		}
+		else if (p == "record")
+		{
+			if(mpSoundplaneModel->isRecording())
+			{
+				mpSoundplaneModel->stopRecording();
+			}
+			else
+			{
+				File dir = File::getSpecialLocation(File::userDocumentsDirectory).getChildFile("Soundplane Recordings");
+				dir.createDirectory();
+				String name = "Soundplane " + Time::getCurrentTime().formatted("%Y-%m-%d %H%M%S") + ".spframes";
+				mpSoundplaneModel->startRecording(dir.getChildFile(name).getFullPathName().toStdString());
+			}
+		}
 
 		else if(p == "prev")
 		{
@@ -14,7 +14,10 @@ mResized(false),
 mSensorHeight(8),
 mSensorWidth(64),
 mCount(0),
-mMaxRawTouches(0)
+mMaxRawTouches(0),
+mRawSignal(SensorGeometry::width, SensorGeometry::height),
+mCalibratedSignal(SensorGeometry::width, SensorGeometry::height),
+mSmoothedSignal(SensorGeometry::width, SensorGeometry::height)
 
 {
 	setInterceptsMouseClicks (false, false);
@@ -196,13 +199,44 @@ void SoundplaneGridView::drawSurfaceOverlay()
 
 void SoundplaneGridView::setModel(SoundplaneModel* m)
 {
+	mpRawSubscription.reset(new SensorFramePublisher::Subscription(m->getRawSignal()));
+	mpCalibratedSubscription.reset(new SensorFramePublisher::Subscription(m->getCalibratedSignal()));
+	mpSmoothedSubscription.reset(new SensorFramePublisher::Subscription(m->getSmoothedSignal()));
+	mpTouchSubscription.reset(new TouchArrayPublisher::Subscription(m->getTouchSignal()));
 	mpModel = m;
 }
 
+// take the newest frames shown in the view mode from the Model, converting only those
+// that changed.
+void SoundplaneGridView::updateSignals(const ml::Text& viewMode)
+{
+	auto update = [](SensorFramePublisher::Subscription& s, ml::Matrix& signal)
+	{
+		if(s.update() && s.get())
+		{
+			signal = sensorFrameToSignal(*s.get());
+		}
+	};
+	
+	if(viewMode == "xy")
+	{
+		update(*mpSmoothedSubscription, mSmoothedSignal);
+	}
+	else if(viewMode == "raw data")
+	{
+		update(*mpRawSubscription, mRawSignal);
+	}
+	else if(viewMode != "touches")
+	{
+		update(*mpCalibratedSubscription, mCalibratedSignal);
+	}
+	mpTouchSubscription->update();
+}
+
 void SoundplaneGridView::renderXYGrid()
 {
 	float viewScale = mpModel->getFloatProperty("display_scale");
-	ml::Matrix calSignal = mpModel->getSmoothedSignal();
+	ml::Matrix calSignal = mSmoothedSignal;
 	
 	if((calSignal.getHeight() != mSensorHeight) || (calSignal.getWidth() != mSensorWidth)) return;
 	calSignal.scale(0.25f);
@@ -257,19 +291,19 @@ void SoundplaneGridView::renderXYGrid()
 	// render current touch dots
 	//
 	const int nt = mpModel->getFloatProperty("max_touches");
-	const ml::Matrix& touches = mpModel->getTouchFrame();
+	const TouchArray& touches = mpTouchSubscription->get();
 	for(int t=0; t<nt; ++t)
 	{
-		int age = touches(ageColumn, t);
+		int age = touches[t].age;
 		if (age > 0)
 		{
-			float x = touches(xColumn, t);
-			float y = touches(yColumn, t);
+			float x = touches[t].x;
+			float y = touches[t].y;
 			
 			Vec2 gridPos(x, y);
 			float tx = mKeyRangeX.convert(gridPos.x());
 			float ty = mKeyRangeY.convert(gridPos.y());
-			float tz = touches(zColumn, t);
+			float tz = touches[t].z;
 			
 			Vec4 dataColor(MLGL::getIndicatorColor(t));
 			dataColor[3] = 0.75;
@@ -280,14 +314,14 @@ void SoundplaneGridView::renderXYGrid()
 	}
 	
 	// render touch position history xy lines
-	const ml::Matrix& touchHistory = mpModel->getTouchHistory();
+	const TouchHistory& touchHistory = mpModel->getTouchHistory();
 	
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glEnable(GL_BLEND);
 	glEnable(GL_LINE_SMOOTH);
 	glLineWidth(1.0*mViewScale);
 	
-	int ctr = mpModel->getHistoryCtr();
+	const uint64_t newestFrame = touchHistory.getSequence();
 	for(int touch=0; touch<nt; ++touch)
 	{
 		//		int currentAge = touches(ageColumn, touch);
@@ -300,15 +334,15 @@ void SoundplaneGridView::renderXYGrid()
 			
 			//	int a = 0;
 			const int kDrawHistorySize = 500;
-			int cc = ctr;
 			
 			//			int totalAge = 0;
 			
 			for(int t=0; t < kDrawHistorySize; ++t)
 			{
-				float x = touchHistory(xColumn, touch, cc);
-				float y = touchHistory(yColumn, touch, cc);
-				int age = touchHistory(ageColumn, touch, cc);
+				TouchHistoryPoint point = touchHistory.getPoint(newestFrame, t, touch);
+				float x = point.x;
+				float y = point.y;
+				int age = point.age;
 				
 				if((age > 0))
 				{
@@ -318,8 +352,6 @@ void SoundplaneGridView::renderXYGrid()
 					glVertex2f(px, py);
 				}
 				
-				if(--cc < 0) { cc = kSoundplaneHistorySize - 1; }
-				
 				//				debug() << age << " ";
 				//				if(age < 0) break;
 				//				if(++a >= age - 2) break;
@@ -411,11 +443,11 @@ void SoundplaneGridView::renderZGrid()
 	ml::Matrix viewSignal;
 	if(viewMode == "raw data")
 	{
-		viewSignal = mpModel->getRawSignal();
+		viewSignal = mRawSignal;
 	}
 	else
 	{
-		viewSignal = mpModel->getCalibratedSignal();
+		viewSignal = mCalibratedSignal;
 		viewSignal.scale(0.05f);
 	}
 	
@@ -589,6 +621,7 @@ void SoundplaneGridView::renderOpenGL()
 	const Colour c = findColour(MLLookAndFeel::backgroundColor);
 	OpenGLHelpers::clear (c);
 	const ml::Text viewMode = getTextProperty("viewmode");
+	updateSignals(viewMode);
 	
 	if (viewMode == "xy")
 	{
@@ -597,7 +630,7 @@ void SoundplaneGridView::renderOpenGL()
 	}
 	else if (viewMode == "touches")
 	{
-		renderTouches(mpModel->getTouchArray());
+		renderTouches(mpTouchSubscription->get());
 		drawSurfaceOverlay();
 	}
 	else // raw, calibrated or smoothed
@@ -46,6 +46,8 @@ private:
 	
 	void renderZGrid();
 	
+	void updateSignals(const ml::Text& viewMode);
+	
 	Vec2 worldToScreen(const Vec3& world);
 	
 	void drawInfoBox(Vec3 pos, char* text, int colorIndex);
@@ -66,6 +68,17 @@ private:
 	
 	int mCount; // TEMP
 	int mMaxRawTouches;
+	
+	// the Model's signals, read on the render thread. Only the signals shown in the current
+	// view mode are updated, so the Model stops making the others. Each frame signal is
+	// converted to a matrix only when a new frame has been published.
+	std::unique_ptr< SensorFramePublisher::Subscription > mpRawSubscription;
+	std::unique_ptr< SensorFramePublisher::Subscription > mpCalibratedSubscription;
+	std::unique_ptr< SensorFramePublisher::Subscription > mpSmoothedSubscription;
+	std::unique_ptr< TouchArrayPublisher::Subscription > mpTouchSubscription;
+	ml::Matrix mRawSignal;
+	ml::Matrix mCalibratedSignal;
+	ml::Matrix mSmoothedSignal;
 
   ml::Timer mTimer;
 	
@@ -0,0 +1,303 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "SoundplaneInstrument.h"
+#include "SoundplaneModelA.h"
+#include "ThreadUtility.h"
+#include "MLDebug.h"
+
+#include <algorithm>
+
+// each instrument has its own buffers, so that instruments never contend for them.
+const int kInstrumentFramePoolSize = 32;
+const int kInstrumentQueueSize = 16;
+
+// longest time the process thread will sleep when no frames are arriving.
+const int kInstrumentIdleTimeoutMillis = 100;
+const int kInstrumentInputRoomWaitMicros = 100;
+
+static int64_t steadyClockNanos()
+{
+	return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+SoundplaneInstrument::SoundplaneInstrument(int index) :
+mIndex(index),
+mDeviceID(index),
+mFramePool(kInstrumentFramePoolSize),
+mSensorFrameQueue(kInstrumentQueueSize)
+{
+	mOSCOutput.setSerialNumber(mDeviceID);
+}
+
+SoundplaneInstrument::~SoundplaneInstrument()
+{
+	stop();
+}
+
+bool SoundplaneInstrument::openReplay(const std::string& path, bool realTime)
+{
+	mpReplayDriver = new SoundplaneReplayDriver(*this, path, realTime);
+	mpDriver = std::unique_ptr< SoundplaneDriver >(mpReplayDriver);
+
+	// a fast replay waits for the process thread instead of dropping frames.
+	mWaitForInputRoom = !realTime;
+	return mpReplayDriver->isOpen();
+}
+
+void SoundplaneInstrument::start()
+{
+	if(mProcessThread.joinable()) return;
+	mTerminating = false;
+	mProcessThread = std::thread(&SoundplaneInstrument::processThread, this);
+	SetPriorityRealtimeAudio(mProcessThread.native_handle());
+
+	if(mpDriver)
+	{
+		mpDriver->start();
+	}
+}
+
+void SoundplaneInstrument::stop()
+{
+	// the driver goes first, so that it doesn't call back into a stopped instrument.
+	mpDriver = nullptr;
+	mpReplayDriver = nullptr;
+
+	mTerminating = true;
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mWakeCondition.notify_one();
+	}
+	if(mProcessThread.joinable())
+	{
+		mProcessThread.join();
+	}
+}
+
+void SoundplaneInstrument::setCalibration(const SensorFrame& mean)
+{
+	mTracker.setCalibration(mean);
+	mHasCalibration = true;
+}
+
+// the snapshot goes out with this instrument's own zones.
+void SoundplaneInstrument::publishParams(const RealtimeParams& p)
+{
+	RealtimeParams& q = mParamsBuffer.getWriteBuffer();
+	q = p;
+	q.zones = mPublishedZones.getForPublishing();
+	mParamsBuffer.publish();
+	mPublishedZones.freeRetired();
+}
+
+void SoundplaneInstrument::requestInfrequentTasks()
+{
+	mInfrequentTasksPending = true;
+	wakeProcessThread();
+}
+
+// --------------------------------------------------------------------------------
+#pragma mark SoundplaneDriverListener
+
+// called on the driver's thread, before its first frame. The OSC output and tracker belong
+// to the process thread, so what is found here is handed over for updateStartup() to apply.
+void SoundplaneInstrument::onStartup()
+{
+	const unsigned long instrumentModel = 1; // Soundplane A
+	int serial = mpDriver ? mpDriver->getSerialNumber() : 0;
+
+	DeviceStartup& startup = mStartupBuffer.getWriteBuffer();
+	startup.deviceID = serial ? (int)((instrumentModel << 16) | serial) : mIndex;
+	startup.hasCalibration = mpReplayDriver && mpReplayDriver->hasCalibration();
+	if(startup.hasCalibration)
+	{
+		startup.calibrationMean = clamp(mpReplayDriver->getCalibrationMean(), 0.0001f, 1.f);
+	}
+	mStartupBuffer.publish();
+}
+
+// as in the Model: copy the frame into a buffer from the pool, queue it and wake the process thread.
+void SoundplaneInstrument::onFrame(const SensorFrame& frame)
+{
+	// the process thread keeps running until the driver is gone, so these waits end.
+	if(mWaitForInputRoom)
+	{
+		while(mSensorFrameQueue.elementsAvailable() >= mSensorFrameQueue.getCapacity())
+		{
+			std::this_thread::sleep_for(microseconds(kInstrumentInputRoomWaitMicros));
+		}
+	}
+	SensorFrameHandle buffer = mFramePool.acquire();
+	while(!buffer && mWaitForInputRoom)
+	{
+		std::this_thread::sleep_for(microseconds(kInstrumentInputRoomWaitMicros));
+		buffer = mFramePool.acquire();
+	}
+	if(!buffer) return;
+
+	buffer.getFrameForWriting() = frame;
+	buffer.setTimestamp(steadyClockNanos());
+	mSensorFrameQueue.push(buffer.detach());
+	wakeProcessThread();
+}
+
+void SoundplaneInstrument::onError(int error, const char* errStr)
+{
+	MLConsole() << "instrument " << mIndex << ": error " << error << ": " << errStr << "\n";
+}
+
+void SoundplaneInstrument::onClose()
+{
+}
+
+// --------------------------------------------------------------------------------
+#pragma mark process thread
+
+bool SoundplaneInstrument::processThreadHasWork()
+{
+	return mTerminating || mInfrequentTasksPending || (mSensorFrameQueue.elementsAvailable() > 0);
+}
+
+// the same handshake as SoundplaneModel::waitForProcessThreadWork().
+void SoundplaneInstrument::waitForWork()
+{
+	if(processThreadHasWork()) return;
+
+	std::unique_lock<std::mutex> lock(mWakeMutex);
+	mWaiting = true;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	mWakeCondition.wait_for(lock, milliseconds(kInstrumentIdleTimeoutMillis), [&](){ return processThreadHasWork(); });
+	mWaiting = false;
+}
+
+void SoundplaneInstrument::wakeProcessThread()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(mWaiting)
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mWakeCondition.notify_one();
+	}
+}
+
+void SoundplaneInstrument::processThread()
+{
+	mPrevSendTime = system_clock::now();
+
+	while(!mTerminating)
+	{
+		waitForWork();
+		if(mTerminating) break;
+
+		if(mInfrequentTasksPending.exchange(false))
+		{
+			mOSCOutput.doInfrequentTasks();
+			mMIDIOutput.doInfrequentTasks();
+		}
+
+		updateStartup();
+
+		SensorFrameBuffer* pBuffer;
+		while(mSensorFrameQueue.pop(pBuffer))
+		{
+			updateParams();
+			process(SensorFrameHandle::adopt(pBuffer));
+		}
+	}
+}
+
+// take the newest parameters, if any have been published, and apply those that changed.
+void SoundplaneInstrument::updateParams()
+{
+	if(!mParamsBuffer.update()) return;
+	const RealtimeParams& p = mParamsBuffer.getReadBuffer();
+	const RealtimeParams* prev = mParamsApplied ? &mParams : nullptr;
+	applyTrackerParams(mTracker, p, prev);
+	const bool newZones = zonesChanged(p, prev);
+	if(newZones)
+	{
+		mpZones = p.zones;
+	}
+	if(newZones || zoneParamsChanged(p, prev))
+	{
+		applyZoneParams(*mpZones, p);
+	}
+
+	// without MPE, each instrument sends on the channel after the one before it.
+	applyOutputParams(mMIDIOutput, mOSCOutput, p, prev, mIndex);
+	mParams = p;
+	mParamsApplied = true;
+	mPublishedZones.setAppliedVersion(p.version);
+}
+
+// apply the device found by onStartup(), if it has started since the last call.
+void SoundplaneInstrument::updateStartup()
+{
+	if(!mStartupBuffer.update()) return;
+	const DeviceStartup& startup = mStartupBuffer.getReadBuffer();
+	mDeviceID = startup.deviceID;
+	mOSCOutput.setSerialNumber(startup.deviceID);
+	if(startup.hasCalibration)
+	{
+		setCalibration(startup.calibrationMean);
+	}
+}
+
+void SoundplaneInstrument::process(const SensorFrameHandle& frame)
+{
+	if(!mHasCalibration)
+	{
+		mStats.accumulate(*frame);
+		if(mStats.getCount() >= kSoundplaneCalibrateSize)
+		{
+			setCalibration(clamp(mStats.mean(), 0.0001f, 1.f));
+			mStats.clear();
+		}
+		return;
+	}
+
+	// instruments have no views or matrix output, so the calibrated frame is not kept.
+	const SensorFrame& curvature = mTracker.preprocessRaw(*frame);
+	TouchArray touches = scaleTouchPressure(mTracker.process(curvature, mParams.maxTouches), mParams.zScale, mParams.zCurve);
+	mpZones->processTouches(touches, mParams.hysteresis);
+
+	// send at the data rate, or at once if a touch starts or ends, as the Model does.
+	bool notesChanged = false;
+	for(int i = 0; i < kMaxTouches; ++i)
+	{
+		if(touches[i].state != mPreviousTouches[i].state)
+		{
+			notesChanged = true;
+			break;
+		}
+	}
+	mPreviousTouches = touches;
+
+	auto now = system_clock::now();
+	const int dataPeriodMicros = 1000*1000 / std::max(mParams.dataRate, 1);
+	if(notesChanged || (duration_cast<microseconds>(now - mPrevSendTime).count() >= dataPeriodMicros))
+	{
+		mPrevSendTime = now;
+		sendFrameToOutputs(now);
+		mLatency.record(steadyClockNanos() - frame.getTimestamp());
+	}
+	mFramesProcessed++;
+}
+
+void SoundplaneInstrument::sendFrameToOutputs(time_point<system_clock> now)
+{
+	if(mMIDIOutput.isActive())
+	{
+		mMIDIOutput.beginOutputFrame(now);
+		mpZones->sendToOutput(mMIDIOutput);
+		mMIDIOutput.endOutputFrame();
+	}
+	if(mOSCOutput.isActive())
+	{
+		mOSCOutput.beginOutputFrame(now);
+		mpZones->sendToOutput(mOSCOutput);
+		mOSCOutput.endOutputFrame();
+	}
+}
@@ -0,0 +1,144 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <string>
+#include <stdint.h>
+
+#include "SoundplaneDriver.h"
+#include "SoundplaneReplayDriver.h"
+#include "SensorFramePool.h"
+#include "LatencyHistogram.h"
+#include "TouchTracker.h"
+#include "RealtimeParams.h"
+#include "ZoneSet.h"
+#include "PublishedZones.h"
+#include "SoundplaneMIDIOutput.h"
+#include "SoundplaneOSCOutput.h"
+
+// SoundplaneInstrument: the tracking pipeline of one device, from its driver to its outputs,
+// on its own realtime thread. The Model runs the first device itself, and each further
+// device as an instrument, so that N devices are tracked on N threads with nothing shared
+// between them but the MIDI port.
+//
+// Each instrument has its own OSC output, which tags its frames with the instrument's
+// device ID in /t3d/frm, and its own MIDI output, which sends on its own range of MPE
+// channels through the Model's MIDI device. See SoundplaneMIDIOutput::setMPEZone().
+//
+// Frames can come from a driver opened by the instrument or be passed to onFrame() by the
+// caller, as soundplane-headless does. Calibration comes from a replayed recording, from
+// setCalibration(), or else is collected from the first frames once the device starts.
+
+class SoundplaneInstrument : public SoundplaneDriverListener
+{
+public:
+	// index is the instrument's position among all of them, the Model's device being 0.
+	SoundplaneInstrument(int index);
+	~SoundplaneInstrument();
+
+	// SoundplaneDriverListener
+	void onStartup() override;
+	void onFrame(const SensorFrame& frame) override;
+	void onError(int error, const char* errStr) override;
+	void onClose() override;
+
+	// replay a recording as this instrument's device. Must be called before start().
+	bool openReplay(const std::string& path, bool realTime);
+
+	// start the process thread, then the driver if there is one.
+	void start();
+
+	// stop the driver and the process thread. Called by the destructor.
+	void stop();
+
+	int getIndex() const { return mIndex; }
+
+	// the ID sent in /t3d/frm: the serial number of the device, or the index if it has none.
+	int getDeviceID() const { return mDeviceID; }
+
+	// set the calibration before start(). Once running, a replay's calibration is applied
+	// by the process thread when the driver starts up.
+	void setCalibration(const SensorFrame& mean);
+	bool hasCalibration() const { return mHasCalibration; }
+
+	// pass new parameters to the process thread, which applies them before its next frame.
+	// Only one thread at a time may publish.
+	void publishParams(const RealtimeParams& p);
+
+	// the zones published with the parameters. Load a zone map here before publishing.
+	PublishedZones& getPublishedZones() { return mPublishedZones; }
+
+	// the outputs, to be set up before start(). Once running, the zone and output settings
+	// are passed with the parameters and applied by the process thread.
+	SoundplaneMIDIOutput& getMIDIOutput() { return mMIDIOutput; }
+	SoundplaneOSCOutput& getOSCOutput() { return mOSCOutput; }
+
+	// ask the process thread to run the outputs' infrequent tasks.
+	void requestInfrequentTasks();
+
+	// frames waiting in the input queue, for callers of onFrame() that don't want any dropped.
+	size_t getFramesWaiting() const { return mSensorFrameQueue.elementsAvailable(); }
+	size_t getInputCapacity() const { return mSensorFrameQueue.getCapacity(); }
+
+	// frames tracked so far, and the time from onFrame() to the last send for each.
+	uint64_t getFramesProcessed() const { return mFramesProcessed; }
+	const LatencyHistogram& getLatencyHistogram() const { return mLatency; }
+
+private:
+	void processThread();
+	bool processThreadHasWork();
+	void waitForWork();
+	void wakeProcessThread();
+	void updateParams();
+	void updateStartup();
+	void process(const SensorFrameHandle& frame);
+	void sendFrameToOutputs(time_point<system_clock> now);
+
+	const int mIndex;
+	std::atomic<int> mDeviceID;
+
+	std::unique_ptr< SoundplaneDriver > mpDriver;
+	SoundplaneReplayDriver* mpReplayDriver{nullptr};
+	bool mWaitForInputRoom{false};
+
+	SensorFramePool mFramePool;
+	SensorFrameBufferRing mSensorFrameQueue;
+
+	TouchTracker mTracker;
+	ZoneSet mNoZones;
+	ZoneSet* mpZones{&mNoZones};
+	PublishedZones mPublishedZones;
+	SoundplaneMIDIOutput mMIDIOutput;
+	SoundplaneOSCOutput mOSCOutput;
+
+	std::atomic<bool> mHasCalibration{false};
+	SensorFrameStats mStats;
+
+	// the parameters in use, read only by the process thread.
+	RealtimeParamsBuffer mParamsBuffer;
+	RealtimeParams mParams;
+	bool mParamsApplied{false};
+
+	// the device as found by onStartup(), applied by the process thread.
+	DeviceStartupBuffer mStartupBuffer;
+
+	TouchArray mPreviousTouches{};
+	time_point<system_clock> mPrevSendTime{};
+
+	std::atomic<uint64_t> mFramesProcessed{0};
+	LatencyHistogram mLatency;
+
+	std::atomic<bool> mTerminating{false};
+	std::atomic<bool> mInfrequentTasksPending{false};
+	std::thread mProcessThread;
+	std::mutex mWakeMutex;
+	std::condition_variable mWakeCondition;
+	std::atomic<bool> mWaiting{false};
+};
@@ -6,6 +6,8 @@
 #include "SoundplaneMIDIOutput.h"
 #include "MLDebug.h"
 
+#include <algorithm>
+
 const std::string kSoundplaneMIDIDeviceName("Soundplane IAC out");
 
 const int kMPE_MIDI_CC = 127;
@@ -152,15 +154,11 @@ void SoundplaneMIDIOutput::findMIDIDevices ()
 
 void SoundplaneMIDIOutput::setDevice(int deviceIdx)
 {
-	if(mpCurrentDevice)
-	{
-		delete mpCurrentDevice;
-		mpCurrentDevice = 0;
-	}
+	replaceDevice(nullptr);
 	
 	if(deviceIdx < mDevices.size())
 	{
-		mpCurrentDevice = mDevices[deviceIdx]->getDevice();
+		replaceDevice(mDevices[deviceIdx]->getDevice());
 		sendMPEChannels();
 		sendPitchbendRange();
 	}
@@ -168,23 +166,44 @@ void SoundplaneMIDIOutput::setDevice(int deviceIdx)
 
 void SoundplaneMIDIOutput::setDevice(const std::string& deviceStr)
 {
-	if(mpCurrentDevice)
-	{
-		delete mpCurrentDevice;
-		mpCurrentDevice = 0;
-	}
+	replaceDevice(nullptr);
 	
 	for(int i=0; i<mDevices.size(); ++i)
 	{
 		if (mDevices[i]->getName() == deviceStr)
 		{
-			mpCurrentDevice = mDevices[i]->getDevice();
+			replaceDevice(mDevices[i]->getDevice());
 			sendMPEChannels();
 			sendPitchbendRange();
 		}
 	}
 }
 
+// the device is swapped under the lock, so that outputs sending through this one
+// never send to a closed device.
+void SoundplaneMIDIOutput::replaceDevice(juce::MidiOutput* pDevice)
+{
+	juce::MidiOutput* pOldDevice;
+	{
+		std::lock_guard<std::mutex> lock(mDeviceMutex);
+		pOldDevice = mpCurrentDevice;
+		mpCurrentDevice = pDevice;
+	}
+	delete pOldDevice;
+}
+
+void SoundplaneMIDIOutput::sendThrough(SoundplaneMIDIOutput* pOutput)
+{
+	mpSendThrough = pOutput;
+}
+
+bool SoundplaneMIDIOutput::hasDevice()
+{
+	if(mpSendThrough) return mpSendThrough->hasDevice();
+	std::lock_guard<std::mutex> lock(mDeviceMutex);
+	return mpCurrentDevice != nullptr;
+}
+
 int SoundplaneMIDIOutput::getNumDevices()
 {
 	return mDevices.size();
@@ -205,42 +224,88 @@ void SoundplaneMIDIOutput::setActive(bool v)
 	mActive = v;
 }
 
+// all messages are sent from here. With no device open they are made and then dropped,
+// so the output can be run without any MIDI hardware.
+void SoundplaneMIDIOutput::sendMessage(const juce::MidiMessage& m)
+{
+	mMessagesSent++;
+	if(mpSendThrough)
+	{
+		mpSendThrough->sendToDevice(m);
+	}
+	else
+	{
+		sendToDevice(m);
+	}
+}
+
+// outputs sharing the device send from their own threads, so each message is sent under the lock.
+void SoundplaneMIDIOutput::sendToDevice(const juce::MidiMessage& m)
+{
+	std::lock_guard<std::mutex> lock(mDeviceMutex);
+	if(mpCurrentDevice)
+	{
+		mpCurrentDevice->sendMessageNow(m);
+	}
+}
+
 void SoundplaneMIDIOutput::sendMIDIChannelPressure(int chan, int p)
 {
 	if(!mMPEExtended)
 	{
 		// normal MPE: send pressure as channel pressure
-		mpCurrentDevice->sendMessageNow(juce::MidiMessage::channelPressureChange(chan, p));
+		sendMessage(juce::MidiMessage::channelPressureChange(chan, p));
 	}
 	else
 	{
 		// multi channel, extensions
-		if(mPressureActive) mpCurrentDevice->sendMessageNow(juce::MidiMessage::channelPressureChange(chan, p));
-		mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(chan, 11, p));
+		if(mPressureActive) sendMessage(juce::MidiMessage::channelPressureChange(chan, p));
+		sendMessage(juce::MidiMessage::controllerEvent(chan, 11, p));
 	}
 }
 
-void SoundplaneMIDIOutput::sendAllMIDIChannelPressures(int p)
+// the channels this output sends on: its MPE zone's main and voice channels, or its single
+// channel. Other instruments may be sending on the rest of the port's channels.
+int SoundplaneMIDIOutput::getOutputChannels(std::array< int, kMaxMIDIVoices >& channels)
 {
-	for(int c=1; c<=kMaxMIDIVoices; ++c)
+	if(!mMPEMode)
+	{
+		channels[0] = mChannel;
+		return 1;
+	}
+	int n = 0;
+	channels[n++] = mMPEMainChannel;
+	for(int v = 0; (v < mVoiceChannels) && (n < kMaxMIDIVoices); ++v)
 	{
-		sendMIDIChannelPressure(c, p);
+		channels[n++] = getMPEVoiceChannel(v);
 	}
+	return n;
 }
 
+void SoundplaneMIDIOutput::sendAllMIDIChannelPressures(int p)
+{
+	std::array< int, kMaxMIDIVoices > channels;
+	int n = getOutputChannels(channels);
+	for(int c=0; c<n; ++c)
+	{
+		sendMIDIChannelPressure(channels[c], p);
+	}
+}
 
 void SoundplaneMIDIOutput::sendAllMIDINotesOff()
 {
-	for(int c=1; c<=kMaxMIDIVoices; ++c)
+	std::array< int, kMaxMIDIVoices > channels;
+	int n = getOutputChannels(channels);
+	for(int c=0; c<n; ++c)
 	{
-		mpCurrentDevice->sendMessageNow(juce::MidiMessage::allNotesOff(c));
+		sendMessage(juce::MidiMessage::allNotesOff(channels[c]));
 	}
 }
 
 void SoundplaneMIDIOutput::setPressureActive(bool v)
 {
 	mPressureActive = v;
-	if(mpCurrentDevice)
+	if(hasDevice())
 	{
 		// when turning pressure off, first send maximum values
 		// so sounds don't get stuck off
@@ -262,19 +327,26 @@ void SoundplaneMIDIOutput::setPressureActive(bool v)
 void SoundplaneMIDIOutput::setMPEExtended(bool v)
 {
 	mMPEExtended = v;
-	if (!mpCurrentDevice) return;
+	if (!hasDevice()) return;
 	sendAllMIDIChannelPressures(0);
 }
 
 void SoundplaneMIDIOutput::setMPE(bool v)
 {
+	// notes are turned off on the channels they were sent on, before the mode changes them.
+	bool device = hasDevice();
+	if(device)
+	{
+		sendAllMIDINotesOff();
+	}
+	
 	mMPEMode = v;
 	
-	// channels is always 15 now if we are in MPE mode. If we introduce splits or more complex MPE options this may change.
-	mMPEChannels = mMPEMode ? 15 : 0;
+	// the zone has all 15 voice channels, unless it is split between instruments. See setMPEZone().
+	mMPEChannels = mMPEMode ? mZoneChannels : 0;
+	updateVoices();
 	
-	if (!mpCurrentDevice) return;
-	sendAllMIDINotesOff();
+	if (!device) return;
 	sendAllMIDIChannelPressures(0);
 	sendMPEChannels();
 	sendPitchbendRange();
@@ -283,9 +355,11 @@ void SoundplaneMIDIOutput::setMPE(bool v)
 void SoundplaneMIDIOutput::setStartChannel(int v)
 {
 	if(mChannel == v) return;
+	if(hasDevice())
+	{
+		sendAllMIDINotesOff();
+	}
 	mChannel = v;
-	if (!mpCurrentDevice) return;
-	sendAllMIDINotesOff();
 }
 
 void SoundplaneMIDIOutput::setKymaMode(bool v)
@@ -294,16 +368,65 @@ void SoundplaneMIDIOutput::setKymaMode(bool v)
 	mKymaMode = v;
 }
 
-// MPE spec defines a split mode using main channels 1 and 16. We ignore this for now and use only channel 1
-// for the main channel, and 2 upwards for the individual voices.
+// MPE spec defines a lower zone with main channel 1 and voice channels from 2 upwards, and an
+// upper zone with main channel 16 and voice channels from 15 downwards. One instrument has
+// the whole lower zone. Two have a zone each, with 7 voice channels. More than two share the
+// lower zone, each with its own range of voice channels.
+void SoundplaneMIDIOutput::setMPEZone(int instrument, int instruments)
+{
+	const int kAllVoiceChannels = 15;
+	instruments = ml::max(instruments, 1);
+	instrument = ml::clamp(instrument, 0, instruments - 1);
+	
+	mMPEMainChannel = 1;
+	mFirstVoiceChannel = 2;
+	mVoiceChannelStep = 1;
+	if(instruments == 1)
+	{
+		mVoiceChannels = kAllVoiceChannels;
+		mZoneChannels = kAllVoiceChannels;
+	}
+	else if(instruments == 2)
+	{
+		mVoiceChannels = kAllVoiceChannels/2;
+		mZoneChannels = mVoiceChannels;
+		if(instrument == 1)
+		{
+			mMPEMainChannel = 16;
+			mFirstVoiceChannel = 15;
+			mVoiceChannelStep = -1;
+		}
+	}
+	else
+	{
+		mVoiceChannels = ml::max(kAllVoiceChannels/instruments, 1);
+		mZoneChannels = kAllVoiceChannels;
+		mFirstVoiceChannel = 2 + instrument*mVoiceChannels;
+	}
+	mMPEChannels = mMPEMode ? mZoneChannels : 0;
+	updateVoices();
+}
+
+// in MPE mode each voice needs a channel of its own, so a zone split between instruments
+// has fewer voices than the touches the tracker may send. The touches past the last voice
+// are dropped in processTouch().
+void SoundplaneMIDIOutput::updateVoices()
+{
+	mVoices = ml::clamp(mMaxTouches, 0, kMaxMIDIVoices);
+	if(mMPEMode)
+	{
+		mVoices = std::min(mVoices, mVoiceChannels);
+	}
+}
+
 int SoundplaneMIDIOutput::getMPEMainChannel()
 {
-	return 1;
+	return mMPEMainChannel;
 }
 
 int SoundplaneMIDIOutput::getMPEVoiceChannel(int voice)
 {
-	return 2 + ml::clamp(voice, 0, 14);
+	return mFirstVoiceChannel + mVoiceChannelStep*ml::clamp(voice, 0, mVoiceChannels - 1);
 }
 
 int SoundplaneMIDIOutput::getVoiceChannel(int v)
@@ -380,6 +503,10 @@ void SoundplaneMIDIOutput::beginOutputFrame(time_point<system_clock> now)
 
 void SoundplaneMIDIOutput::processTouch(int i, int offset, const Touch& t)
 {
+	// each voice has its own channel, so with more touches than voices, the touches past
+	// the last voice are not sent. See updateVoices().
+	if(i >= mVoices) return;
+	
 	MIDIVoice* pVoice = &mMIDIVoices[i];
 	pVoice->x = t.x;
 	pVoice->y = t.y;
@@ -540,17 +667,17 @@ void SoundplaneMIDIOutput::sendMIDIVoiceMessages()
 		
 		if(pVoice->mSendNoteOff)
 		{
-			mpCurrentDevice->sendMessageNow(juce::MidiMessage::noteOff(chan, pVoice->mPreviousMIDINote));
+			sendMessage(juce::MidiMessage::noteOff(chan, pVoice->mPreviousMIDINote));
 		}
 		
 		if(pVoice->mSendNoteOn)
 		{
-			mpCurrentDevice->sendMessageNow(juce::MidiMessage::noteOn(chan, pVoice->mMIDINote, (unsigned char)pVoice->mMIDIVel));
+			sendMessage(juce::MidiMessage::noteOn(chan, pVoice->mMIDINote, (unsigned char)pVoice->mMIDIVel));
 		}
 		
 		if(pVoice->mSendPitchBend)
 		{
-			mpCurrentDevice->sendMessageNow(juce::MidiMessage::pitchWheel(chan, pVoice->mMIDIBend));
+			sendMessage(juce::MidiMessage::pitchWheel(chan, pVoice->mMIDIBend));
 		}
 		
 		if(pVoice->mSendPressure)
@@ -561,29 +688,29 @@ void SoundplaneMIDIOutput::sendMIDIVoiceMessages()
 				if(!mMPEExtended)
 				{
 					// normal MPE: send pressure as channel pressure
-					mpCurrentDevice->sendMessageNow(juce::MidiMessage::channelPressureChange(chan, p));
+					sendMessage(juce::MidiMessage::channelPressureChange(chan, p));
 				}
 				else
 				{
 					// MPE extensions
-					mpCurrentDevice->sendMessageNow(juce::MidiMessage::channelPressureChange(chan, p));
-					mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(chan, 11, p));
+					sendMessage(juce::MidiMessage::channelPressureChange(chan, p));
+					sendMessage(juce::MidiMessage::controllerEvent(chan, 11, p));
 				}
 			}
 			else  // for single channel MIDI, send pressure as poly aftertouch
 			{
-				mpCurrentDevice->sendMessageNow(juce::MidiMessage::aftertouchChange(chan, pVoice->mMIDINote, p));
+				sendMessage(juce::MidiMessage::aftertouchChange(chan, pVoice->mMIDINote, p));
 			}
 		}
 		
 		if(pVoice->mSendXCtrl)
 		{
-			mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(chan, 73, pVoice->mMIDIXCtrl));
+			sendMessage(juce::MidiMessage::controllerEvent(chan, 73, pVoice->mMIDIXCtrl));
 		}
 		
 		if(pVoice->mSendYCtrl)
 		{
-			mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(chan, 74, pVoice->mMIDIYCtrl));
+			sendMessage(juce::MidiMessage::controllerEvent(chan, 74, pVoice->mMIDIYCtrl));
 		}
 	}
 }
@@ -609,24 +736,24 @@ void SoundplaneMIDIOutput::sendMIDIControllerMessages()
 			
 			if(c.type == "x")
 			{
-				mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(channel, c.number1, ix));
+				sendMessage(juce::MidiMessage::controllerEvent(channel, c.number1, ix));
 			}
 			else if(c.type == "y")
 			{
-				mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(channel, c.number1, iy));
+				sendMessage(juce::MidiMessage::controllerEvent(channel, c.number1, iy));
 			}
 			else if(c.type == "xy")
 			{
-				mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(channel, c.number1, ix));
-				mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(channel, c.number2, iy));
+				sendMessage(juce::MidiMessage::controllerEvent(channel, c.number1, ix));
+				sendMessage(juce::MidiMessage::controllerEvent(channel, c.number2, iy));
 			}
 			else if(c.type == "z")
 			{
-				mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(channel, c.number1, iz));
+				sendMessage(juce::MidiMessage::controllerEvent(channel, c.number1, iz));
 			}
 			else if(c.type == "toggle")
 			{
-				mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(channel, c.number1, ix));
+				sendMessage(juce::MidiMessage::controllerEvent(channel, c.number1, ix));
 			}
 			
 			
@@ -643,7 +770,7 @@ void SoundplaneMIDIOutput::sendMIDIControllerMessages()
 
 void SoundplaneMIDIOutput::doInfrequentTasks()
 {
-	if(mpCurrentDevice && mKymaMode)
+	if(hasDevice() && mKymaMode)
 	{
 		pollKymaViaMIDI();
 	}
@@ -652,15 +779,15 @@ void SoundplaneMIDIOutput::doInfrequentTasks()
 void SoundplaneMIDIOutput::pollKymaViaMIDI()
 {
 	// set NRPN
-	mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(16, 99, 0x53));
-	mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(16, 98, 0x50));
+	sendMessage(juce::MidiMessage::controllerEvent(16, 99, 0x53));
+	sendMessage(juce::MidiMessage::controllerEvent(16, 98, 0x50));
 	
 	// data entry -- send # of voices for Kyma
-	mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(16, 6, mVoices));
+	sendMessage(juce::MidiMessage::controllerEvent(16, 6, mVoices));
 	
 	// null NRPN
-	mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(16, 99, 0xFF));
-	mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(16, 98, 0xFF));
+	sendMessage(juce::MidiMessage::controllerEvent(16, 99, 0xFF));
+	sendMessage(juce::MidiMessage::controllerEvent(16, 98, 0xFF));
 	
 	// MLTEST Kyma debug
 	//MLConsole() << "polling Kyma via MIDI: " << mVoices << " voices.\n";
@@ -701,24 +828,25 @@ void SoundplaneMIDIOutput::setBendRange(int r)
 
 void SoundplaneMIDIOutput::setMaxTouches(int t)
 {
-	mVoices = ml::clamp(t, 0, kMaxMIDIVoices);
-	if (mMPEMode && mpCurrentDevice)
+	mMaxTouches = t;
+	updateVoices();
+	if (mMPEMode && hasDevice())
 	{
 		int globalChannel=mChannel;
-		mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(globalChannel, kMPE_MIDI_CC, mVoices));
+		sendMessage(juce::MidiMessage::controllerEvent(globalChannel, kMPE_MIDI_CC, mVoices));
 	}
 }
 
 void SoundplaneMIDIOutput::sendMPEChannels()
 {
 	int chan = getMPEMainChannel();
-	if(!mpCurrentDevice) return;
-	mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(chan, kMPE_MIDI_CC, mMPEChannels));
+	if(!hasDevice()) return;
+	sendMessage(juce::MidiMessage::controllerEvent(chan, kMPE_MIDI_CC, mMPEChannels));
 }
 
 void SoundplaneMIDIOutput::sendPitchbendRange()
 {
-	if(!mpCurrentDevice) return;
+	if(!hasDevice()) return;
 	int chan = mChannel;
 	int quantizedRange = mBendRange;
 	
@@ -730,10 +858,10 @@ void SoundplaneMIDIOutput::sendPitchbendRange()
 		quantizedRange = (quantizedRange/12)*12;
 	}
 	
-	mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(chan, 100, 0));
-	mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(chan, 101, 0));
-	mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(chan, 6, quantizedRange));
-	mpCurrentDevice->sendMessageNow(juce::MidiMessage::controllerEvent(chan, 38, 0));
+	sendMessage(juce::MidiMessage::controllerEvent(chan, 100, 0));
+	sendMessage(juce::MidiMessage::controllerEvent(chan, 101, 0));
+	sendMessage(juce::MidiMessage::controllerEvent(chan, 6, quantizedRange));
+	sendMessage(juce::MidiMessage::controllerEvent(chan, 38, 0));
 }
 
 void SoundplaneMIDIOutput::dumpVoices()
@@ -8,8 +8,10 @@
 
 #include "JuceHeader.h"
 
+#include <array>
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <chrono>
 #include <stdint.h>
 #include <stdlib.h>
@@ -114,11 +116,25 @@ public:
 	void setStartChannel(int v);
 	void setKymaMode(bool v);
 	
+	// use this output's share of the MPE channels when instruments share a MIDI port.
+	void setMPEZone(int instrument, int instruments);
+	
+	// send all messages through the device of another output, which must outlive this one,
+	// instead of opening one. Used by further instruments to share the Model's MIDI port.
+	void sendThrough(SoundplaneMIDIOutput* pOutput);
+	
 	void setDataRate(float r) { mDataRate = r; }
 	
 	void doInfrequentTasks();
 	
+	uint64_t getMessagesSent() const { return mMessagesSent; }
+	
 private:
+	void sendMessage(const juce::MidiMessage& m);
+	void sendToDevice(const juce::MidiMessage& m);
+	void replaceDevice(juce::MidiOutput* pDevice);
+	bool hasDevice();
+	
 	int getMPEMainChannel();
 	int getMPEVoiceChannel(int voice);
 	int getVoiceChannel(int voice);
@@ -131,6 +147,7 @@ private:
 	
 	void sendMIDIChannelPressure(int chan, int p);
 	void sendAllMIDIChannelPressures(int p);
+	int getOutputChannels(std::array< int, kMaxMIDIVoices >& channels);
 	void sendAllMIDINotesOff();
 	
 	void sendMPEChannels();
@@ -142,8 +159,10 @@ private:
 	void sendMIDIControllerMessages();
 	void pollKymaViaMIDI();
 	void dumpVoices();
+	void updateVoices();
 	
-	int mVoices;
+	int mMaxTouches{kMaxMIDIVoices};
+	int mVoices{kMaxMIDIVoices};
 	
 	MIDIVoice mMIDIVoices[kMaxMIDIVoices];
 	
@@ -154,6 +173,9 @@ private:
 	std::vector<MIDIDevicePtr> mDevices;
 	std::vector<std::string> mDeviceList;
 	juce::MidiOutput* mpCurrentDevice;
+	std::mutex mDeviceMutex;
+	SoundplaneMIDIOutput* mpSendThrough{nullptr};
+	uint64_t mMessagesSent{0};
 	
 	bool mGotControllerChanges;
 	
@@ -170,6 +192,13 @@ private:
 	bool mMPEMode;
 	int mMPEChannels;
 	
+	// this output's MPE zone and voice channels. See setMPEZone().
+	int mMPEMainChannel{1};
+	int mFirstVoiceChannel{2};
+	int mVoiceChannelStep{1};
+	int mVoiceChannels{15};
+	int mZoneChannels{15};
+	
 	// channel to be used for single-channel output
 	int mChannel;
 	
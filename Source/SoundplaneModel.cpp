@@ -51,21 +51,24 @@ static void makeStandardCarrierSet(SoundplaneDriver::Carriers &carriers, int set
 	}
 }
 
-void touchArrayToFrame(const TouchArray* pArray, ml::Matrix* pFrame)
+// split a list of paths separated by ':'.
+static std::vector< std::string > splitPathList(const std::string& list)
 {
-	// get references for syntax
-	const TouchArray& array = *pArray;
-	ml::Matrix& frame = *pFrame;
-	
-	for(int i = 0; i < kMaxTouches; ++i)
+	std::vector< std::string > paths;
+	std::stringstream stream(list);
+	std::string path;
+	while(std::getline(stream, path, ':'))
 	{
-		Touch t = array[i];
-		frame(xColumn, i) = t.x;
-		frame(yColumn, i) = t.y;
-		frame(zColumn, i) = t.z;
-		frame(dzColumn, i) = t.dz;
-		frame(ageColumn, i) = t.age;
+		if(!path.empty()) paths.push_back(path);
 	}
+	return paths;
+}
+
+const char* kLatencyStageNames[kNumLatencyStages] = {"queue", "tracking", "zones", "outputs", "total"};
+
+static int64_t steadyClockNanos()
+{
+	return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
 }
 
 ml::Matrix sensorFrameToSignal(const SensorFrame &f)
@@ -98,17 +101,11 @@ SensorFrame signalToSensorFrame(const ml::Matrix& in)
 
 SoundplaneModel::SoundplaneModel() :
 mOutputEnabled(false),
-mSurface(SensorGeometry::width, SensorGeometry::height),
-mRawSignal(SensorGeometry::width, SensorGeometry::height),
-mCalibratedSignal(SensorGeometry::width, SensorGeometry::height),
-mSmoothedSignal(SensorGeometry::width, SensorGeometry::height),
 mCalibrating(false),
 mTestTouchesOn(false),
 mTestTouchesWasOn(false),
 mSelectingCarriers(false),
 mHasCalibration(false),
-mZoneIndexMap(kSoundplaneAKeyWidth, kSoundplaneAKeyHeight),
-mHistoryCtr(0),
 mCarrierMaskDirty(false),
 mNeedsCarriersSet(false),
 mNeedsCalibrate(false),
@@ -118,12 +115,39 @@ mDoOverrideCarriers(false),
 mKymaIsConnected(0),
 mKymaMode(false)
 {
-	mpDriver = SoundplaneDriver::create(*this);
+	// to reproduce a session without the instrument, replay a recording instead. Given a
+	// list of recordings separated by ':', the first is replayed as the Model's device and
+	// each of the rest as a further instrument on its own thread.
+	const char* replayList = getenv("SOUNDPLANE_REPLAY");
+	std::vector< std::string > replayPaths = splitPathList(replayList ? replayList : "");
+	bool realTime = (getenv("SOUNDPLANE_REPLAY_FAST") == nullptr);
+	if(!replayPaths.empty())
+	{
+		mpReplayDriver = new SoundplaneReplayDriver(*this, replayPaths[0], realTime);
+		mpDriver = std::unique_ptr< SoundplaneDriver >(mpReplayDriver);
+		
+		// a fast replay waits for the process thread instead of dropping frames.
+		mWaitForInputRoom = !realTime;
+	}
+	else
+	{
+		mpDriver = SoundplaneDriver::create(*this);
+	}
 	
-	for(int i=0; i<kMaxTouches; ++i)
+	// the instruments share the Model's MIDI port, each on its own MPE channels.
+	for(size_t i = 1; i < replayPaths.size(); ++i)
 	{
-		mCurrentKeyX[i] = -1;
-		mCurrentKeyY[i] = -1;
+		std::unique_ptr< SoundplaneInstrument > pInstrument(new SoundplaneInstrument(i));
+		if(pInstrument->openReplay(replayPaths[i], realTime))
+		{
+			pInstrument->getMIDIOutput().sendThrough(&mMIDIOutput);
+			mInstruments.push_back(std::move(pInstrument));
+		}
+	}
+	mMIDIOutput.setMPEZone(0, getNumDevices());
+	for(auto& pInstrument : mInstruments)
+	{
+		pInstrument->getMIDIOutput().setMPEZone(pInstrument->getIndex(), getNumDevices());
 	}
 	
 	// setup default carriers in case there are no saved carriers
@@ -132,7 +156,6 @@ mKymaMode(false)
 		mCarriers[car] = kModelDefaultCarriers[car];
 	}
 	
-	clearZones();
 	setAllPropertiesToDefaults();
 	
 	MLConsole() << "SoundplaneModel: listening for OSC on port " << kDefaultUDPReceivePort << "...\n";
@@ -140,9 +163,6 @@ mKymaMode(false)
 	
 	mMIDIOutput.initialize();
 	
-	mTouchFrame.setDims(kSoundplaneTouchWidth, kMaxTouches);
-	mTouchHistory.setDims(kSoundplaneTouchWidth, kMaxTouches, kSoundplaneHistorySize);
-	
 	// make zone presets collection
 	File zoneDir = getDefaultFileLocation(kPresetFiles, MLProjectInfo::makerName, MLProjectInfo::projectName).getChildFile("ZonePresets");
 	debug() << "LOOKING for zones in " << zoneDir.getFileName() << "\n";
@@ -155,18 +175,40 @@ mKymaMode(false)
 	
 	startModelTimer();
 	
-	mSensorFrameQueue = std::unique_ptr< Queue<SensorFrame> >(new Queue<SensorFrame>(kSensorFrameQueueSize));
+	mSensorFrameQueue = std::unique_ptr< SensorFrameBufferRing >(new SensorFrameBufferRing(kSensorFrameQueueSize));
 	
 	mProcessThread = std::thread(&SoundplaneModel::processThread, this);
 	SetPriorityRealtimeAudio(mProcessThread.native_handle());
 	
+	// the timer only flags the tasks as pending. They are run on the process thread
+	// so that they don't race with the outputs.
+	mInfrequentTasksTimer.start([&](){
+		mInfrequentTasksPending = true;
+		wakeProcessThread();
+		for(auto& pInstrument : mInstruments)
+		{
+			pInstrument->requestInfrequentTasks();
+		}
+	}, milliseconds(kInfrequentTasksIntervalMillis));
+	
 	mpDriver->start();
+	for(auto& pInstrument : mInstruments)
+	{
+		pInstrument->start();
+	}
 }
 
 SoundplaneModel::~SoundplaneModel()
 {
+	// the instruments send MIDI through mMIDIOutput, so they are stopped first.
+	mInstruments.clear();
+	
 	// signal threads to shut down
 	mTerminating = true;
+	{
+		std::lock_guard<std::mutex> lock(mProcessWakeMutex);
+		mProcessWakeCondition.notify_one();
+	}
 	
 	if (mProcessThread.joinable())
 	{
@@ -219,93 +261,124 @@ void SoundplaneModel::doPropertyChangeAction(ml::Symbol p, const ml::Value & new
 			}
 			else if (p == "max_touches")
 			{
-				mMaxTouches = v;
-				mMIDIOutput.setMaxTouches(v);
-				mOSCOutput.setMaxTouches(v);
+				changeRealtimeParams([&](RealtimeParams& r){ r.maxTouches = v; });
 			}
 			else if (p == "lopass_z")
 			{
-				mTracker.setLopassZ(v);
+				changeRealtimeParams([&](RealtimeParams& r){ r.lopassZ = v; });
 			}
 			else if (p == "z_thresh")
 			{
-				mTracker.setThresh(v);
+				changeRealtimeParams([&](RealtimeParams& r){ r.zThresh = v; });
+			}
+			else if (p == "tile_thresh")
+			{
+				changeRealtimeParams([&](RealtimeParams& r){ r.tileThresh = v; });
+			}
+			else if (p == "onset_thresh")
+			{
+				changeRealtimeParams([&](RealtimeParams& r){ r.onsetThresh = v; });
+			}
+			else if (p == "z_scale")
+			{
+				changeRealtimeParams([&](RealtimeParams& r){ r.zScale = v; });
+			}
+			else if (p == "z_curve")
+			{
+				changeRealtimeParams([&](RealtimeParams& r){ r.zCurve = v; });
 			}
 			else if (p == "snap")
 			{
-				sendParametersToZones();
+				changeRealtimeParams([&](RealtimeParams& r){ r.snap = v; });
 			}
 			else if (p == "vibrato")
 			{
-				sendParametersToZones();
+				changeRealtimeParams([&](RealtimeParams& r){ r.vibrato = v; });
 			}
 			else if (p == "lock")
 			{
-				sendParametersToZones();
+				bool b = v;
+				changeRealtimeParams([&](RealtimeParams& r){ r.noteLock = b; });
 			}
 			else if (p == "data_rate")
 			{
-				mDataRate = v;
-				mOSCOutput.setDataRate(v);
-				mMIDIOutput.setDataRate(v);
+				changeRealtimeParams([&](RealtimeParams& r){ r.dataRate = v; });
 			}
 			else if (p == "midi_active")
 			{
-				mMIDIOutput.setActive(bool(v));
+				bool b = v;
+				changeRealtimeParams([&](RealtimeParams& r){ r.midiActive = b; });
 			}
 			else if (p == "midi_mpe")
 			{
-				mMIDIOutput.setMPE(bool(v));
+				bool b = v;
+				changeRealtimeParams([&](RealtimeParams& r){ r.midiMPE = b; });
 			}
 			else if (p == "midi_mpe_extended")
 			{
-				mMIDIOutput.setMPEExtended(bool(v));
+				bool b = v;
+				changeRealtimeParams([&](RealtimeParams& r){ r.midiMPEExtended = b; });
 			}
 			else if (p == "midi_channel")
 			{
-				mMIDIOutput.setStartChannel(int(v));
+				// without MPE, each further instrument sends on the next channel.
+				changeRealtimeParams([&](RealtimeParams& r){ r.midiChannel = v; });
 			}
 			else if (p == "midi_pressure_active")
 			{
-				mMIDIOutput.setPressureActive(bool(v));
+				bool b = v;
+				changeRealtimeParams([&](RealtimeParams& r){ r.midiPressureActive = b; });
 			}
 			else if (p == "osc_active")
 			{
 				bool b = v;
-				mOSCOutput.setActive(b);
+				changeRealtimeParams([&](RealtimeParams& r){ r.oscActive = b; });
 			}
 			else if (p == "osc_send_matrix")
 			{
 				bool b = v;
-				mSendMatrixData = b;
+				changeRealtimeParams([&](RealtimeParams& r){ r.sendMatrix = b; });
 			}
 			else if (p == "quantize")
 			{
-				sendParametersToZones();
+				bool b = v;
+				changeRealtimeParams([&](RealtimeParams& r){ r.quantize = b; });
 			}
 			else if (p == "rotate")
 			{
 				bool b = v;
-				mTracker.setRotate(b);
+				changeRealtimeParams([&](RealtimeParams& r){ r.rotate = b; });
+			}
+			else if (p == "blobs")
+			{
+				bool b = v;
+				changeRealtimeParams([&](RealtimeParams& r){ r.touchFinder = b ? kFindBlobs : kFindPeaks; });
+			}
+			else if (p == "optimal_match")
+			{
+				bool b = v;
+				changeRealtimeParams([&](RealtimeParams& r){ r.touchMatcher = b ? kMatchOptimal : kMatchNearest; });
+			}
+			else if (p == "predict_ms")
+			{
+				changeRealtimeParams([&](RealtimeParams& r){ r.predictMs = v; });
 			}
 			else if (p == "glissando")
 			{
-				mMIDIOutput.setGlissando(bool(v));
-				sendParametersToZones();
+				bool b = v;
+				changeRealtimeParams([&](RealtimeParams& r){ r.glissando = b; });
 			}
 			else if (p == "hysteresis")
 			{
-				mMIDIOutput.setHysteresis(v);
-				sendParametersToZones();
+				changeRealtimeParams([&](RealtimeParams& r){ r.hysteresis = v; });
 			}
 			else if (p == "transpose")
 			{
-				sendParametersToZones();
+				changeRealtimeParams([&](RealtimeParams& r){ r.transpose = v; });
 			}
 			else if (p == "bend_range")
 			{
-				mMIDIOutput.setBendRange(v);
-				sendParametersToZones();
+				changeRealtimeParams([&](RealtimeParams& r){ r.bendRange = v; });
 			}
 			else if (p == "verbose")
 			{
@@ -341,7 +414,7 @@ void SoundplaneModel::doPropertyChangeAction(ml::Symbol p, const ml::Value & new
 			
 			if(p == "osc_service_name")
 			{
-				mOSCOutput.clear();
+				forEachOSCOutput([&](SoundplaneOSCOutput& o){ o.clear(); });
 				
 				// we only save the formatted service name.
 				std::string serviceName = unformatServiceName(str);
@@ -373,21 +446,46 @@ void SoundplaneModel::doPropertyChangeAction(ml::Symbol p, const ml::Value & new
 				}
 				
 				int port = MLNetServiceHub::getPort(serviceName);
-				mOSCOutput.setHostName(hostName);
-				mOSCOutput.setPort(port);
-				mOSCOutput.reconnect();
+				forEachOSCOutput([&](SoundplaneOSCOutput& o)
+				{
+					o.setHostName(hostName);
+					o.setPort(port);
+					o.reconnect();
+				});
 			}
 			if (p == "viewmode")
 			{
 				// nothing to do for Model
 			}
+			else if (p == "input_queue_policy")
+			{
+				FrameRingOverflowPolicy policy = kFrameRingDropOldest;
+				if(str == "drop newest")
+				{
+					policy = kFrameRingDropNewest;
+				}
+				else if(str == "coalesce")
+				{
+					policy = kFrameRingCoalesce;
+				}
+				mSensorFrameQueue->setPolicy(policy);
+			}
 			else if (p == "midi_device")
 			{
 				mMIDIOutput.setDevice(str);
 			}
 			else if (p == "zone_JSON")
 			{
-				loadZonesFromString(str);
+				// each process thread gets its own zones, parsed here and published with the
+				// next snapshot, which is numbered one more than the last.
+				changeRealtimeParams([&](RealtimeParams& r)
+				{
+					mPublishedZones.load(str, r.version + 1);
+					for(auto& pInstrument : mInstruments)
+					{
+						pInstrument->getPublishedZones().load(str, r.version + 1);
+					}
+				});
 			}
 			else if (p == "zone_preset")
 			{
@@ -442,25 +540,63 @@ void SoundplaneModel::doPropertyChangeAction(ml::Symbol p, const ml::Value & new
 }
 
 
+// called on the driver's thread. The OSC output and tracker belong to the process thread,
+// so what is found here is handed over for updateDeviceStartup() to apply.
 void SoundplaneModel::onStartup()
 {
 	// get serial number and auto calibrate noise on sync detect
 	const unsigned long instrumentModel = 1; // Soundplane A
-	mOSCOutput.setSerialNumber((instrumentModel << 16) | mpDriver->getSerialNumber());
+	DeviceStartup& startup = mDeviceStartupBuffer.getWriteBuffer();
+	startup.deviceID = (int)((instrumentModel << 16) | mpDriver->getSerialNumber());
 	
-	// connected but not calibrated -- disable output.
-	enableOutput(false);
-	// output will be enabled at end of calibration.
-	mNeedsCalibrate = true;
+	// a recording made with a calibration is replayed with it, so that the output is the same.
+	startup.hasCalibration = mpReplayDriver && mpReplayDriver->hasCalibration();
+	if(startup.hasCalibration)
+	{
+		startup.calibrationMean = mpReplayDriver->getCalibrationMean();
+	}
+	mDeviceStartupBuffer.publish();
+	wakeProcessThread();
 }
 
 // we need to return as quickly as possible from driver callback.
-// just put the new frame in the queue.
+// just copy the new frame into a buffer from the pool, queue it and wake the process thread if it is waiting.
+// This is the only copy of the frame's data: from here on it is shared by handle.
 void SoundplaneModel::onFrame(const SensorFrame& frame)
 {
 	if(!mTestTouchesOn)
 	{
-		mSensorFrameQueue->push(frame);
+		if(mWaitForInputRoom)
+		{
+			waitForInputRoom();
+		}
+		SensorFrameHandle buffer = mFramePool.acquire();
+		while(!buffer && mWaitForInputRoom && !mTerminating)
+		{
+			std::this_thread::sleep_for(microseconds(kInputRoomWaitMicros));
+			buffer = mFramePool.acquire();
+		}
+		if(!buffer) return;
+		
+		buffer.getFrameForWriting() = frame;
+		buffer.setTimestamp(steadyClockNanos());
+		mLastFramePushTime = buffer.getTimestamp();
+		if(mRecorder.isRecording())
+		{
+			mRecorder.addFrame(buffer);
+		}
+		mSensorFrameQueue->push(buffer.detach());
+		wakeProcessThread();
+	}
+}
+
+// in a fast replay, block the replay thread until the input queue has room, so that the
+// ring never drops a frame. A real device cannot wait, so this is never done for one.
+void SoundplaneModel::waitForInputRoom()
+{
+	while(!mTerminating && (mSensorFrameQueue->elementsAvailable() >= mSensorFrameQueue->getCapacity()))
+	{
+		std::this_thread::sleep_for(microseconds(kInputRoomWaitMicros));
 	}
 }
 
@@ -510,79 +646,171 @@ void SoundplaneModel::onClose()
 	enableOutput(false);
 }
 
+bool SoundplaneModel::processThreadHasWork()
+{
+	return mTerminating || mInfrequentTasksPending || (mSensorFrameQueue->elementsAvailable() > 0);
+}
+
+// wait until a frame arrives, infrequent tasks are due or the timeout expires.
+// the waiting flag is published before the queue is checked again under the lock,
+// and onFrame() pushes before reading the flag, so a frame is never left waiting
+// for the timeout.
+void SoundplaneModel::waitForProcessThreadWork(microseconds timeout)
+{
+	// lock-free fast path
+	if(processThreadHasWork()) return;
+	
+	std::unique_lock<std::mutex> lock(mProcessWakeMutex);
+	mProcessThreadWaiting = true;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	mProcessWakeCondition.wait_for(lock, timeout, [&](){ return processThreadHasWork(); });
+	mProcessThreadWaiting = false;
+}
+
+void SoundplaneModel::wakeProcessThread()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(mProcessThreadWaiting)
+	{
+		std::lock_guard<std::mutex> lock(mProcessWakeMutex);
+		mProcessWakeCondition.notify_one();
+	}
+}
+
 void SoundplaneModel::processThread()
 {
-	time_point<system_clock> previous, now;
-	previous = now = system_clock::now();
-	mPrevProcessTouchesTime = now; // TODO interval timer object
+	mPrevProcessTouchesTime = system_clock::now(); // TODO interval timer object
+	mProcessStatsStartTime = steady_clock::now();
 	
 	while(!mTerminating)
 	{
-		now = system_clock::now();
-		process(now);
-		mProcessCounter++;
+		// test touches are generated here at a fixed rate. Otherwise, sleep until the driver sends a frame.
+		bool generatingTestTouches = mTestTouchesOn || mTestTouchesWasOn;
+		if(generatingTestTouches)
+		{
+			std::unique_lock<std::mutex> lock(mProcessWakeMutex);
+			mProcessWakeCondition.wait_for(lock, microseconds(kTestTouchesIntervalMicros), [&](){ return mTerminating || mInfrequentTasksPending; });
+		}
+		else
+		{
+			waitForProcessThreadWork(duration_cast<microseconds>(milliseconds(kProcessThreadIdleTimeoutMillis)));
+		}
+		if(mTerminating) break;
+		mProcessWakeups++;
+		
+		if(mInfrequentTasksPending.exchange(false))
+		{
+			doInfrequentTasks();
+		}
 		
-		size_t queueSize = mSensorFrameQueue->elementsAvailable();
-		if(queueSize > mMaxRecentQueueSize)
+		// measure time from the most recent frame push to wakeup.
+		if(!generatingTestTouches && (mSensorFrameQueue->elementsAvailable() > 0))
 		{
-			mMaxRecentQueueSize = queueSize;
+			int64_t wakeTime = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+			int64_t wakeLatency = wakeTime - mLastFramePushTime;
+			mTotalRecentWakeLatency += wakeLatency;
+			mRecentWakeLatencyCount++;
+			mMaxRecentWakeLatency = std::max(mMaxRecentWakeLatency, wakeLatency);
 		}
 		
+		// process all waiting frames, or one frame of test touches.
+		do
+		{
+			size_t queueSize = mSensorFrameQueue->elementsAvailable();
+			if(queueSize > mMaxRecentQueueSize)
+			{
+				mMaxRecentQueueSize = queueSize;
+			}
+			
+			process(system_clock::now());
+			mProcessCounter++;
+		}
+		while(!generatingTestTouches && (mSensorFrameQueue->elementsAvailable() > 0));
+		
 		if(mProcessCounter >= 1000)
 		{
+			reportQueueStats();
+			
 			if(mVerbose)
 			{
-				if(mMaxRecentQueueSize >= kSensorFrameQueueSize)
-				{
-					MLConsole() << "warning: input queue full \n";
-				}
+				float seconds = duration_cast<microseconds>(steady_clock::now() - mProcessStatsStartTime).count()*0.000001f;
+				int64_t meanWakeLatency = mRecentWakeLatencyCount ? mTotalRecentWakeLatency/mRecentWakeLatencyCount : 0;
+				MLConsole() << "process thread: " << mProcessWakeups/seconds << " wakeups/s, wake latency mean "
+				<< meanWakeLatency/1000 << "us, max " << mMaxRecentWakeLatency/1000 << "us\n";
 			}
 			
 			mProcessCounter = 0;
 			mMaxRecentQueueSize = 0;
-		}
-		
-		// sleep, less than one frame interval
-		std::this_thread::sleep_for(std::chrono::microseconds(500));
-		
-		// do infrequent tasks every second
-		int secondsInterval = duration_cast<seconds>(now - previous).count();
-		if (secondsInterval >= 1)
-		{
-			previous = now;
-			doInfrequentTasks();
+			mProcessWakeups = 0;
+			mMaxRecentWakeLatency = 0;
+			mTotalRecentWakeLatency = 0;
+			mRecentWakeLatencyCount = 0;
+			mProcessStatsStartTime = steady_clock::now();
 		}
 	}
 }
 
 
+// drops are always reported. Queue statistics are reported if verbose is on.
+void SoundplaneModel::reportQueueStats()
+{
+	FrameRingStats stats = mSensorFrameQueue->getStats();
+	if(stats.dropped > mReportedQueueDrops)
+	{
+		MLConsole() << "warning: input queue full, " << (stats.dropped - mReportedQueueDrops) << " frames dropped\n";
+		mReportedQueueDrops = stats.dropped;
+	}
+	
+	int exhausted = mFramePool.getExhaustedCount();
+	if(exhausted > mReportedPoolExhaustedCount)
+	{
+		MLConsole() << "warning: frame pool empty, " << (exhausted - mReportedPoolExhaustedCount) << " frames lost\n";
+		mReportedPoolExhaustedCount = exhausted;
+	}
+	
+	if(mVerbose)
+	{
+		MLConsole() << "input queue: high water " << stats.highWater << "/" << mSensorFrameQueue->getCapacity()
+		<< ", recent max " << mMaxRecentQueueSize
+		<< ", residency mean " << stats.meanResidencyNanos()/1000 << "us, max " << stats.maxResidencyNanos/1000 << "us"
+		<< ", dropped " << stats.dropped << ", coalesced " << stats.coalesced << "\n";
+	}
+}
+
 void SoundplaneModel::process(time_point<system_clock> now)
 {
 	static int tc = 0;
 	tc++;
 	
+	updateDeviceStartup();
+	updateRealtimeParams();
+	
 	TouchArray touches{};
 	if(mTestTouchesOn || mTestTouchesWasOn)
 	{
+		mFrameArrivalTime = 0;
 		touches = getTestTouchesFromTracker(now);
 		mTestTouchesWasOn = mTestTouchesOn;
 		outputTouches(touches, now);
 	}
 	else
 	{
-		if(mSensorFrameQueue->pop(mSensorFrame))
+		SensorFrameBuffer* pBuffer;
+		if(mSensorFrameQueue->pop(pBuffer))
 		{
-			mSurface = sensorFrameToSignal(mSensorFrame);
+			SensorFrameHandle frame = SensorFrameHandle::adopt(pBuffer);
+			mFrameArrivalTime = frame.getTimestamp();
+			mStageStartTime = mFrameArrivalTime;
+			recordLatency(kLatencyQueue);
 			
-			// store surface for raw output
+			if(mRawSignal.hasActiveSubscribers())
 			{
-				std::lock_guard<std::mutex> lock(mRawSignalMutex);
-				mRawSignal.copy(mSurface);
+				mRawSignal.publish(frame);
 			}
 			
 			if(mCalibrating)
 			{
-				mStats.accumulate(mSensorFrame);
+				mStats.accumulate(*frame);
 				if (mStats.getCount() >= kSoundplaneCalibrateSize)
 				{
 					endCalibrate();
@@ -590,7 +818,7 @@ void SoundplaneModel::process(time_point<system_clock> now)
 			}
 			else if (mSelectingCarriers)
 			{
-				mStats.accumulate(mSensorFrame);
+				mStats.accumulate(*frame);
 				
 				if (mStats.getCount() >= kSoundplaneCalibrateSize)
 				{
@@ -601,9 +829,20 @@ void SoundplaneModel::process(time_point<system_clock> now)
 			{
 				if (mHasCalibration)
 				{
-					mCalibratedFrame = subtract(multiply(mSensorFrame, mCalibrateMeanInv), 1.0f);
-					
-					TouchArray touches = trackTouches(mCalibratedFrame);
+					// the calibrated frame is kept only if a view shows it or the matrix is sent.
+					const bool viewCalibrated = mCalibratedSignal.hasActiveSubscribers();
+					SensorFrameHandle calibrated;
+					if(viewCalibrated || mRealtimeParams.sendMatrix)
+					{
+						calibrated = mFramePool.acquire();
+					}
+					TouchArray touches = trackTouches(*frame, calibrated ? &calibrated.getFrameForWriting() : nullptr);
+					if(calibrated && viewCalibrated)
+					{
+						mCalibratedSignal.publish(calibrated);
+					}
+					mCalibratedFrame = std::move(calibrated);
+					recordLatency(kLatencyTracking);
 					outputTouches(touches, now);
 				}
 			}
@@ -617,12 +856,13 @@ void SoundplaneModel::outputTouches(TouchArray touches, time_point<system_clock>
 	
 	// let Zones process touches. This is always done at the controller's frame rate.
 	sendTouchesToZones(touches);
+	recordLatency(kLatencyZones);
 	
 	// determine if incoming frame could start or end a touch
 	bool notesChangedThisFrame = findNoteChanges(touches, mTouchArray1);
 	mTouchArray1 = touches;
 	
-	const int dataPeriodMicrosecs = 1000*1000 / mDataRate;
+	const int dataPeriodMicrosecs = 1000*1000 / mRealtimeParams.dataRate;
 	int microsSinceSend = duration_cast<microseconds>(now - mPrevProcessTouchesTime).count();
 	bool timeForNewFrame = (microsSinceSend >= dataPeriodMicrosecs);
 	if(notesChangedThisFrame || timeForNewFrame || mRequireSendNextFrame)
@@ -637,127 +877,7 @@ void SoundplaneModel::outputTouches(TouchArray touches, time_point<system_clock>
 //
 void SoundplaneModel::sendTouchesToZones(TouchArray touches)
 {
-	// const int maxTouches = getFloatProperty("max_touches");
-	const float hysteresis = getFloatProperty("hysteresis");
-	
-	// clear incoming touches and push touch history in each zone
-	for(auto& zone : mZones)
-	{
-		zone.newFrame();
-	}
-	
-	// add any active touches to the Zones they are over
-	// MLTEST for(int i=0; i<maxTouches; ++i)
-	
-	// iterate on all possible touches so touches will turn off when max_touches is lowered
-	for(int i=0; i<kMaxTouches; ++i)
-	{
-		float x = touches[i].x;
-		float y = touches[i].y;
-		
-		if(touchIsActive(touches[i]))
-		{
-			//std::cout << i << ":" << age << "\n";
-			// get fractional key grid position (Soundplane A)
-			Vec2 keyXY (x, y);
-			
-			// get integer key
-			int ix = (int)x;
-			int iy = (int)y;
-			
-			// apply hysteresis to raw position to get current key
-			// hysteresis: make it harder to move out of current key
-			if(touches[i].state == kTouchStateOn)
-			{
-				mCurrentKeyX[i] = ix;
-				mCurrentKeyY[i] = iy;
-			}
-			else
-			{
-				float hystWidth = hysteresis*0.25f;
-				MLRect currentKeyRect(mCurrentKeyX[i], mCurrentKeyY[i], 1, 1);
-				currentKeyRect.expand(hystWidth);
-				if(!currentKeyRect.contains(keyXY))
-				{
-					mCurrentKeyX[i] = ix;
-					mCurrentKeyY[i] = iy;
-				}
-			}
-			
-			// send index, xyz, dz to zone
-			int zoneIdx = mZoneIndexMap(mCurrentKeyX[i], mCurrentKeyY[i]);
-			if((zoneIdx >= 0) && (zoneIdx < mZones.size()))
-			{
-				Touch t = touches[i];
-				t.kx = mCurrentKeyX[i];
-				t.ky = mCurrentKeyY[i];
-				mZones[zoneIdx].addTouchToFrame(i, t);
-			}
-		}
-	}
-	
-	for(auto& zone : mZones)
-	{
-		zone.storeAnyNewTouches();
-	}
-	
-	std::bitset<kMaxTouches> freedTouches;
-	
-	// process note offs for each zone
-	// this happens before processTouches() to allow touches to be freed for reuse in this frame
-	for(auto& zone : mZones)
-	{
-		zone.processTouchesNoteOffs(freedTouches);
-	}
-	
-	// process touches for each zone
-	for(auto& zone : mZones)
-	{
-		zone.processTouches(freedTouches);
-	}
-}
-
-void SoundplaneModel::dumpOutputsByZone()
-{
-	// count touches in zones
-	int activeTouches = 0;
-	for(auto& zone : mZones)
-	{
-		// touches
-		for(int i=0; i<kMaxTouches; ++i)
-		{
-			Touch t = zone.mOutputTouches[i];
-			if(touchIsActive(t))
-			{
-				activeTouches++;
-			}
-		}
-	}
-	
-	if(activeTouches)
-	{
-		int zc = 0;
-		
-		// send messages to outputs about each zone
-		for(auto& zone : mZones)
-		{
-			
-			std::cout << "[zone " << zc++ << ": ";
-			
-			// touches
-			for(int i=0; i<kMaxTouches; ++i)
-			{
-				Touch t = zone.mOutputTouches[i];
-				if(touchIsActive(t))
-				{
-					std::cout << i << ":" << t.state << ":" << t.z << " ";
-				}
-			}
-
-			std::cout << "]";
-		}
-		std::cout << "\n";
-	}
+	mpZones->processTouches(touches, mRealtimeParams.hysteresis);
 }
 
 void SoundplaneModel::sendFrameToOutputs(time_point<system_clock> now)
@@ -765,41 +885,31 @@ void SoundplaneModel::sendFrameToOutputs(time_point<system_clock> now)
 	beginOutputFrame(now);
 	
 	// send messages to outputs about each zone
-	for(auto& zone : mZones)
+	if(mMIDIOutput.isActive())
 	{
-		// touches
-		for(int i=0; i<kMaxTouches; ++i)
-		{
-			Touch t = zone.mOutputTouches[i];
-			if(touchIsActive(t))
-			{
-				sendTouchToOutputs(i, zone.mOffset, t);
-			}
-		}
-		
-		// controllers
-		//if(zone.mOutputController.active)
-		
-		if(isControllerZoneType(zone.mType))
-		{
-			sendControllerToOutputs(zone.mZoneID, zone.mOffset, zone.mOutputController);
-		}
-		
-		
+		mpZones->sendToOutput(mMIDIOutput);
+	}
+	if(mOSCOutput.isActive())
+	{
+		mpZones->sendToOutput(mOSCOutput);
 	}
 	
 	// send optional calibrated matrix to OSC output
-	if(mSendMatrixData)
+	if(mRealtimeParams.sendMatrix)
 	{
-		ml::Matrix calibratedPressure = getCalibratedSignal();
-		if(calibratedPressure.getHeight() == SensorGeometry::height)
+		if(mCalibratedFrame)
 		{
 			// send to OSC output only
-			mOSCOutput.processMatrix(calibratedPressure);
+			mOSCOutput.processMatrix(*mCalibratedFrame);
 		}
 	}
 	
 	endOutputFrame();
+	
+	// all messages for the frame have been sent now. Frames that are not sent because of
+	// the data rate have no output or total latency.
+	recordLatency(kLatencyOutputs);
+	recordLatency(kLatencyTotal);
 }
 
 void SoundplaneModel::beginOutputFrame(time_point<system_clock> now)
@@ -814,30 +924,6 @@ void SoundplaneModel::beginOutputFrame(time_point<system_clock> now)
 	}
 }
 
-void SoundplaneModel::sendTouchToOutputs(int i, int offset, const Touch& t)
-{
-	if(mMIDIOutput.isActive())
-	{
-		mMIDIOutput.processTouch(i, offset, t);
-	}
-	if(mOSCOutput.isActive())
-	{
-		mOSCOutput.processTouch(i, offset, t);
-	}
-}
-
-void SoundplaneModel::sendControllerToOutputs(int zoneID, int offset, const ZoneMessage& m)
-{
-	if(mMIDIOutput.isActive())
-	{
-		mMIDIOutput.processController(zoneID, offset, m);
-	}
-	if(mOSCOutput.isActive())
-	{
-		mOSCOutput.processController(zoneID, offset, m);
-	}
-}
-
 void SoundplaneModel::endOutputFrame()
 {
 	if(mMIDIOutput.isActive())
@@ -857,6 +943,11 @@ void SoundplaneModel::setAllPropertiesToDefaults()
 	setProperty("lopass_z", 100.);
 	
 	setProperty("z_thresh", 0.05);
+	setProperty("tile_thresh", 0.);
+	setProperty("onset_thresh", 0.);
+	setProperty("blobs", 0.);
+	setProperty("optimal_match", 0.);
+	setProperty("predict_ms", 0.);
 	setProperty("z_scale", 1.);
 	setProperty("z_curve", 0.5);
 	setProperty("display_scale", 1.);
@@ -874,6 +965,7 @@ void SoundplaneModel::setAllPropertiesToDefaults()
 	setProperty("midi_channel", 1);
 	
 	setProperty("data_rate", 250.);
+	setProperty("input_queue_policy", "drop oldest");
 	
 	setProperty("kyma_poll", 0);
 	
@@ -946,6 +1038,10 @@ void SoundplaneModel::ProcessMessage(const osc::ReceivedMessage& m, const IpEndp
 				setProperty("max_touches", newTouches);
 			}
 		}
+		else if (std::strcmp( m.AddressPattern(), "/t3d/latency" ) == 0 )
+		{
+			sendLatencyStats(remoteEndpoint);
+		}
 	}
 	catch( osc::Exception& e )
 	{
@@ -954,6 +1050,38 @@ void SoundplaneModel::ProcessMessage(const osc::ReceivedMessage& m, const IpEndp
 	}
 }
 
+// reply to a latency query with one message per stage, all times in microseconds:
+// /t3d/latency stage count p50 p99 p99.9 max
+void SoundplaneModel::sendLatencyStats(const IpEndpointName& remoteEndpoint)
+{
+	try
+	{
+		char buffer[kUDPOutputBufferSize];
+		osc::OutboundPacketStream p(buffer, kUDPOutputBufferSize);
+		UdpTransmitSocket socket(remoteEndpoint);
+		
+		p << osc::BeginBundleImmediate;
+		for(int i = 0; i < kNumLatencyStages; ++i)
+		{
+			const LatencyHistogram& h = mLatency[i];
+			p << osc::BeginMessage( "/t3d/latency" );
+			p << kLatencyStageNames[i];
+			p << (osc::int32)h.getCount();
+			p << h.getValueAtPercentile(50.)/1000.f;
+			p << h.getValueAtPercentile(99.)/1000.f;
+			p << h.getValueAtPercentile(99.9)/1000.f;
+			p << h.getMax()/1000.f;
+			p << osc::EndMessage;
+		}
+		p << osc::EndBundle;
+		socket.Send( p.Data(), p.Size() );
+	}
+	catch(std::runtime_error err)
+	{
+		MLConsole() << "latency reply failed: " << err.what() << "\n";
+	}
+}
+
 void SoundplaneModel::ProcessBundle(const osc::ReceivedBundle &b, const IpEndpointName& remoteEndpoint)
 {
 	
@@ -1063,142 +1191,6 @@ const char* SoundplaneModel::getClientStr()
 	return mClientStr;
 }
 
-// remove all zones from the zone list.
-void SoundplaneModel::clearZones()
-{
-	mZones.clear();
-	mZoneIndexMap.fill(-1);
-}
-
-void SoundplaneModel::loadZonesFromString(const std::string& zoneStr)
-{
-	clearZones();
-	cJSON* root = cJSON_Parse(zoneStr.c_str());
-	if(!root)
-	{
-		MLConsole() << "zone file parse failed!\n";
-		const char* errStr = cJSON_GetErrorPtr();
-		MLConsole() << "    error at: " << errStr << "\n";
-		return;
-	}
-	cJSON* pNode = root->child;
-	while(pNode)
-	{
-		if(!strcmp(pNode->string, "zone"))
-		{
-			mZones.emplace_back(Zone());
-			Zone* pz = &mZones.back();
-			
-			cJSON* pZoneType = cJSON_GetObjectItem(pNode, "type");
-			if(pZoneType)
-			{
-				// get zone type and type specific attributes
-				pz->mType = pZoneType->valuestring;
-			}
-			else
-			{
-				MLConsole() << "No type for zone!\n";
-			}
-			
-			// get zone rect in keys
-			cJSON* pZoneRect = cJSON_GetObjectItem(pNode, "rect");
-			if(pZoneRect)
-			{
-				int size = cJSON_GetArraySize(pZoneRect);
-				if(size == 4)
-				{
-					int x = cJSON_GetArrayItem(pZoneRect, 0)->valueint;
-					int y = cJSON_GetArrayItem(pZoneRect, 1)->valueint;
-					int w = cJSON_GetArrayItem(pZoneRect, 2)->valueint;
-					int h = cJSON_GetArrayItem(pZoneRect, 3)->valueint;
-					pz->setBounds(MLRect(x, y, w, h));
-				}
-				else
-				{
-					MLConsole() << "Bad rect for zone!\n";
-				}
-			}
-			else
-			{
-				MLConsole() << "No rect for zone\n";
-			}
-			
-			pz->mName = TextFragment(getJSONString(pNode, "name"));
-			pz->mStartNote = getJSONInt(pNode, "note");
-			pz->mOffset = getJSONInt(pNode, "offset");
-			pz->mControllerNum1 = getJSONInt(pNode, "ctrl1");
-			pz->mControllerNum2 = getJSONInt(pNode, "ctrl2");
-			pz->mControllerNum3 = getJSONInt(pNode, "ctrl3");
-			
-			int zoneIdx = mZones.size() - 1;
-			if(zoneIdx < kSoundplaneAMaxZones)
-			{
-				pz->setZoneID(zoneIdx);
-				
-				MLRect b(pz->getBounds());
-				int x = b.x();
-				int y = b.y();
-				int w = b.width();
-				int h = b.height();
-				
-				for(int j=y; j < y + h; ++j)
-				{
-					for(int i=x; i < x + w; ++i)
-					{
-						mZoneIndexMap(i, j) = zoneIdx;
-					}
-				}
-			}
-			else
-			{
-				MLConsole() << "SoundplaneModel::loadZonesFromString: out of zones!\n";
-			}
-		}
-		pNode = pNode->next;
-	}
-	sendParametersToZones();
-}
-
-
-// copy relevant parameters from Model to zones
-void SoundplaneModel::sendParametersToZones()
-{
-	// TODO zones should have parameters (really attributes) too, so they can be inspected.
-	int zones = mZones.size();
-	const float v = getFloatProperty("vibrato");
-	const float h = getFloatProperty("hysteresis");
-	bool q = getFloatProperty("quantize");
-	bool nl = getFloatProperty("lock");
-	int t = getFloatProperty("transpose");
-	float sf = getFloatProperty("snap");
-	
-	for(int i=0; i<zones; ++i)
-	{
-		mZones[i].mVibrato = v;
-		mZones[i].mHysteresis = h;
-		mZones[i].mQuantize = q;
-		mZones[i].mNoteLock = nl;
-		mZones[i].mTranspose = t;
-		mZones[i].setSnapFreq(sf);
-	}
-}
-
-// c over [0 - 1] fades response from sqrt(x) -> x -> x^2
-//
-float responseCurve(float x, float c)
-{
-	float y;
-	if(c < 0.5f)
-	{
-		y = lerp(x*x, x, c*2.f);
-	}
-	else
-	{
-		y = lerp(x, sqrtf(x), c*2.f - 1.f);
-	}
-	return y;
-}
-
 bool SoundplaneModel::findNoteChanges(TouchArray t0, TouchArray t1)
 {
 	bool anyChanges = false;
@@ -1215,59 +1207,39 @@ bool SoundplaneModel::findNoteChanges(TouchArray t0, TouchArray t1)
 	return anyChanges;
 }
 
-TouchArray SoundplaneModel::scaleTouchPressureData(TouchArray in)
+TouchArray SoundplaneModel::scaleTouchPressureData(const TouchArray& in)
 {
-	TouchArray out = in;
-	
-	const float zscale = getFloatProperty("z_scale");
-	const float zcurve = getFloatProperty("z_curve");
-	const float dzScale = 0.125f;
-	
-	for(int i=0; i<kMaxTouches; ++i)
-	{
-		float z = in[i].z;
-		z *= zscale;
-		z = ml::clamp(z, 0.f, 4.f);
-		z = responseCurve(z, zcurve);
-		out[i].z = z;
-		
-		// for note-ons, use same z scale controls as pressure
-		float dz = in[i].dz*dzScale;
-		dz *= zscale;
-		dz = ml::clamp(dz, 0.f, 1.f);
-		dz = responseCurve(dz, zcurve);
-		out[i].dz = dz;
-	}
-	return out;
+	return scaleTouchPressure(in, mRealtimeParams.zScale, mRealtimeParams.zCurve);
 }
 
-TouchArray SoundplaneModel::trackTouches(const SensorFrame& frame)
+TouchArray SoundplaneModel::trackTouches(const SensorFrame& raw, SensorFrame* pCalibrated)
 {
-	SensorFrame curvature = mTracker.preprocess(frame);
-	TouchArray t = mTracker.process(curvature, mMaxTouches);
-	mSmoothedSignal = sensorFrameToSignal(curvature);
-	t = scaleTouchPressureData(t);
-	return t;
+	const SensorFrame& curvature = mTracker.preprocessRaw(raw, pCalibrated);
+	const TouchArray& t = mTracker.process(curvature, mRealtimeParams.maxTouches);
+	
+	if(mSmoothedSignal.hasActiveSubscribers())
+	{
+		SensorFrameHandle smoothed = mFramePool.acquire();
+		if(smoothed)
+		{
+			smoothed.getFrameForWriting() = curvature;
+			mSmoothedSignal.publish(smoothed);
+		}
+	}
+	
+	return scaleTouchPressureData(t);
 }
 
 TouchArray SoundplaneModel::getTestTouchesFromTracker(time_point<system_clock> now)
 {
-	TouchArray t = mTracker.getTestTouches(now, mMaxTouches);
-	t = scaleTouchPressureData(t);
-	return t;
+	return scaleTouchPressureData(mTracker.getTestTouches(now, mRealtimeParams.maxTouches));
 }
 
+// publish the touches of each frame to the views, and add them to the history.
 void SoundplaneModel::saveTouchHistory(const TouchArray& t)
 {
-	// convert array of touches to Signal for display, history
-	{
-		std::lock_guard<std::mutex> lock(mTouchFrameMutex);
-		touchArrayToFrame(&t, &mTouchFrame);
-	}
-	
-	mHistoryCtr++;
-	if (mHistoryCtr >= kSoundplaneHistorySize) mHistoryCtr = 0;
-	mTouchHistory.setFrame(mHistoryCtr, mTouchFrame);
+	mTouchSignal.publish(t);
+	mTouchHistory.add(t);
 }
 
 void SoundplaneModel::doInfrequentTasks()
@@ -1347,9 +1319,170 @@ void SoundplaneModel::enableOutput(bool b)
 	mOutputEnabled = b;
 }
 
+// the tracker is cleared by the process thread before its next frame.
 void SoundplaneModel::clear()
 {
-	mTracker.clear();
+	changeRealtimeParams([&](RealtimeParams& r){ r.trackerClears++; });
+	resetLatencyStats();
+}
+
+// --------------------------------------------------------------------------------
+#pragma mark realtime parameters
+
+// called with mParamsMutex held, so there is one writer at a time for each buffer.
+void SoundplaneModel::publishRealtimeParams()
+{
+	mParams.version++;
+	RealtimeParams& p = mRealtimeParamsBuffer.getWriteBuffer();
+	p = mParams;
+	p.zones = mPublishedZones.getForPublishing();
+	mRealtimeParamsBuffer.publish();
+	mPublishedZones.freeRetired();
+	for(auto& pInstrument : mInstruments)
+	{
+		pInstrument->publishParams(mParams);
+	}
+}
+
+// on the process thread, once per frame: take the newest parameters, if any have been
+// published, and apply those that changed to the tracker, zones and outputs.
+void SoundplaneModel::updateRealtimeParams()
+{
+	if(!mRealtimeParamsBuffer.update()) return;
+	const RealtimeParams& p = mRealtimeParamsBuffer.getReadBuffer();
+	const RealtimeParams* prev = mRealtimeParamsApplied ? &mRealtimeParams : nullptr;
+	applyTrackerParams(mTracker, p, prev);
+	if(prev && (p.trackerClears != prev->trackerClears))
+	{
+		mTracker.clear();
+	}
+	
+	// new zones were parsed by the publisher, so here they are only swapped in. Once this
+	// snapshot is applied, the publisher may free the zones it replaced.
+	const bool newZones = zonesChanged(p, prev);
+	if(newZones)
+	{
+		mpZones = p.zones;
+	}
+	if(newZones || zoneParamsChanged(p, prev))
+	{
+		applyZoneParams(*mpZones, p);
+	}
+	applyOutputParams(mMIDIOutput, mOSCOutput, p, prev, 0);
+	mRealtimeParams = p;
+	mRealtimeParamsApplied = true;
+	mPublishedZones.setAppliedVersion(p.version);
+}
+
+// on the process thread: apply the device found by onStartup(), if it has started since
+// the last call.
+void SoundplaneModel::updateDeviceStartup()
+{
+	if(!mDeviceStartupBuffer.update()) return;
+	const DeviceStartup& startup = mDeviceStartupBuffer.getReadBuffer();
+	mOSCOutput.setSerialNumber(startup.deviceID);
+	
+	// connected but not calibrated -- disable output.
+	enableOutput(false);
+	
+	if(startup.hasCalibration)
+	{
+		mNeedsCarriersSet = false;
+		mNeedsCalibrate = false;
+		setCalibration(startup.calibrationMean);
+		enableOutput(true);
+		return;
+	}
+	
+	// output will be enabled at end of calibration.
+	mNeedsCalibrate = true;
+}
+
+// --------------------------------------------------------------------------------
+#pragma mark recording
+
+// the header records the calibration in effect now, so recordings should be started
+// after calibrating to be replayed exactly.
+bool SoundplaneModel::startRecording(const std::string& path)
+{
+	SensorRecordingHeader header;
+	initSensorRecordingHeader(header);
+	
+	header.numCarriers = kSoundplaneNumCarriers;
+	for(int i = 0; i < kSoundplaneNumCarriers; ++i)
+	{
+		header.carriers[i] = mCarriers[i];
+	}
+	
+	if(getDeviceState() != kNoDevice)
+	{
+		std::string serial = mpDriver->getSerialNumberString();
+		strncpy(header.serialNumber, serial.c_str(), kSensorRecordingSerialSize - 1);
+		header.firmwareVersion = mpDriver->getFirmwareVersion();
+	}
+	
+	if(mHasCalibration)
+	{
+		header.hasCalibration = 1;
+		std::copy(mCalibrateMean.begin(), mCalibrateMean.end(), header.calibrationMean);
+	}
+	
+	header.startTime = duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+	
+	bool r = mRecorder.start(path, header);
+	if(r)
+	{
+		MLConsole() << "recording to " << path << "\n";
+	}
+	return r;
+}
+
+void SoundplaneModel::stopRecording()
+{
+	mRecorder.stop();
+}
+
+// --------------------------------------------------------------------------------
+#pragma mark latency statistics
+
+// record the time since the previous stage ended and start timing the next one.
+// The total is always measured from the frame's arrival in onFrame().
+void SoundplaneModel::recordLatency(LatencyStage s)
+{
+	if(!mFrameArrivalTime) return;
+	
+	int64_t t = steadyClockNanos();
+	if(s == kLatencyTotal)
+	{
+		mLatency[s].record(t - mFrameArrivalTime);
+	}
+	else
+	{
+		mLatency[s].record(t - mStageStartTime);
+		mStageStartTime = t;
+	}
+}
+
+void SoundplaneModel::printLatencyStats()
+{
+	MLConsole() << "latency in microseconds:\n";
+	for(int i = 0; i < kNumLatencyStages; ++i)
+	{
+		const LatencyHistogram& h = mLatency[i];
+		MLConsole() << "    " << kLatencyStageNames[i] << ": " << (int)h.getCount() << " frames"
+		<< ", p50 " << h.getValueAtPercentile(50.)/1000.f
+		<< ", p99 " << h.getValueAtPercentile(99.)/1000.f
+		<< ", p99.9 " << h.getValueAtPercentile(99.9)/1000.f
+		<< ", max " << h.getMax()/1000.f << "\n";
+	}
+}
+
+void SoundplaneModel::resetLatencyStats()
+{
+	for(auto& h : mLatency)
+	{
+		h.reset();
+	}
 }
 
 // --------------------------------------------------------------------------------
@@ -1371,13 +1504,18 @@ void SoundplaneModel::beginCalibrate()
 //
 void SoundplaneModel::endCalibrate()
 {
-	SensorFrame mean = clamp(mStats.mean(), 0.0001f, 1.f);
-	mCalibrateMeanInv = divide(fill(1.f), mean);
+	setCalibration(clamp(mStats.mean(), 0.0001f, 1.f));
 	mCalibrating = false;
-	mHasCalibration = true;
 	enableOutput(true);
 }
 
+void SoundplaneModel::setCalibration(const SensorFrame& mean)
+{
+	mCalibrateMean = mean;
+	mTracker.setCalibration(mean);
+	mHasCalibration = true;
+}
+
 float SoundplaneModel::getCalibrateProgress()
 {
 	return mStats.getCount() / (float)kSoundplaneCalibrateSize;
@@ -1397,7 +1535,7 @@ void SoundplaneModel::beginSelectCarriers()
 		mSelectCarriersStep = 0;
 		mStats.clear();
 		mSelectingCarriers = true;
-		mTracker.clear();
+		changeRealtimeParams([&](RealtimeParams& r){ r.trackerClears++; });
 		mMaxNoiseByCarrierSet.resize(kStandardCarrierSets);
 		mMaxNoiseByCarrierSet.clear();
 		mMaxNoiseFreqByCarrierSet.resize(kStandardCarrierSets);
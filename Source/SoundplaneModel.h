@@ -8,7 +8,11 @@
 
 #include <list>
 #include <map>
+#include <memory>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <stdint.h>
 
 #include "cJSON.h"
@@ -18,31 +22,65 @@
 #include "MLSymbol.h"
 #include "MLFileCollection.h"
 #include "MLQueue.h"
+#include "FrameRing.h"
+#include "SensorFramePool.h"
+#include "LatencyHistogram.h"
+#include "SensorRecording.h"
 
 #include "SoundplaneModelA.h"
 #include "SoundplaneDriver.h"
+#include "SoundplaneReplayDriver.h"
+#include "SoundplaneInstrument.h"
 
 #include "TouchTracker.h"
+#include "RealtimeParams.h"
+#include "SignalPublisher.h"
+#include "TouchHistory.h"
 #include "SoundplaneMIDIOutput.h"
 #include "SoundplaneOSCOutput.h"
 #include "SoundplaneBinaryData.h"
 #include "Zone.h"
+#include "ZoneSet.h"
+#include "PublishedZones.h"
 
 using namespace ml;
 using namespace std::chrono;
 
 Matrix sensorFrameToSignal(const SensorFrame &f);
 
+const int kSensorFrameQueueSize = 16;
+
+// enough buffers for a full input queue and recorder queue plus the frames held by the
+// process thread, views and outputs.
+const int kSensorFramePoolSize = 128;
+
+// the signals published to the views. Each subscription to a frame signal holds up to
+// three frames from the pool.
+typedef SignalPublisher< SensorFrameHandle > SensorFramePublisher;
+typedef SignalPublisher< TouchArray > TouchArrayPublisher;
+
+// longest time the process thread will sleep when no frames are arriving.
+const int kProcessThreadIdleTimeoutMillis = 100;
+const int kInputRoomWaitMicros = 100;
+
+// interval for generating test touches, which don't come from the driver.
+const int kTestTouchesIntervalMicros = 1000;
+
+// interval for calling doInfrequentTasks() from the process thread.
+const int kInfrequentTasksIntervalMillis = 1000;
+
+// stages of the path from a frame arriving in onFrame() to the outputs sending it.
 typedef enum
 {
-	xColumn = 0,
-	yColumn = 1,
-	zColumn = 2,
-	dzColumn = 3,
-	ageColumn = 4
-} TouchSignalColumns;
+	kLatencyQueue = 0,	// waiting in the input queue
+	kLatencyTracking,	// calibration and touch tracking
+	kLatencyZones,		// zones processing touches
+	kLatencyOutputs,	// outputs formatting and sending
+	kLatencyTotal,		// from onFrame() to the last send
+	kNumLatencyStages
+} LatencyStage;
 
-const int kSensorFrameQueueSize = 16;
+extern const char* kLatencyStageNames[kNumLatencyStages];
 
 class SoundplaneModel :
 public SoundplaneDriverListener,
@@ -78,8 +116,8 @@ public:
 	float getSampleHistory(int x, int y);
 	
 	void getHistoryStats(float& mean, float& stdDev);
-	int getWidth() { return mSurface.getWidth(); }
-	int getHeight() { return mSurface.getHeight(); }
+	int getWidth() { return SensorGeometry::width; }
+	int getHeight() { return SensorGeometry::height; }
 	
 	void setDefaultCarriers();
 	void setCarriers(const SoundplaneDriver::Carriers& c);
@@ -116,20 +154,20 @@ public:
 	
 	void getMinMaxHistory(int n);
 	
-	const ml::Matrix& getTouchFrame() { return mTouchFrame; }
-	const ml::Matrix& getTouchHistory() { return mTouchHistory; }
-	const ml::Matrix getRawSignal() { std::lock_guard<std::mutex> lock(mRawSignalMutex); return mRawSignal; }
-	const ml::Matrix getCalibratedSignal() { std::lock_guard<std::mutex> lock(mCalibratedSignalMutex); return sensorFrameToSignal(mCalibratedFrame); }
-	
-	const ml::Matrix getSmoothedSignal() { std::lock_guard<std::mutex> lock(mSmoothedSignalMutex); return mSmoothedSignal; }
-	
-	const TouchArray& getTouchArray() { return mTouchArray1; }
+	// the signals shown by the views, published by the process thread once per frame. A view
+	// subscribes to those it shows and reads them through its subscription, which never
+	// blocks the process thread. See SignalPublisher.h.
+	SensorFramePublisher& getRawSignal() { return mRawSignal; }
+	SensorFramePublisher& getCalibratedSignal() { return mCalibratedSignal; }
+	SensorFramePublisher& getSmoothedSignal() { return mSmoothedSignal; }
+	TouchArrayPublisher& getTouchSignal() { return mTouchSignal; }
+	const TouchHistory& getTouchHistory() const { return mTouchHistory; }
 	
 	bool isWithinTrackerCalibrateArea(int i, int j);
-	const int getHistoryCtr() { return mHistoryCtr; }
 	
-	const std::vector< Zone >::const_iterator getZonesBegin(){ return mZones.begin(); }
-	const std::vector< Zone >::const_iterator getZonesEnd(){ return mZones.end(); }
+	// the zones in use. They are replaced when a new zone map is loaded, so a reader keeps
+	// the returned pointer while it reads them. Not for the process thread.
+	std::shared_ptr< const ZoneSet > getZones() { return mPublishedZones.getForReading(); }
 	
 	void setStateFromJSON(cJSON* pNode, int depth);
 	bool loadZonePresetByName(const std::string& name);
@@ -139,88 +177,108 @@ public:
 	
 	SoundplaneMIDIOutput& getMIDIOutput() { return mMIDIOutput; }
 	
+	// the number of devices tracked: the Model's own, and one more for each instrument.
+	int getNumDevices() const { return 1 + (int)mInstruments.size(); }
+	
+	// latency statistics, readable from any thread.
+	const LatencyHistogram& getLatencyHistogram(LatencyStage s) const { return mLatency[s]; }
+	void printLatencyStats();
+	void resetLatencyStats();
+	
+	// record all incoming frames to a file that SoundplaneReplayDriver can play back.
+	bool startRecording(const std::string& path);
+	void stopRecording();
+	bool isRecording() const { return mRecorder.isRecording(); }
+	
 private:
 	TouchArray mTouchArray1{};
 	TouchArray mZoneOutputTouches{};
 	
 	std::unique_ptr< SoundplaneDriver > mpDriver;
-	std::unique_ptr< Queue< SensorFrame > > mSensorFrameQueue;
+	
+	// set if mpDriver is replaying a recording.
+	SoundplaneReplayDriver* mpReplayDriver{nullptr};
+	
+	// all frames are kept in buffers from the pool, which must outlive any handles to them.
+	SensorFramePool mFramePool{kSensorFramePoolSize};
+	std::unique_ptr< SensorFrameBufferRing > mSensorFrameQueue;
+	int mReportedPoolExhaustedCount{0};
+	
+	SensorFrameRecorder mRecorder;
+	
+	// the time the current frame arrived in onFrame(), or 0 for test touches, and the
+	// start of the stage being timed, both from steady_clock in nanoseconds.
+	int64_t mFrameArrivalTime{0};
+	int64_t mStageStartTime{0};
+	void recordLatency(LatencyStage s);
+	LatencyHistogram mLatency[kNumLatencyStages];
+	void sendLatencyStats(const IpEndpointName& remoteEndpoint);
 	
 	// TODO order!
 	void process(time_point<system_clock> now);
 	void outputTouches(TouchArray touches, time_point<system_clock> now);
-	void dumpOutputsByZone();
 	
-	TouchArray trackTouches(const SensorFrame& frame);
+	// calibrate a raw frame, and track touches in it. The calibrated frame is written to
+	// pCalibrated if it is not null.
+	TouchArray trackTouches(const SensorFrame& raw, SensorFrame* pCalibrated);
 	TouchArray getTestTouchesFromTracker(time_point<system_clock> now);
 	void saveTouchHistory(const TouchArray& t);
 
 	void initialize();
 	bool findNoteChanges(TouchArray t0, TouchArray t1);
-	TouchArray scaleTouchPressureData(TouchArray in);
+	TouchArray scaleTouchPressureData(const TouchArray& in);
 	
 	void sendTouchesToZones(TouchArray touches);
 	
 	void sendFrameToOutputs(time_point<system_clock> now);
 	void beginOutputFrame(time_point<system_clock> now);
-	void sendTouchToOutputs(int i, int offset, const Touch& t);
-	void sendControllerToOutputs(int zoneID, int offset, const ZoneMessage& m);
 	void endOutputFrame();
 	
-	void clearZones();
-	void sendParametersToZones();
-	
-	std::vector< Zone > mZones;
-	ml::Matrix mZoneIndexMap;
+	// the zones loaded from zone_JSON, and the set the process thread is using.
+	PublishedZones mPublishedZones;
+	ZoneSet mNoZones;
+	ZoneSet* mpZones{&mNoZones};
 	
 	bool mOutputEnabled;
 	
 	static const int kMiscStringSize{256};
-	void loadZonesFromString(const std::string& zoneStr);
 	
 	void doInfrequentTasks();
 	uint64_t mLastInfrequentTaskTime;
+	ml::Timer mInfrequentTasksTimer;
+	std::atomic<bool> mInfrequentTasksPending{false};
 	
 	int mSerialNumber;
 	
 	SoundplaneMIDIOutput mMIDIOutput;
 	SoundplaneOSCOutput mOSCOutput;
 	
-	SensorFrame mSensorFrame{};
-	SensorFrame mCalibratedFrame{};
-	
-	ml::Matrix mSurface;
-	
-	int	mMaxTouches;
-	
-	ml::Matrix mTouchFrame;
-	std::mutex mTouchFrameMutex;
-	ml::Matrix mTouchHistory;
-	
 	bool mCalibrating;
 	bool mTestTouchesOn;
 	bool mTestTouchesWasOn;
 	bool mRequireSendNextFrame{false};
 	bool mSelectingCarriers;
 	bool mRaw;
-	bool mSendMatrixData;
 	
 	SoundplaneDriver::Carriers mCarriers;
 	
 	bool mHasCalibration;
 	
 	SensorFrameStats mStats;
-	SensorFrame mCalibrateMeanInv{};
-	
-	ml::Matrix mRawSignal;
-	std::mutex mRawSignalMutex;
+	SensorFrame mCalibrateMean{};
+	void setCalibration(const SensorFrame& mean);
 	
-	ml::Matrix mCalibratedSignal;
-	std::mutex mCalibratedSignalMutex;
+	// the most recent calibrated frame, for the matrix output, or empty if the matrix is not
+	// being sent. Used only by the process thread.
+	SensorFrameHandle mCalibratedFrame;
 	
-	SensorFrame mSmoothedFrame{};
-	ml::Matrix mSmoothedSignal;
-	std::mutex mSmoothedSignalMutex;
+	// the signals published to the views. Frames are only made for the signals that some
+	// view is reading.
+	SensorFramePublisher mRawSignal;
+	SensorFramePublisher mCalibratedSignal;
+	SensorFramePublisher mSmoothedSignal;
+	TouchArrayPublisher mTouchSignal;
+	TouchHistory mTouchHistory;
 	
 	int mCalibrateStep; // calibrate step from 0 - end
 	int mTotalCalibrateSteps;
@@ -229,17 +287,42 @@ private:
 	float mSurfaceWidthInv;
 	float mSurfaceHeightInv;
 	
-	// store current key for each touch to implement hysteresis.
-	int mCurrentKeyX[kMaxTouches];
-	int mCurrentKeyY[kMaxTouches];
-	
 	char mHardwareStr[kMiscStringSize];
 	char mStatusStr[kMiscStringSize];
 	char mClientStr[kMiscStringSize];
 	
 	TouchTracker mTracker;
 	
-	int mHistoryCtr;
+	// the parameters the process threads use. Property changes are made to mParams under the
+	// lock, and the whole struct published to each process thread. The Model's process thread
+	// applies the newest snapshot to mRealtimeParams at the start of each frame.
+	RealtimeParams mParams;
+	std::mutex mParamsMutex;
+	RealtimeParamsBuffer mRealtimeParamsBuffer;
+	RealtimeParams mRealtimeParams;
+	bool mRealtimeParamsApplied{false};
+	
+	template< typename F > void changeRealtimeParams(F f)
+	{
+		std::lock_guard<std::mutex> lock(mParamsMutex);
+		f(mParams);
+		publishRealtimeParams();
+	}
+	void publishRealtimeParams();
+	void updateRealtimeParams();
+	
+	// the device as found by onStartup() on the driver's thread, applied by the process thread.
+	DeviceStartupBuffer mDeviceStartupBuffer;
+	void updateDeviceStartup();
+	
+	// further devices, each tracked on its own thread into its own outputs. The views
+	// show only the Model's device. See SoundplaneInstrument.h.
+	std::vector< std::unique_ptr< SoundplaneInstrument > > mInstruments;
+	
+	// apply a setting to the Model's own output and to each instrument's. Settings the process
+	// threads read go through changeRealtimeParams() instead.
+	template< typename F > void forEachOSCOutput(F f) { f(mOSCOutput); for(auto& pInstrument : mInstruments) f(pInstrument->getOSCOutput()); }
+	
 	bool mCarrierMaskDirty;
 	bool mNeedsCarriersSet;
 	bool mNeedsCalibrate;
@@ -259,14 +342,34 @@ private:
 	
 	bool mVerbose;
 	
-	bool mTerminating{false};
+	std::atomic<bool> mTerminating{false};
 	int mProcessCounter{0};
 	void processThread();
 	std::thread mProcessThread;
 	
+	// the process thread parks here when there is nothing to do. onFrame() only takes the
+	// mutex to notify if the thread has announced that it is waiting.
+	bool processThreadHasWork();
+	void waitForProcessThreadWork(microseconds timeout);
+	void wakeProcessThread();
+	void waitForInputRoom();
+	bool mWaitForInputRoom{false};
+	std::mutex mProcessWakeMutex;
+	std::condition_variable mProcessWakeCondition;
+	std::atomic<bool> mProcessThreadWaiting{false};
+	
+	// wakeup statistics, reported with verbose on.
+	std::atomic<int64_t> mLastFramePushTime{0};
+	int mProcessWakeups{0};
+	int64_t mMaxRecentWakeLatency{0};
+	int64_t mTotalRecentWakeLatency{0};
+	int mRecentWakeLatencyCount{0};
+	time_point<steady_clock> mProcessStatsStartTime{};
+	
 	size_t mMaxRecentQueueSize{0};
+	uint64_t mReportedQueueDrops{0};
+	void reportQueueStats();
 	
-	int mDataRate{100};
 	time_point<system_clock> mPrevProcessTouchesTime{};
 };
 
@@ -425,14 +425,15 @@ void SoundplaneOSCOutput::sendInfrequentDataToKyma()
 }
 
 
-void SoundplaneOSCOutput::processMatrix(const ml::Matrix& m)
+// the frame has the same row layout as the 64x8 matrix this message has always sent.
+void SoundplaneOSCOutput::processMatrix(const SensorFrame& f)
 {
 	osc::OutboundPacketStream* p = getPacketStreamForOffset(0);
 	UdpTransmitSocket* socket = getTransmitSocketForOffset(0);
 	if((!p) || (!socket)) return;
 	
 	*p << osc::BeginMessage( "/t3d/matrix" );
-	*p << osc::Blob( m.getConstBuffer(), m.getSize()*sizeof(float) );
+	*p << osc::Blob( f.data(), f.size()*sizeof(float) );
 	*p << osc::EndMessage;
 	
 	socket->Send( p->Data(), p->Size() );
@@ -15,6 +15,7 @@
 #include "MLT3DPorts.h"
 #include "MLDebug.h"
 #include "SoundplaneOutput.h"
+#include "SensorFrame.h"
 #include "SoundplaneModelA.h"
 #include "JuceHeader.h"
 
@@ -25,6 +26,7 @@
 
 extern const char* kDefaultHostnameString;
 
+// big enough for a frame of 64 touches.
 const int kUDPOutputBufferSize = 4096;
 
 using namespace std::chrono;
@@ -59,7 +61,7 @@ public:
 	void notify(int connected);
 	void doInfrequentTasks();
 	
-	void processMatrix(const ml::Matrix& m);
+	void processMatrix(const SensorFrame& f);
 	
 private:
 	void initializeSocket(int port);
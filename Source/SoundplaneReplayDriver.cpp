@@ -0,0 +1,166 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "SoundplaneReplayDriver.h"
+
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "MLDebug.h"
+
+SoundplaneReplayDriver::SoundplaneReplayDriver(SoundplaneDriverListener& listener, const std::string& path, bool realTime) :
+mListener(listener),
+mRealTime(realTime),
+mState(kNoDevice)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+	{
+		MLConsole() << "SoundplaneReplayDriver: could not open " << path << "\n";
+		return;
+	}
+
+	struct stat st;
+	if((fstat(fd, &st) == 0) && (st.st_size > 0))
+	{
+		void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(p != MAP_FAILED)
+		{
+			mpMappedData = p;
+			mMappedSize = st.st_size;
+		}
+	}
+	::close(fd);
+
+	if(!mpMappedData)
+	{
+		MLConsole() << "SoundplaneReplayDriver: could not map " << path << "\n";
+		return;
+	}
+
+	const SensorRecordingHeader* pHeader = static_cast<const SensorRecordingHeader*>(mpMappedData);
+	const char* err = validateSensorRecordingHeader(*pHeader, mMappedSize);
+	if(err)
+	{
+		MLConsole() << "SoundplaneReplayDriver: " << path << ": " << err << "\n";
+		close();
+		return;
+	}
+
+	// a partial frame at the end, from a recording that was cut off, is ignored.
+	mpHeader = pHeader;
+	const char* pFrameData = static_cast<const char*>(mpMappedData) + mpHeader->headerSize;
+	mpFrames = reinterpret_cast<const SensorRecordingFrame*>(pFrameData);
+	mFrameCount = (mMappedSize - mpHeader->headerSize) / sizeof(SensorRecordingFrame);
+
+	int carriers = std::min((int)mpHeader->numCarriers, (int)mCarriers.size());
+	std::copy(mpHeader->carriers, mpHeader->carriers + carriers, mCarriers.begin());
+
+	mState = kDeviceConnected;
+	MLConsole() << "SoundplaneReplayDriver: " << path << ", " << (int)mFrameCount << " frames\n";
+}
+
+SoundplaneReplayDriver::~SoundplaneReplayDriver()
+{
+	mTerminating = true;
+	if(mReplayThread.joinable())
+	{
+		mReplayThread.join();
+	}
+	close();
+}
+
+void SoundplaneReplayDriver::close()
+{
+	if(mpMappedData)
+	{
+		munmap(mpMappedData, mMappedSize);
+	}
+	mpMappedData = nullptr;
+	mMappedSize = 0;
+	mpHeader = nullptr;
+	mpFrames = nullptr;
+	mFrameCount = 0;
+}
+
+void SoundplaneReplayDriver::start()
+{
+	if(!isOpen() || mReplayThread.joinable()) return;
+	mReplayThread = std::thread(&SoundplaneReplayDriver::replayThread, this);
+}
+
+int SoundplaneReplayDriver::getDeviceState() const
+{
+	return mState;
+}
+
+uint16_t SoundplaneReplayDriver::getFirmwareVersion() const
+{
+	return mpHeader ? mpHeader->firmwareVersion : 0;
+}
+
+std::string SoundplaneReplayDriver::getSerialNumberString() const
+{
+	if(!mpHeader) return std::string();
+	const char* s = mpHeader->serialNumber;
+	return std::string(s, strnlen(s, kSensorRecordingSerialSize));
+}
+
+const SoundplaneDriver::Carriers& SoundplaneReplayDriver::getCarriers() const
+{
+	return mCarriers;
+}
+
+void SoundplaneReplayDriver::setCarriers(const Carriers& carriers)
+{
+}
+
+void SoundplaneReplayDriver::enableCarriers(unsigned long mask)
+{
+}
+
+bool SoundplaneReplayDriver::hasCalibration() const
+{
+	return mpHeader && mpHeader->hasCalibration;
+}
+
+SensorFrame SoundplaneReplayDriver::getCalibrationMean() const
+{
+	SensorFrame mean{};
+	if(hasCalibration())
+	{
+		std::copy(mpHeader->calibrationMean, mpHeader->calibrationMean + SensorGeometry::elements, mean.begin());
+	}
+	return mean;
+}
+
+// frames are copied out of the mapping one at a time, because the listener takes a SensorFrame.
+void SoundplaneReplayDriver::replayThread()
+{
+	mState = kDeviceHasIsochSync;
+	mListener.onStartup();
+
+	auto startTime = std::chrono::steady_clock::now();
+	SensorFrame frame;
+	for(size_t i = 0; (i < mFrameCount) && !mTerminating; ++i)
+	{
+		const SensorRecordingFrame& record = mpFrames[i];
+		if(mRealTime)
+		{
+			std::this_thread::sleep_until(startTime + std::chrono::nanoseconds(record.time - mpFrames[0].time));
+		}
+		std::copy(record.data, record.data + SensorGeometry::elements, frame.begin());
+		mListener.onFrame(frame);
+	}
+
+	mFinished = true;
+	mState = kDeviceUnplugged;
+	mListener.onClose();
+}
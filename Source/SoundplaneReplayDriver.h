@@ -0,0 +1,70 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <string>
+#include <stdint.h>
+
+#include "SoundplaneDriver.h"
+#include "SensorRecording.h"
+
+// SoundplaneReplayDriver: plays back a recording made by SensorFrameRecorder through the
+// same listener callbacks as the hardware driver. The file is memory mapped, so frames
+// are read in place. In real time mode frames are delivered at their recorded times,
+// otherwise back to back. A listener that drops frames when its input is full, as the
+// Model does for a device, must wait for room instead in fast mode for the replay to be
+// exact. The Model and SoundplaneInstrument do so, except that the Model's "coalesce"
+// input policy still skips frames by design.
+//
+// Carrier changes are ignored, since the recorded data can't change.
+
+class SoundplaneReplayDriver : public SoundplaneDriver
+{
+public:
+	SoundplaneReplayDriver(SoundplaneDriverListener& listener, const std::string& path, bool realTime);
+	~SoundplaneReplayDriver();
+
+	// SoundplaneDriver
+	void start() override;
+	int getDeviceState() const override;
+	uint16_t getFirmwareVersion() const override;
+	std::string getSerialNumberString() const override;
+	const Carriers& getCarriers() const override;
+	void setCarriers(const Carriers& carriers) override;
+	void enableCarriers(unsigned long mask) override;
+
+	// true if the recording was opened successfully.
+	bool isOpen() const { return mpHeader != nullptr; }
+
+	// true once every frame has been delivered.
+	bool isFinished() const { return mFinished; }
+
+	bool hasCalibration() const;
+	SensorFrame getCalibrationMean() const;
+
+	size_t getFrameCount() const { return mFrameCount; }
+	const SensorRecordingFrame& getFrameRecord(size_t i) const { return mpFrames[i]; }
+
+private:
+	void replayThread();
+	void close();
+
+	SoundplaneDriverListener& mListener;
+	const bool mRealTime;
+
+	void* mpMappedData{nullptr};
+	size_t mMappedSize{0};
+	const SensorRecordingHeader* mpHeader{nullptr};
+	const SensorRecordingFrame* mpFrames{nullptr};
+	size_t mFrameCount{0};
+	Carriers mCarriers{};
+
+	std::atomic<int> mState;
+	std::atomic<bool> mTerminating{false};
+	std::atomic<bool> mFinished{false};
+	std::thread mReplayThread;
+};
@@ -22,6 +22,7 @@ SoundplaneTouchGraphView::~SoundplaneTouchGraphView()
 
 void SoundplaneTouchGraphView::setModel(SoundplaneModel* m)
 {
+  mpTouchSubscription.reset(new TouchArrayPublisher::Subscription(m->getTouchSignal()));
   mpModel = m;
 }
 
@@ -44,8 +45,10 @@ void SoundplaneTouchGraphView::renderTouchBarGraphs()
   int viewH = getBackingLayerHeight();
   int viewScale = getRenderingScale();
 
-  const ml::Matrix& currentTouch = mpModel->getTouchFrame();
-  const ml::Matrix& touchHistory = mpModel->getTouchHistory();
+  mpTouchSubscription->update();
+  const TouchArray& currentTouch = mpTouchSubscription->get();
+  const TouchHistory& touchHistory = mpModel->getTouchHistory();
+  const uint64_t newestFrame = touchHistory.getSequence();
   const int frames = mpModel->getFloatProperty("max_touches");
   if (!frames) return;
 
@@ -92,7 +95,7 @@ void SoundplaneTouchGraphView::renderTouchBarGraphs()
     glColor4fv(indLight);
     MLRect r(0, 0, numSize, numSize);
     MLRect tr = r.translated(Vec2(margin, margin + j*frameOffset + (frameHeight - numSize)/2));
-    int age = currentTouch(ageColumn, j);
+    int age = currentTouch[j].age;
     if (age > 0)
     {
       glColor4fv(indLight);
@@ -120,7 +123,7 @@ void SoundplaneTouchGraphView::renderTouchBarGraphs()
     for(int i=fr.left() + 1; i<fr.right()-1; ++i)
     {
       int time = frameXRange(i);
-      float force = touchHistory(2, j, time);
+      float force = touchHistory.getPointAtPosition(newestFrame, time, j).z;
       force =  ml::clamp(force, 0.f, 1.f);
       float y = frameYRange.convert(force);
       // draw line
@@ -140,7 +143,7 @@ void SoundplaneTouchGraphView::renderTouchBarGraphs()
      {
      int time = frameXRange(i);
 
-     float x = touchHistory(0, j, time);
+     float x = touchHistory.getPointAtPosition(newestFrame, time, j).x;
      float y = xToYRange.convert(x);
 
      // draw line
@@ -36,6 +36,7 @@ public:
 
 private:
   SoundplaneModel* mpModel;
+  std::unique_ptr< TouchArrayPublisher::Subscription > mpTouchSubscription;
   ml::Timer mTimer;
 };
 
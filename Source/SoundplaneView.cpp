@@ -392,7 +392,7 @@ mpModel(pModel)
 	// ----
 	
 	pD = page1->addDial("touches", dialRect.withCenter(0.5, dialY), "max_touches", c2);
-	pD->setRange(0., 16., 1.);
+	pD->setRange(0., kMaxTouches, 1.);
 	pD->setDefault(4);
 	
 	pB = page1->addToggleButton("rotate", toggleRect.withCenter(1.5, dialY), "rotate", c2);
@@ -444,6 +444,8 @@ mpModel(pModel)
 	// utility buttons
 	page2->addTextButton("select carriers", MLRect(0, 2, 3, 0.4), "select_carriers");
 	page2->addTextButton("restore defaults", MLRect(0, 3., 3, 0.4), "restore_defaults");
+	page2->addTextButton("print latency", MLRect(0, 4., 3, 0.4), "print_latency");
+	page2->addTextButton("record / stop", MLRect(0, 5., 3, 0.4), "record");
 	
 	// console
 	MLDebugDisplay* pDebug = page2->addDebugDisplay(MLRect(7., 2., 7., 5.));
@@ -126,9 +126,9 @@ void SoundplaneZoneView::renderZones()
 	
 	// float strokeWidth = viewW / 100;
 	
-	for(auto it = mpModel->getZonesBegin(); it != mpModel->getZonesEnd(); ++it)
+	std::shared_ptr< const ZoneSet > pZones = mpModel->getZones();
+	for(const Zone& zone : *pZones)
 	{
-		const Zone& zone = *it;
 		
 		MLRect zr = zone.getBounds();
 		int offset = zone.getOffset();
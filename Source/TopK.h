@@ -0,0 +1,101 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2017 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// TopK: the K highest values inserted, highest first, each with an index. For the touch
+// finders, which need the strongest few of a bounded number of candidates.
+//
+// Every insertion does the same work, whatever the value and however many came before, so
+// the time for n insertions is n times a constant. Each slot keeps its value, takes the one
+// above it, or takes the new one, by masks rather than branches, so there is nothing to
+// mispredict when the values come in random order. Of equal values, the first inserted
+// stays higher.
+
+template< int K >
+class TopK
+{
+public:
+	static_assert(K % 4 == 0, "TopK size must be a multiple of 4");
+
+	TopK() { clear(); }
+	~TopK() {}
+
+	void clear()
+	{
+		for(int k = 0; k < K; ++k)
+		{
+			mZ[k] = -std::numeric_limits<float>::max();
+			mIndex[k] = -1;
+		}
+		mInserted = 0;
+	}
+
+	void insert(float z, int index)
+	{
+#if defined(__SSE2__)
+		const __m128 vz = _mm_set1_ps(z);
+		const __m128i vIndex = _mm_set1_epi32(index);
+
+		// the group above the first is taken to be infinite, so nothing shifts into slot 0.
+		__m128 aboveZ = _mm_set1_ps(std::numeric_limits<float>::infinity());
+		__m128i aboveIndex = _mm_setzero_si128();
+		for(int k = 0; k < K; k += 4)
+		{
+			const __m128 groupZ = _mm_load_ps(mZ + k);
+			const __m128i groupIndex = _mm_load_si128(reinterpret_cast<const __m128i*>(mIndex + k));
+
+			// the slot above each slot: the group moved up one lane, with the last lane of
+			// the group above in its first lane.
+			const __m128 prevZ = _mm_castsi128_ps(_mm_or_si128(_mm_slli_si128(_mm_castps_si128(groupZ), 4),
+				_mm_srli_si128(_mm_castps_si128(aboveZ), 12)));
+			const __m128i prevIndex = _mm_or_si128(_mm_slli_si128(groupIndex, 4), _mm_srli_si128(aboveIndex, 12));
+
+			const __m128 take = _mm_cmpgt_ps(vz, groupZ);
+			const __m128 shift = _mm_cmpgt_ps(vz, prevZ);
+			__m128 newZ = _mm_or_ps(_mm_and_ps(take, vz), _mm_andnot_ps(take, groupZ));
+			newZ = _mm_or_ps(_mm_and_ps(shift, prevZ), _mm_andnot_ps(shift, newZ));
+
+			const __m128i takeI = _mm_castps_si128(take);
+			const __m128i shiftI = _mm_castps_si128(shift);
+			__m128i newIndex = _mm_or_si128(_mm_and_si128(takeI, vIndex), _mm_andnot_si128(takeI, groupIndex));
+			newIndex = _mm_or_si128(_mm_and_si128(shiftI, prevIndex), _mm_andnot_si128(shiftI, newIndex));
+
+			aboveZ = groupZ;
+			aboveIndex = groupIndex;
+			_mm_store_ps(mZ + k, newZ);
+			_mm_store_si128(reinterpret_cast<__m128i*>(mIndex + k), newIndex);
+		}
+#else
+		for(int k = K - 1; k > 0; --k)
+		{
+			const bool shift = z > mZ[k - 1];
+			const bool take = z > mZ[k];
+			mIndex[k] = shift ? mIndex[k - 1] : (take ? index : mIndex[k]);
+			mZ[k] = shift ? mZ[k - 1] : (take ? z : mZ[k]);
+		}
+		const bool take = z > mZ[0];
+		mIndex[0] = take ? index : mIndex[0];
+		mZ[0] = take ? z : mZ[0];
+#endif
+		mInserted++;
+	}
+
+	// the number of values held, up to K.
+	int size() const { return (mInserted < K) ? mInserted : K; }
+
+	float getZ(int k) const { return mZ[k]; }
+	int getIndex(int k) const { return mIndex[k]; }
+
+private:
+	alignas(16) float mZ[K];
+	alignas(16) int mIndex[K];
+	int mInserted;
+};
@@ -7,7 +7,15 @@
 
 #pragma once
 
-static constexpr int kMaxTouches = 16;
+// the most touches tracked at once. Touch arrays and everything downstream of the tracker
+// are sized by this at compile time. Build with SOUNDPLANE_MAX_TOUCHES set to 32 or 64 for
+// multi-player setups.
+#ifndef SOUNDPLANE_MAX_TOUCHES
+#define SOUNDPLANE_MAX_TOUCHES 16
+#endif
+
+static constexpr int kMaxTouches = SOUNDPLANE_MAX_TOUCHES;
+static_assert((kMaxTouches == 16) || (kMaxTouches == 32) || (kMaxTouches == 64), "touch capacity must be 16, 32 or 64");
 
 enum TouchState
 {
@@ -0,0 +1,71 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2018 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <array>
+
+#include "Touch.h"
+
+// TouchFrame: one frame of touches, with each field the tracker's filters use in its own
+// aligned array, so that a filter stage can work on four touch slots at once with SIMD.
+// The fields of Touch that are set after tracking are not kept, and read back as 0.
+//
+// The tracker works on TouchFrames from matching to output. The touch finders and the
+// outputs use TouchArrays, converted with the functions below.
+
+struct TouchFrame
+{
+	static_assert(kMaxTouches % 4 == 0, "TouchFrame lanes must be a multiple of 4");
+
+	alignas(16) std::array<float, kMaxTouches> x;
+	alignas(16) std::array<float, kMaxTouches> y;
+	alignas(16) std::array<float, kMaxTouches> z;
+	alignas(16) std::array<float, kMaxTouches> dz;
+	alignas(16) std::array<int, kMaxTouches> age;
+	alignas(16) std::array<int, kMaxTouches> state;
+
+	Touch get(int i) const
+	{
+		return Touch{.x = x[i], .y = y[i], .z = z[i], .dz = dz[i], .age = age[i], .state = state[i]};
+	}
+
+	void set(int i, Touch t)
+	{
+		x[i] = t.x;
+		y[i] = t.y;
+		z[i] = t.z;
+		dz[i] = t.dz;
+		age[i] = t.age;
+		state[i] = t.state;
+	}
+
+	void clear(int i) { set(i, Touch{}); }
+
+	void clear()
+	{
+		x.fill(0.f);
+		y.fill(0.f);
+		z.fill(0.f);
+		dz.fill(0.f);
+		age.fill(0);
+		state.fill(0);
+	}
+};
+
+inline void touchArrayToFrame(const TouchArray& in, TouchFrame& out)
+{
+	for(int i = 0; i < kMaxTouches; ++i)
+	{
+		out.set(i, in[i]);
+	}
+}
+
+inline void touchFrameToArray(const TouchFrame& in, TouchArray& out)
+{
+	for(int i = 0; i < kMaxTouches; ++i)
+	{
+		out[i] = in.get(i);
+	}
+}
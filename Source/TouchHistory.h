@@ -0,0 +1,107 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+
+#include "Touch.h"
+#include "SoundplaneModelA.h"
+
+// the position, pressure and age of one touch in one frame of the history.
+struct TouchHistoryPoint
+{
+	float x{0.f};
+	float y{0.f};
+	float z{0.f};
+	int age{0};
+};
+
+// TouchHistory: the touches of the last kFrames frames, written by the process thread and
+// read by the views. This is far too big to copy through a TripleBuffer every frame, so the
+// writer fills each new frame in place in a ring and then publishes its sequence number, and
+// readers read back from the newest number they have seen. Neither side ever waits.
+//
+// The ring has kGuardFrames more frames than can be read, so a frame is only reused long
+// after it has left the readable history. A reader too slow even for that gets empty points,
+// because getPoint() checks after reading that the frame was not reused meanwhile, as the
+// reader of a seqlock does. The points are relaxed atomics, so that a read racing a write is
+// only a stale value, never undefined behaviour.
+
+class TouchHistory
+{
+public:
+	static constexpr int kFrames = kSoundplaneHistorySize;
+	static constexpr int kGuardFrames = kSoundplaneHistorySize/4;
+
+	TouchHistory() : mPoints(kCapacity*kMaxTouches) {}
+	~TouchHistory() {}
+
+	// writer: add the touches of a new frame. Only one thread may add.
+	void add(const TouchArray& touches)
+	{
+		uint64_t sequence = mSequence.load(std::memory_order_relaxed) + 1;
+
+		// a reader that sees any of the points written below also sees the last sequence
+		// stored, which tells it the slot is being reused.
+		std::atomic_thread_fence(std::memory_order_release);
+		StoredPoint* pFrame = &mPoints[(sequence % kCapacity)*kMaxTouches];
+		for(int i = 0; i < kMaxTouches; ++i)
+		{
+			const Touch& t = touches[i];
+			pFrame[i].x.store(t.x, std::memory_order_relaxed);
+			pFrame[i].y.store(t.y, std::memory_order_relaxed);
+			pFrame[i].z.store(t.z, std::memory_order_relaxed);
+			pFrame[i].age.store(t.age, std::memory_order_relaxed);
+		}
+		mSequence.store(sequence, std::memory_order_release);
+	}
+
+	// reader: the number of the newest frame, or 0 before any are added.
+	uint64_t getSequence() const { return mSequence.load(std::memory_order_acquire); }
+
+	// touch i in the frame framesAgo before the frame numbered sequence, which should come
+	// from getSequence(). Frames not in the history have empty points.
+	TouchHistoryPoint getPoint(uint64_t sequence, int framesAgo, int i) const
+	{
+		if((framesAgo < 0) || (framesAgo >= kFrames) || (framesAgo >= (int64_t)sequence)) return TouchHistoryPoint();
+		uint64_t frame = sequence - framesAgo;
+		const StoredPoint& s = mPoints[(frame % kCapacity)*kMaxTouches + i];
+		TouchHistoryPoint p;
+		p.x = s.x.load(std::memory_order_relaxed);
+		p.y = s.y.load(std::memory_order_relaxed);
+		p.z = s.z.load(std::memory_order_relaxed);
+		p.age = s.age.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		// the slot is written with frame + kCapacity while the sequence is one less than that.
+		if(mSequence.load(std::memory_order_relaxed) >= frame + kCapacity - 1) return TouchHistoryPoint();
+		return p;
+	}
+
+	// touch i at a fixed position in a ring of kFrames frames: that of the newest frame, up to
+	// the frame numbered sequence, whose number modulo kFrames is position. Drawn by position,
+	// the history wipes across in place rather than scrolling.
+	TouchHistoryPoint getPointAtPosition(uint64_t sequence, int position, int i) const
+	{
+		int framesAgo = (int)((sequence + kFrames - position) % kFrames);
+		return getPoint(sequence, framesAgo, i);
+	}
+
+private:
+	static constexpr int kCapacity = kFrames + kGuardFrames;
+
+	struct StoredPoint
+	{
+		std::atomic<float> x{0.f};
+		std::atomic<float> y{0.f};
+		std::atomic<float> z{0.f};
+		std::atomic<int> age{0};
+	};
+
+	std::vector< StoredPoint > mPoints;
+	std::atomic<uint64_t> mSequence{0};
+};
@@ -12,8 +12,21 @@
 #include <algorithm>
 
 #include "TouchTracker.h"
+#include "SensorFrameKernels.h"
+#include "TopK.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 constexpr float kTwoPi = 3.1415926535f*2.f;
 
+// these filter settings have a big and sort of delicate impact on play feel, so they are not user settable.
+// The xy cutoff goes from the min to the max frequency as z goes from 0 to kFixedXYZMax.
+constexpr float kFixedXYFreqMax = 20.f;
+constexpr float kFixedXYFreqMin = 1.f;
+constexpr float kFixedXYZMax = 0.02f;
+
 template <class c>
 inline c (clamp)(const c& x, const c& min, const c& max)
 {
@@ -27,6 +40,63 @@ inline bool (within)(const c& x, const c& min, const c& max)
 	return ((x >= min) && (x < max));
 }
 
+// gains of the alpha-beta filters that estimate touch velocities for prediction. beta is
+// the critically damped value for alpha.
+constexpr float kPredictAlpha = 0.25f;
+constexpr float kPredictBeta = kPredictAlpha*kPredictAlpha/(2.f - kPredictAlpha);
+
+// the largest change in position, in keys, from one frame to the next that prediction follows.
+constexpr float kPredictMaxJump = 0.5f;
+
+// the frames a touch started by an onset is held on, while the smoothed curvature catches up.
+constexpr int kOnsetHoldFrames = 10;
+
+// one step of an alpha-beta filter, with position p and velocity v per frame, on the
+// measurement m. Returns m moved ahead by leadFrames at the estimated velocity.
+inline float predictAlphaBeta(float m, float& p, float& v, bool start, float leadFrames)
+{
+	if(start)
+	{
+		p = m;
+		v = 0.f;
+		return m;
+	}
+	const float predicted = p + v;
+	const float r = m - predicted;
+	p = predicted + kPredictAlpha*r;
+	v += kPredictBeta*r;
+	return m + v*leadFrames;
+}
+
+// the number of touch slots to process in groups of four, to cover the first n.
+inline int roundUpToLanes(int n)
+{
+	return (n + 3) & ~3;
+}
+
+#if defined(__SSE2__)
+// a where the mask is set, b elsewhere.
+inline __m128 selectLanes(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+inline __m128i selectLanes(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+inline __m128i loadLanes(const std::array<int, kMaxTouches>& a, int i)
+{
+	return _mm_load_si128(reinterpret_cast<const __m128i*>(&a[i]));
+}
+
+inline void storeLanes(std::array<int, kMaxTouches>& a, int i, __m128i v)
+{
+	_mm_store_si128(reinterpret_cast<__m128i*>(&a[i]), v);
+}
+#endif
+
 inline float lerp(const float a, const float b, const float m)
 {
 	return(a + m*(b-a));
@@ -55,15 +125,52 @@ inline float cityBlockDistanceXYZ(Touch a, Touch b, float zScale)
 	return fabs(a.x - b.x) + fabs(a.y - b.y) + zScale*fabs(a.z - b.z);
 }
 
+// call f(start, end) for each run of set bits in b.
+template< size_t N, class F >
+inline void forEachRun(const std::bitset<N>& b, F f)
+{
+	size_t i = 0;
+	while(i < N)
+	{
+		if(!b[i])
+		{
+			++i;
+			continue;
+		}
+		size_t start = i;
+		while((i < N) && b[i]) ++i;
+		f((int)start, (int)i);
+	}
+}
+
+// set the bits next to every set bit.
+template< size_t N >
+inline std::bitset<N> dilate(const std::bitset<N>& b)
+{
+	return b | (b << 1) | (b >> 1);
+}
+
 // TouchTracker
 
-TouchTracker::TouchTracker() :
+template< class Traits >
+TouchTrackerT< Traits >::TouchTrackerT() :
 mSampleRate(1000.f),
 mMaxTouchesPerFrame(0),
 mLopassZ(50.),
 mRotate(false)
 {
 	setThresh(0.1);
+	setLopassZ(mLopassZ);
+	
+	// the xy filter coefficient at evenly spaced z, with the last repeated so that the
+	// interpolation at the end of the range stays in the table.
+	for(int i = 0; i <= kXYCoeffSteps; ++i)
+	{
+		float freq = lerp(kFixedXYFreqMin, kFixedXYFreqMax, (float)i/kXYCoeffSteps);
+		float omegaXY = freq*kTwoPi/mSampleRate;
+		mXYCoeffs[i] = expf(-omegaXY);
+	}
+	mXYCoeffs[kXYCoeffSteps + 1] = mXYCoeffs[kXYCoeffSteps];
 	
 	for(int i = 0; i < kMaxTouches; i++)
 	{
@@ -71,11 +178,13 @@ mRotate(false)
 	}
 }
 
-TouchTracker::~TouchTracker()
+template< class Traits >
+TouchTrackerT< Traits >::~TouchTrackerT()
 {
 }
 
-void TouchTracker::setMaxTouches(int t)
+template< class Traits >
+void TouchTrackerT< Traits >::setMaxTouches(int t)
 {
 	int kmax = kMaxTouches;
 	int newT = clamp(t, 0, kmax);
@@ -88,12 +197,14 @@ void TouchTracker::setMaxTouches(int t)
 		{
 			mRotateShuffleOrder[i] = i;
 		}
+		mOnsetHold.fill(0);
 		
 		mClearNextFrame = true;
 	}
 }
 
-void TouchTracker::setRotate(bool b)
+template< class Traits >
+void TouchTrackerT< Traits >::setRotate(bool b)
 {
 	mRotate = b;
 	for(int i = 0; i < kMaxTouches; i++)
@@ -102,7 +213,8 @@ void TouchTracker::setRotate(bool b)
 	}
 }
 
-void TouchTracker::clear()
+template< class Traits >
+void TouchTrackerT< Traits >::clear()
 {
 	for (int i=0; i<kMaxTouches; i++)
 	{
@@ -111,16 +223,73 @@ void TouchTracker::clear()
 }
 
 // set the threshold of curvature that will cause a touch. Note that this will not correspond with the pressure (z) values reported by touches.
-void TouchTracker::setThresh(float f)
+template< class Traits >
+void TouchTrackerT< Traits >::setThresh(float f)
 {
 	mOnThreshold = clamp(f, 0.005f, 1.f);
 	mFilterThreshold = mOnThreshold * 0.5f;
 	mOffThreshold = mOnThreshold * 0.75f;
+	mPeakMapCurrent = false;
 }
 
-void TouchTracker::setLopassZ(float k)
+template< class Traits >
+void TouchTrackerT< Traits >::setLopassZ(float k)
 {
 	mLopassZ = k;
+	
+	// the z filter rises faster than it falls.
+	const float upFreq = mLopassZ*2.f;
+	const float downFreq = mLopassZ*0.25f;
+	const float omegaUp = upFreq*kTwoPi/mSampleRate;
+	const float kUp = expf(-omegaUp);
+	mZUpA0 = 1.f - kUp;
+	mZUpB1 = kUp;
+	const float omegaDown = downFreq*kTwoPi/mSampleRate;
+	const float kDown = expf(-omegaDown);
+	mZDownA0 = 1.f - kDown;
+	mZDownB1 = kDown;
+}
+
+template< class Traits >
+void TouchTrackerT< Traits >::setOnsetThreshold(float t)
+{
+	mOnsetThreshold = std::max(t, 0.f);
+	
+	// the last frame kept may be old, so the next frame only starts the history.
+	mOnsetPrimed = false;
+	mOnsetCount = 0;
+}
+
+template< class Traits >
+void TouchTrackerT< Traits >::setPredictTime(float ms)
+{
+	float newTime = clamp(ms, 0.f, 100.f);
+	if((newTime > 0.f) && (mPredictTime == 0.f))
+	{
+		// the estimates are stale, so start again from the next frame.
+		mPredictReset = true;
+	}
+	mPredictTime = newTime;
+}
+
+template< class Traits >
+void TouchTrackerT< Traits >::setTouchFinder(TouchFinder f)
+{
+	mTouchFinder = f;
+}
+
+template< class Traits >
+void TouchTrackerT< Traits >::setTouchMatcher(TouchMatcher m)
+{
+	mTouchMatcher = m;
+}
+
+template< class Traits >
+void TouchTrackerT< Traits >::setTileThreshold(float t)
+{
+	mTileThreshold = std::max(t, 0.f);
+	mTileFraction = 1.f;
+	mAllTilesDirty = true;
 }
 
 SensorFrame smoothPressureX(const SensorFrame& in)
@@ -201,36 +370,154 @@ SensorFrame smoothPressureY(const SensorFrame& in)
 }
 
 
-SensorFrame TouchTracker::preprocess(const SensorFrame& in)
+// the gain is the inverse of the mean, so that calibrating a frame is a multiply.
+template< class Traits >
+void TouchTrackerT< Traits >::setCalibration(const Frame& mean)
 {
-	SensorFrame y;
-	
-	// fixed IIR filter input
-	float k = 0.25f;
-	y = multiply(in, k);
-	mInputZ1 = multiply(mInputZ1, 1.0 - k);
-	y = add(y, mInputZ1);
-	mInputZ1 = y;
-	
-	// filter out any negative values. negative values can show up from capacitive coupling near edges,
-	// from motion or bending of the whole instrument,
+	for(int n = 0; n < Traits::width*Traits::height; ++n)
+	{
+		mCalibrateGain[n] = 1.f/mean[n];
+	}
+}
+
+template< class Traits >
+const typename Traits::Frame& TouchTrackerT< Traits >::preprocess(const Frame& in)
+{
+	// fixed IIR filter input, then filter out any negative values. negative values can show up
+	// from capacitive coupling near edges, from motion or bending of the whole instrument,
 	// from the elastic layer deforming and pushing up on the sensors near a touch.
-	y = max(y, 0.f);
-	
+	//
 	// a lot of filtering is needed here for Soundplane A to make sure peaks are in centers of touches.
-	// it also reduces noise.
+	// it also reduces noise. The number of passes in each direction is set by the traits.
 	// the down side is, contiguous touches are harder to tell apart. a smart blob-shape algorithm
 	// can make up for this later, with this filtering still intact.
-	y = smoothPressureX(smoothPressureX(smoothPressureX(smoothPressureX(y))));
-	y = smoothPressureY(smoothPressureY(smoothPressureY(y)));
-	y = getCurvatureXY(multiply(y, 1.f/64.f));
+	//
+	// all of this is done in one pass, which gives the same result as smoothPressureX() and
+	// smoothPressureY() done the given number of times. See SensorFrameKernels.h.
+	if(mOnsetThreshold > 0.f)
+	{
+		detectOnsets(in);
+	}
+	if(mTileThreshold > 0.f)
+	{
+		return preprocessTiles(in);
+	}
+	SensorFrameKernels::fastest::calibrateAndSmoothPressure< Traits::width, Traits::height, Traits::smoothPassesX, Traits::smoothPassesY >
+		(in, nullptr, nullptr, mInputZ1, 0.25f, mSmoothed);
+	Traits::getCurvature(mSmoothed, mCurvature);
+	mPeakColumns.set();
 	
-	return y;
+	return mCurvature;
+}
+
+// the same as preprocess(subtract(multiply(raw, gain), 1.0f)), without the extra passes.
+template< class Traits >
+const typename Traits::Frame& TouchTrackerT< Traits >::preprocessRaw(const Frame& raw, Frame* pCalibrated)
+{
+	const bool onsets = (mOnsetThreshold > 0.f);
+	if(mTileThreshold > 0.f)
+	{
+		Frame& calibrated = pCalibrated ? *pCalibrated : mCalibrated;
+		SensorFrameKernels::fastest::calibrate< Traits::width, Traits::height >(raw, mCalibrateGain, calibrated);
+		if(onsets)
+		{
+			detectOnsets(calibrated);
+		}
+		return preprocessTiles(calibrated);
+	}
+	
+	// onsets are found after the pass, from the calibrated input it writes.
+	Frame* pCalibratedOut = (onsets && !pCalibrated) ? &mCalibrated : pCalibrated;
+	SensorFrameKernels::fastest::calibrateAndSmoothPressure< Traits::width, Traits::height, Traits::smoothPassesX, Traits::smoothPassesY >
+		(raw, &mCalibrateGain, pCalibratedOut, mInputZ1, 0.25f, mSmoothed);
+	if(onsets)
+	{
+		detectOnsets(*pCalibratedOut);
+	}
+	Traits::getCurvature(mSmoothed, mCurvature);
+	mPeakColumns.set();
+	
+	return mCurvature;
+}
+
+// preprocess() for a mostly idle surface. A tile is dirty if its input has moved more than
+// the tile threshold from the filtered input. Only dirty tiles are filtered, and only the
+// columns they can reach are smoothed again and scanned for peaks. The filter state of a
+// quiet tile is held, so its input can drift by up to the threshold before it is dirty.
+//
+// The curvature is made for the whole frame if any tile is dirty.
+template< class Traits >
+const typename Traits::Frame& TouchTrackerT< Traits >::preprocessTiles(const Frame& in)
+{
+	constexpr int w = Traits::width;
+	constexpr int h = Traits::height;
+	constexpr int tw = Traits::tileWidth;
+	const float k = 0.25f;
+	const float k1 = 1.f - k;
+	
+	const ColumnMask moved = SensorFrameKernels::fastest::getChangedColumns< Traits::width, Traits::height >(in, mInputZ1, mTileThreshold);
+	const ColumnMask tileMask = (ColumnMask().set() >> (w - tw));
+	ColumnMask changed;
+	int dirtyTiles = 0;
+	for(int t = 0; t < kTiles; ++t)
+	{
+		const int i0 = t*tw;
+		if(mAllTilesDirty || (moved & (tileMask << i0)).any())
+		{
+			for(int j = 0; j < h; ++j)
+			{
+				for(int i = i0; i < i0 + tw; ++i)
+				{
+					const int n = j*w + i;
+					float y = in[n]*k + mInputZ1[n]*k1;
+					mInputZ1[n] = y;
+					mClipped[n] = std::max(y, 0.f);
+				}
+			}
+			for(int i = i0; i < i0 + tw; ++i)
+			{
+				changed.set(i);
+			}
+			dirtyTiles++;
+		}
+	}
+	mAllTilesDirty = false;
+	mTileFraction = static_cast<float>(dirtyTiles)/kTiles;
+	
+	// the smoothed columns that the changed ones reach, in whole groups of four for the kernels.
+	ColumnMask smoothColumns = changed;
+	for(int p = 0; p < Traits::smoothPassesX; ++p)
+	{
+		smoothColumns = dilate(smoothColumns);
+	}
+	for(int i = 0; i < w; i += 4)
+	{
+		bool any = false;
+		for(int g = i; g < std::min(i + 4, w); ++g) any |= smoothColumns[g];
+		for(int g = i; g < std::min(i + 4, w); ++g) smoothColumns[g] = any;
+	}
+	
+	forEachRun(smoothColumns, [&](int c0, int c1)
+	{
+		SensorFrameKernels::fastest::smoothPressureColumns< Traits::width, Traits::height, Traits::smoothPassesX, Traits::smoothPassesY >
+			(mClipped, c0, c1, mSmoothed);
+	});
+	
+	if(smoothColumns.any())
+	{
+		Traits::getCurvature(mSmoothed, mCurvature);
+	}
+	
+	// curvature and then peaks each reach one column further.
+	mPeakColumns = dilate(dilate(smoothColumns));
+	
+	return mCurvature;
 }
 
 // to clear the next frame, all touch z values must be set to 0 and states to kTouchStateOff
 // so that the frame is guaranteed to be sent.
-void TouchTracker::clearAndSendNextFrameIfNeeded()
+template< class Traits >
+void TouchTrackerT< Traits >::clearAndSendNextFrameIfNeeded()
 {
 	if(mClearNextFrame)
 	{
@@ -243,47 +530,100 @@ void TouchTracker::clearAndSendNextFrameIfNeeded()
 	}
 }
 
-TouchArray TouchTracker::process(const SensorFrame& in, int maxTouches)
+// set any touches past the maximum to zero, as the stages that write whole arrays do.
+template< class Traits >
+void TouchTrackerT< Traits >::clearUnusedTouches(TouchArray& t)
+{
+	for(int i = mMaxTouchesPerFrame; i < kMaxTouches; ++i)
+	{
+		t[i] = Touch{};
+	}
+}
+
+template< class Traits >
+void TouchTrackerT< Traits >::clearUnusedTouches(TouchFrame& t)
+{
+	for(int i = mMaxTouchesPerFrame; i < kMaxTouches; ++i)
+	{
+		t.clear(i);
+	}
+}
+
+template< class Traits >
+const TouchArray& TouchTrackerT< Traits >::process(const Frame& in, int maxTouches)
 {
 	setMaxTouches(maxTouches);
 	
-	mTouches = TouchArray{};
-	
 	if(mMaxTouchesPerFrame > 0)
 	{
-		mTouches = findTouches(in);
+		TouchFrame& touchesMatch1 = mTouchesMatch[mMatchIdx];
+		TouchFrame& touchesMatch = mTouchesMatch[mMatchIdx ^ 1];
+		TouchFrame& touchesZ1 = mTouchesZ[mZIdx];
+		TouchFrame& touchesZ = mTouchesZ[mZIdx ^ 1];
+		
+		if(mTouchFinder == kFindBlobs)
+		{
+			findTouchesBlobs(in, mFound);
+		}
+		else
+		{
+			findTouches(in, mFound);
+		}
+		if(mOnsetThreshold > 0.f)
+		{
+			addOnsetTouches(mFound);
+		}
 		
 		// match -> position filter -> feedback
-		mTouches = matchTouches(mTouches, mTouchesMatch1);
-		mTouches = filterTouchesXYAdaptive(mTouches, mTouchesMatch1);
-		mTouchesMatch1 = mTouches;
+		if(mTouchMatcher == kMatchOptimal)
+		{
+			matchTouchesOptimal(mFound, touchesMatch1, touchesMatch);
+		}
+		else
+		{
+			matchTouches(mFound, touchesMatch1, touchesMatch);
+		}
 		
-		// asymmetrical z filter from user setting. Ages are created here.
-		mTouches = filterTouchesZ(mTouches, mTouches2, mLopassZ*2.f, mLopassZ*0.25f);
-		mTouches2 = mTouches;
+		// position filter -> asymmetrical z filter from user setting, where ages are created ->
+		// exile decayed touches so they are not matched. Note this affects match feedback!
+		filterTouches(touchesMatch, touchesMatch1, touchesZ1, touchesZ);
 		
-		// after variable filter, exile decayed touches so they are not matched. Note this affects match feedback!
-		mTouchesMatch1 = exileUnusedTouches(mTouchesMatch1, mTouches);
+		// this frame's touches are the history for the next.
+		mMatchIdx ^= 1;
+		mZIdx ^= 1;
 		
 		// TODO hysteresis after matching to prevent glitching when there are more
 		// physical touches than mMaxTouchesPerFrame and touches are stolen
 		
-		if(mRotate)
+		// optional prediction, before rotation so that each slot keeps its history.
+		const TouchFrame* pOut = &touchesZ;
+		if(mPredictTime > 0.f)
 		{
-			mTouches = rotateTouches(mTouches);
+			predictTouches(*pOut, mPredicted);
+			pOut = &mPredicted;
 		}
 		
-		mTouches = clampAndScaleTouches(mTouches);
+		if(mRotate)
+		{
+			rotateTouches(*pOut, mTouchesOut);
+			pOut = &mTouchesOut;
+		}
+		clampAndScaleTouches(*pOut, mTouches);
+	}
+	else
+	{
+		mTouches.fill(Touch{});
 	}
 	clearAndSendNextFrameIfNeeded();
 	return mTouches;
 }
 
-Touch correctPeakX(Touch pos, const SensorFrame& in)
+template< class Traits >
+Touch correctPeakX(Touch pos, const typename Traits::Frame& in)
 {
 	Touch newPos = pos;
 	const float maxCorrect = 0.5f;
-	const int w = SensorGeometry::width;
+	constexpr int w = Traits::width;
 	int x = pos.x;
 	int y = pos.y;
 	
@@ -300,11 +640,12 @@ Touch correctPeakX(Touch pos, const SensorFrame& in)
 	return newPos;
 }
 
-Touch correctPeakY(Touch pos, const SensorFrame& in)
+template< class Traits >
+Touch correctPeakY(Touch pos, const typename Traits::Frame& in)
 {
 	const float maxCorrect = 0.5f;
-	const int w = SensorGeometry::width;
-	const int h = SensorGeometry::height;
+	constexpr int w = Traits::width;
+	constexpr int h = Traits::height;
 	int x = pos.x;
 	int y = pos.y;
 	
@@ -332,16 +673,14 @@ Touch correctPeakY(Touch pos, const SensorFrame& in)
 	return Touch{.x = pos.x, .y = fy, .z = pos.z};
 }
 
+template< class Traits >
 float sensorToKeyY(float sy)
 {
 	float ky = 0.f;
 	
-	constexpr int mapSize = 6;
-	
-	// Soundplane A as measured.
-	// NOTE: these y locations depend on the amount of smoothing done in smoothPressureX / smoothPressureY.
-	constexpr std::array<float, mapSize> sensorMap{{0.7, 1.2, 2.7, 4.3, 5.8, 6.3}};
-	constexpr std::array<float, mapSize> keyMap{{0.01, 1., 2., 3., 4., 4.99}};
+	constexpr int mapSize = Traits::yMapSize;
+	const auto& sensorMap = Traits::sensorYMap;
+	const auto& keyMap = Traits::keyYMap;
 	
 	if(sy < sensorMap[0])
 	{
@@ -369,111 +708,341 @@ float sensorToKeyY(float sy)
 	return ky;
 }
 
+template< class Traits >
 Touch peakToTouch(Touch p)
 {
-	return Touch{.x = mapRange(3.5f, 59.5f, 1.f, 29.f, p.x), .y = sensorToKeyY(p.y), .z = p.z};
+	return Touch{.x = mapRange(Traits::sensorMinX, Traits::sensorMaxX, Traits::keyMinX, Traits::keyMaxX, p.x),
+		.y = sensorToKeyY< Traits >(p.y), .z = p.z};
+}
+
+// find where the calibrated input rises by more than the onset threshold in one frame, at
+// taxels that rise more than their neighbors. The strongest are kept in mOnsets.
+template< class Traits >
+void TouchTrackerT< Traits >::detectOnsets(const Frame& in)
+{
+	constexpr int w = Traits::width;
+	constexpr int h = Traits::height;
+	
+	mOnsetCount = 0;
+	if(!mOnsetPrimed)
+	{
+		mOnsetZ1 = in;
+		mOnsetPrimed = true;
+		return;
+	}
+	
+	auto rise = [&](int i, int j) { return in[j*w + i] - mOnsetZ1[j*w + i]; };
+	TopK< kMaxTouches > strongest;
+	for(int j = 0; j < h; ++j)
+	{
+		for(int i = 0; i < w; ++i)
+		{
+			const float r = rise(i, j);
+			if(r > mOnsetThreshold)
+			{
+				if(((i == 0) || (r >= rise(i - 1, j))) && ((i == w - 1) || (r > rise(i + 1, j))) &&
+					((j == 0) || (r >= rise(i, j - 1))) && ((j == h - 1) || (r > rise(i, j + 1))))
+				{
+					strongest.insert(r, j*w + i);
+				}
+			}
+		}
+	}
+	mOnsetZ1 = in;
+	
+	mOnsetCount = strongest.size();
+	for(int n = 0; n < mOnsetCount; ++n)
+	{
+		const int k = strongest.getIndex(n);
+		const Touch t = peakToTouch< Traits >(Touch{.x = float(k%w), .y = float(k/w)});
+		mOnsets[n] = Touch{.x = t.x, .y = t.y, .z = strongest.getZ(n)};
+	}
+}
+
+// arm the found touch at each onset, marking it with the rise in dz, or add one if there
+// is none there yet. Added touches are at the on threshold, where the tracker looks for them.
+template< class Traits >
+void TouchTrackerT< Traits >::addOnsetTouches(TouchArray& found)
+{
+	const float kMaxOnsetDist = 1.f;
+	
+	for(int n = 0; n < mOnsetCount; ++n)
+	{
+		const Touch onset = mOnsets[n];
+		int nearest = -1;
+		int free = -1;
+		float minDist = kMaxOnsetDist;
+		for(int i = 0; i < mMaxTouchesPerFrame; ++i)
+		{
+			if(found[i].z > mFilterThreshold)
+			{
+				const float d = cityBlockDistanceXYZ(found[i], onset, 0.f);
+				if(d < minDist)
+				{
+					minDist = d;
+					nearest = i;
+				}
+			}
+			else if(free < 0)
+			{
+				free = i;
+			}
+		}
+		
+		if(nearest >= 0)
+		{
+			found[nearest].dz = std::max(found[nearest].dz, onset.z);
+		}
+		else if(free >= 0)
+		{
+			found[free] = Touch{.x = onset.x, .y = onset.y, .z = mOnThreshold, .dz = onset.z};
+		}
+	}
 }
 
 // quick touch finder based on peaks of curvature.
 // this works well, but a different approach based on blob sizes / shapes could do a much better
 // job with contiguous keys.
-TouchArray TouchTracker::findTouches(const SensorFrame& in)
+// the map of peaks is kept. When in is the curvature made by preprocess(), only the columns it
+// changed are scanned again.
+template< class Traits >
+void TouchTrackerT< Traits >::findTouches(const Frame& in, TouchArray& touches)
 {
-	constexpr int kMaxPeaks = kMaxTouches*2;
-	constexpr int w = SensorGeometry::width;
-	constexpr int h = SensorGeometry::height;
-	const float* pIn = in.data();
-	int i, j;
+	constexpr int w = Traits::width;
+	constexpr int h = Traits::height;
+	
+	touches.fill(Touch{});
+	auto& map = mPeakMap;
+	
+	const bool fromCurvature = (&in == &mCurvature);
+	const ColumnMask columns = (fromCurvature && mPeakMapCurrent) ? mPeakColumns : ColumnMask().set();
+	mPeakMapCurrent = fromCurvature;
+	
+	// get peaks, in groups of four columns.
+	forEachRun(columns, [&](int c0, int c1)
+	{
+		SensorFrameKernels::fastest::findPeaks< w, h >(in, mFilterThreshold, c0 & ~3, std::min(w, (c1 + 3) & ~3), map);
+	});
+	
+	// keep the strongest peaks. There can't be more than kMaxPeaks, but the count is also
+	// checked here so that the loop is bounded whatever the map holds.
+	TopK< kMaxTouches > strongest;
+	int nPeaks = 0;
+	for(int j = 0; j < h; ++j)
+	{
+		for(int k = 0; k < (int)map[j].size(); ++k)
+		{
+			uint64_t bits = map[j][k];
+			while(bits && (nPeaks < kMaxPeaks))
+			{
+				const int i = k*64 + __builtin_ctzll(bits);
+				bits &= bits - 1;
+				strongest.insert(in[j*w + i], j*w + i);
+				nPeaks++;
+			}
+		}
+	}
+	
+	// correct and clip
+	for(int n = 0; n < strongest.size(); ++n)
+	{
+		const int idx = strongest.getIndex(n);
+		Touch p{.x = static_cast<float>(idx % w), .y = static_cast<float>(idx / w), .z = strongest.getZ(n)};
+		Touch px = correctPeakX< Traits >(p, in);
+		Touch pxy = correctPeakY< Traits >(px, in);
+		touches[n] = peakToTouch< Traits >(pxy);
+	}
+}
+
+// runs of set bits in the rows of a mask, joined with the runs they overlap in the row above
+// (4-connected) into regions, using union-find.
+template< int w, int h >
+struct RunLabels
+{
+	struct Run
+	{
+		int row;
+		int start;
+		int end;
+	};
 	
-	std::array<Touch, kMaxPeaks> peaks;
-	TouchArray touches{};
-	std::array<std::bitset<w>, h> map;
+	// the most runs possible, with every other sensor set.
+	static constexpr int kMaxRuns = h*((w + 1)/2);
 	
-	// get peaks
-	float f11, f12, f13;
-	float f21, f22, f23;
-	float f31, f32, f33;
+	std::array<Run, kMaxRuns> runs;
+	std::array<int, kMaxRuns> parent;
+	int nRuns;
 	
-	j = 0;
+	int root(int r)
 	{
-		auto& row = map[j];
-		const float* pRow2 = pIn + (j)*w;
-		const float* pRow3 = pIn + (j + 1)*w;
-		for(i = 1; i < w - 1; ++i)
+		while(parent[r] != r)
 		{
-			f21 = pRow2[i - 1]; f22 = pRow2[i]; f23 = pRow2[i + 1];
-			f31 = pRow3[i - 1]; f32 = pRow3[i]; f33 = pRow3[1 + 1];
-			row[i] = (f22 > f21) && (f22 > mFilterThreshold) && (f22 > f23)
-			&& (f22 > f31) && (f22 > f32) && (f22 > f33);
+			parent[r] = parent[parent[r]];
+			r = parent[r];
 		}
+		return r;
 	}
 	
-	for (j = 1; j < h - 1; ++j)
+	void label(const std::array<std::bitset<w>, h>& mask)
 	{
-		auto& row = map[j];
-		const float* pRow1 = pIn + (j - 1)*w;
-		const float* pRow2 = pIn + (j)*w;
-		const float* pRow3 = pIn + (j + 1)*w;
-		for(i = 1; i < w - 1; ++i)
+		nRuns = 0;
+		int prevStart = 0;
+		for(int j = 0; j < h; ++j)
 		{
-			f11 = pRow1[i - 1]; f12 = pRow1[i]; f13 = pRow1[i + 1];
-			f21 = pRow2[i - 1]; f22 = pRow2[i]; f23 = pRow2[i + 1];
-			f31 = pRow3[i - 1]; f32 = pRow3[i]; f33 = pRow3[1 + 1];
-			row[i] = (f22 > f11) && (f22 > f12) && (f22 > f13)
-			&& (f22 > f21) && (f22 > mFilterThreshold) && (f22 > f23)
-			&& (f22 > f31) && (f22 > f32) && (f22 > f33);
+			const int rowStart = nRuns;
+			forEachRun(mask[j], [&](int start, int end)
+			{
+				runs[nRuns] = Run{j, start, end};
+				parent[nRuns] = nRuns;
+				nRuns++;
+			});
+			
+			int a = prevStart;
+			int b = rowStart;
+			while((a < rowStart) && (b < nRuns))
+			{
+				if(runs[a].end <= runs[b].start)
+				{
+					a++;
+				}
+				else if(runs[b].end <= runs[a].start)
+				{
+					b++;
+				}
+				else
+				{
+					int ra = root(a);
+					int rb = root(b);
+					if(ra != rb)
+					{
+						parent[std::max(ra, rb)] = std::min(ra, rb);
+					}
+					if(runs[a].end < runs[b].end) a++; else b++;
+				}
+			}
+			prevStart = rowStart;
 		}
 	}
+};
+
+// touch finder based on blobs: connected regions of the curvature over the filter threshold.
+// touches close together make one blob, since the curvature between them stays over the
+// threshold, so each blob is labeled again keeping only its core: the sensors over
+// kBlobCoreRatio of its maximum. Each core makes one touch at the centroid, weighted by
+// curvature, of its highest sensor and that sensor's neighbors, with the z of its highest sensor.
+// unlike the peak finder, a flat top with equal neighbors still makes a touch.
+// the time taken is linear in the number of sensors, and all storage is on the stack.
+template< class Traits >
+void TouchTrackerT< Traits >::findTouchesBlobs(const Frame& in, TouchArray& touches)
+{
+	constexpr int w = Traits::width;
+	constexpr int h = Traits::height;
+	constexpr float kBlobCoreRatio = 0.8f;
+	typedef RunLabels<w, h> Labels;
+	
+	struct Blob
+	{
+		float maxZ;
+		int maxX;
+		int maxY;
+	};
 	
-	j = h - 1;
+	Labels blobLabels, coreLabels;
+	std::array<ColumnMask, h> mask;
+	std::array<Blob, Labels::kMaxRuns> blobs;
+	std::array<Touch, Labels::kMaxRuns> found;
+	
+	touches.fill(Touch{});
+	
+	// blobs over the filter threshold, and the maximum of each.
+	for(int j = 0; j < h; ++j)
 	{
-		auto& row = map[j];
-		const float* pRow1 = pIn + (j - 1)*w;
-		const float* pRow2 = pIn + (j)*w;
-		for(i = 1; i < w - 1; ++i)
+		const float* pRow = in.data() + j*w;
+		for(int i = 0; i < w; ++i)
 		{
-			f11 = pRow1[i - 1]; f12 = pRow1[i]; f13 = pRow1[i + 1];
-			f21 = pRow2[i - 1]; f22 = pRow2[i]; f23 = pRow2[i + 1];
-			row[i] = (f22 > f11) && (f22 > f12) && (f22 > f13)
-			&& (f22 > f21) && (f22 > mFilterThreshold) && (f22 > f23);
+			mask[j][i] = (pRow[i] > mFilterThreshold);
 		}
 	}
+	blobLabels.label(mask);
 	
-	// gather all peaks.
-	int nPeaks = 0;
-	for (int j=0; j<h; j++)
+	for(int r = 0; r < blobLabels.nRuns; ++r)
 	{
-		auto& mapRow = map[j];
-		for (int i=0; i < w; i++)
+		blobs[r] = Blob{0.f, 0, 0};
+	}
+	for(int r = 0; r < blobLabels.nRuns; ++r)
+	{
+		Blob& b = blobs[blobLabels.root(r)];
+		const auto& run = blobLabels.runs[r];
+		for(int i = run.start; i < run.end; ++i)
 		{
-			// if peak
-			if (mapRow[i])
+			b.maxZ = std::max(b.maxZ, in[run.row*w + i]);
+		}
+	}
+	
+	// the core of each blob.
+	for(int j = 0; j < h; ++j)
+	{
+		mask[j].reset();
+	}
+	for(int r = 0; r < blobLabels.nRuns; ++r)
+	{
+		const auto& run = blobLabels.runs[r];
+		const float coreThreshold = blobs[blobLabels.root(r)].maxZ*kBlobCoreRatio;
+		for(int i = run.start; i < run.end; ++i)
+		{
+			mask[run.row][i] = (in[run.row*w + i] >= coreThreshold);
+		}
+	}
+	coreLabels.label(mask);
+	
+	// the highest sensor of each core.
+	for(int r = 0; r < coreLabels.nRuns; ++r)
+	{
+		blobs[r] = Blob{0.f, 0, 0};
+	}
+	for(int r = 0; r < coreLabels.nRuns; ++r)
+	{
+		Blob& b = blobs[coreLabels.root(r)];
+		const auto& run = coreLabels.runs[r];
+		for(int i = run.start; i < run.end; ++i)
+		{
+			float z = in[run.row*w + i];
+			if(z > b.maxZ)
 			{
-				float z = in[j*w + i];
-				peaks[nPeaks++] = Touch{.x = static_cast<float>(i), .y = static_cast<float>(j), .z = z};
-				if (nPeaks >= kMaxPeaks) break;
+				b = Blob{z, i, run.row};
 			}
 		}
 	}
 	
-	if(nPeaks > 1)
+	// keep the strongest.
+	TopK< kMaxTouches > strongest;
+	int nBlobs = 0;
+	for(int r = 0; r < coreLabels.nRuns; ++r)
 	{
-		std::sort(peaks.begin(), peaks.begin() + nPeaks, [](Touch a, Touch b){ return a.z > b.z; } );
+		if(coreLabels.parent[r] == r)
+		{
+			const Blob& b = blobs[r];
+			float sumZ = 0.f, sumXZ = 0.f, sumYZ = 0.f;
+			for(int j = std::max(b.maxY - 1, 0); j <= std::min(b.maxY + 1, h - 1); ++j)
+			{
+				for(int i = std::max(b.maxX - 1, 0); i <= std::min(b.maxX + 1, w - 1); ++i)
+				{
+					float z = in[j*w + i];
+					sumZ += z;
+					sumXZ += i*z;
+					sumYZ += j*z;
+				}
+			}
+			found[nBlobs] = Touch{.x = sumXZ/sumZ, .y = sumYZ/sumZ, .z = b.maxZ};
+			strongest.insert(b.maxZ, nBlobs);
+			nBlobs++;
+		}
 	}
 	
-	// correct and clip
-	int nTouches = std::min(nPeaks, (int)kMaxTouches);
-	for(int i=0; i<nTouches; ++i)
+	for(int n = 0; n < strongest.size(); ++n)
 	{
-		Touch p = peaks[i];
-		if(p.z < mFilterThreshold) break;
-		
-		Touch px = correctPeakX(p, in);
-		Touch pxy = correctPeakY(px, in);
-		touches[i] = peakToTouch(pxy);
+		touches[n] = peakToTouch< Traits >(found[strongest.getIndex(n)]);
 	}
-	
-	return touches;
 }
 
 // match incoming touches in x with previous frame of touches in x1.
@@ -483,11 +1052,12 @@ TouchArray TouchTracker::findTouches(const SensorFrame& in)
 
 // TODO first touch below filter threshold(?) is on one index, then active touch switches index?! investigate.
 
-TouchArray TouchTracker::matchTouches(const TouchArray& x, const TouchArray& x1)
+template< class Traits >
+void TouchTrackerT< Traits >::matchTouches(const TouchArray& x, const TouchFrame& x1, TouchFrame& newTouches)
 {
 	const float kMaxConnectDist = 2.f;
 	
-	TouchArray newTouches{};
+	newTouches.clear();
 	
 	std::array<int, kMaxTouches> forwardMatchIdx;
 	forwardMatchIdx.fill(-1);
@@ -499,7 +1069,7 @@ TouchArray TouchTracker::matchTouches(const TouchArray& x, const TouchArray& x1)
 	for(int i=0; i<mMaxTouchesPerFrame; ++i)
 	{
 		float minDist = MAXFLOAT;
-		Touch prev = x1[i];
+		Touch prev = x1.get(i);
 		
 		for(int j=0; j < mMaxTouchesPerFrame; ++j)
 		{
@@ -523,7 +1093,7 @@ TouchArray TouchTracker::matchTouches(const TouchArray& x, const TouchArray& x1)
 		Touch curr = x[i];
 		for(int j=0; j < mMaxTouchesPerFrame; ++j)
 		{
-			Touch prev = x1[j];
+			Touch prev = x1.get(j);
 			if((curr.z > mFilterThreshold) && (prev.z > mFilterThreshold))
 			{
 				float distToPreviousTouch = cityBlockDistanceXYZ(prev, curr, 20.f);
@@ -561,11 +1131,11 @@ TouchArray TouchTracker::matchTouches(const TouchArray& x, const TouchArray& x1)
 		{
 			int j = reverseMatchIdx[i];
 			Touch curr = x[i];
-			Touch prev = x1[j];
+			Touch prev = x1.get(j);
 			{
 				// touch is continued, mark as connected and write to new touches
 				curr.age = (cityBlockDistanceXYZ(prev, curr, 0.f) < kMaxConnectDist);
-				newTouches[j] = curr;
+				newTouches.set(j, curr);
 				currWrittenToNew[i] = true;
 			}
 		}
@@ -581,7 +1151,7 @@ TouchArray TouchTracker::matchTouches(const TouchArray& x, const TouchArray& x1)
 			float minDist = MAXFLOAT;
 			
 			// first, try to match same touch index (important for decay!)
-			Touch prev = x1[i];
+			Touch prev = x1.get(i);
 			if(prev.z <= mFilterThreshold)
 			{
 				freeIdx = i;
@@ -592,7 +1162,7 @@ TouchArray TouchTracker::matchTouches(const TouchArray& x, const TouchArray& x1)
 			{
 				for(int j=0; j<mMaxTouchesPerFrame; ++j)
 				{
-					Touch prev = x1[j];
+					Touch prev = x1.get(j);
 					if(prev.z <= mFilterThreshold)
 					{
 						float d = cityBlockDistanceXYZ(curr, prev, 0.f);
@@ -608,168 +1178,311 @@ TouchArray TouchTracker::matchTouches(const TouchArray& x, const TouchArray& x1)
 			// if a free index was found, write the current touch
 			if(freeIdx >= 0)
 			{
-				Touch free = x1[freeIdx];
+				Touch free = x1.get(freeIdx);
 				curr.age = (cityBlockDistanceXYZ(free, curr, 0.f) < kMaxConnectDist);
-				newTouches[freeIdx] = curr;
+				newTouches.set(freeIdx, curr);
 			}
 		}
 	}
 	
-	// fill in any free touches with previous touches at those indices. This will allow old touches to re-link if not reused.
-	for(int i=0; i < mMaxTouchesPerFrame; ++i)
+	keepFreeSlotPositions(x1, newTouches);
+}
+
+// match by solving the assignment of current touches to slots exactly. Continuing a touch
+// costs its distance from the previous touch in the slot, with z weighted as in
+// matchTouches(). Starting a touch in a free slot costs kNewTouchCost plus its distance from
+// the last position in the slot, so that a touch lifted and put down again nearby gets its
+// old slot back. So a touch is only continued by a new one that is closer than a new touch
+// would cost, and a pair of touches near each other can't trade slots as they can when each
+// is matched greedily.
+template< class Traits >
+void TouchTrackerT< Traits >::matchTouchesOptimal(const TouchArray& x, const TouchFrame& x1, TouchFrame& newTouches)
+{
+	const float kMaxConnectDist = 2.f;
+	const float kNewTouchCost = 4.f;
+	const int n = mMaxTouchesPerFrame;
+	
+	newTouches.clear();
+	
+	// the active current touches are the rows, and all the slots are the columns.
+	std::array<int, kMaxTouches> rowTouch;
+	int rows = 0;
+	for(int i = 0; i < n; ++i)
 	{
-		Touch t = newTouches[i];
-		if(t.z <= mFilterThreshold)
+		if(x[i].z > mFilterThreshold)
 		{
-			newTouches[i].x = (x1[i].x);
-			newTouches[i].y = (x1[i].y);
+			rowTouch[rows++] = i;
 		}
 	}
 	
-	return newTouches;
+	MinCostAssignment< kMaxTouches >& assignment = mAssignment;
+	for(int r = 0; r < rows; ++r)
+	{
+		Touch curr = x[rowTouch[r]];
+		for(int j = 0; j < n; ++j)
+		{
+			Touch prev = x1.get(j);
+			assignment.cost(r, j) = (prev.z > mFilterThreshold) ? cityBlockDistanceXYZ(prev, curr, 20.f) :
+				kNewTouchCost + cityBlockDistanceXYZ(prev, curr, 0.f);
+		}
+	}
+	
+	std::array<int, kMaxTouches> slots;
+	assignment.solve(rows, n, slots);
+	for(int r = 0; r < rows; ++r)
+	{
+		Touch curr = x[rowTouch[r]];
+		const int j = slots[r];
+		curr.age = (cityBlockDistanceXYZ(x1.get(j), curr, 0.f) < kMaxConnectDist);
+		newTouches.set(j, curr);
+	}
+	
+	keepFreeSlotPositions(x1, newTouches);
 }
 
-// input: vec4<x, y, z, k> where k is 1 if the touch is connected to the previous touch at the same index.
-//
-TouchArray TouchTracker::filterTouchesXYAdaptive(const TouchArray& in, const TouchArray& inz1)
+// fill in any free touches with previous touches at those indices. This will allow old touches to re-link if not reused.
+template< class Traits >
+void TouchTrackerT< Traits >::keepFreeSlotPositions(const TouchFrame& x1, TouchFrame& newTouches)
+{
+	for(int i=0; i < mMaxTouchesPerFrame; ++i)
+	{
+		if(newTouches.z[i] <= mFilterThreshold)
+		{
+			newTouches.x[i] = (x1.x[i]);
+			newTouches.y[i] = (x1.y[i]);
+		}
+	}
+}
+
+// the filter bank, in one pass over groups of four touch slots: the adaptive xy filter on the
+// matched touches, the z filter, and exiling of the touches that have decayed.
+template< class Traits >
+void TouchTrackerT< Traits >::filterTouches(TouchFrame& touches, const TouchFrame& touches1, const TouchFrame& touchesZ1, TouchFrame& touchesZ)
 {
-	// these filter settings have a big and sort of delicate impact on play feel, so they are not user settable
-	const float kFixedXYFreqMax = 20.f;
-	const float kFixedXYFreqMin = 1.f;
+	const int n = roundUpToLanes(mMaxTouchesPerFrame);
+	for(int i = 0; i < n; i += 4)
+	{
+		filterTouchesXYLanes(i, touches, touches1);
+		filterTouchesZLanes(i, touches, touchesZ1, touchesZ);
+		exileUnusedTouchesLanes(i, touches, touchesZ);
+	}
+	clearUnusedTouches(touchesZ);
+}
+
+template< class Traits >
+void TouchTrackerT< Traits >::filterTouchesXYAdaptive(TouchFrame& touches, const TouchFrame& inz1)
+{
+	const int n = roundUpToLanes(mMaxTouchesPerFrame);
+	for(int i = 0; i < n; i += 4)
+	{
+		filterTouchesXYLanes(i, touches, inz1);
+	}
+}
+
+template< class Traits >
+void TouchTrackerT< Traits >::filterTouchesZ(const TouchFrame& in, const TouchFrame& inz1, TouchFrame& out)
+{
+	const int n = roundUpToLanes(mMaxTouchesPerFrame);
+	for(int i = 0; i < n; i += 4)
+	{
+		filterTouchesZLanes(i, in, inz1, out);
+	}
+	clearUnusedTouches(out);
+}
+
+template< class Traits >
+void TouchTrackerT< Traits >::exileUnusedTouches(TouchFrame& preFiltered, const TouchFrame& postFiltered)
+{
+	const int n = roundUpToLanes(mMaxTouchesPerFrame);
+	for(int i = 0; i < n; i += 4)
+	{
+		exileUnusedTouchesLanes(i, preFiltered, postFiltered);
+	}
+}
+
+// filter the positions of the four touches from i that continue from the previous frame, with
+// a cutoff that rises with pressure. Touches that are new or free are not filtered.
+template< class Traits >
+inline void TouchTrackerT< Traits >::filterTouchesXYLanes(int i, TouchFrame& touches, const TouchFrame& inz1)
+{
+	// the position of each z in the coefficient table. NaN goes to the start.
+	const float zToStep = kXYCoeffSteps/kFixedXYZMax;
+#if defined(__SSE2__)
+	const __m128i zeroI = _mm_setzero_si128();
+	const __m128 filter = _mm_castsi128_ps(_mm_cmpgt_epi32(loadLanes(touches.age, i), zeroI));
+	__m128 step = _mm_mul_ps(_mm_load_ps(&touches.z[i]), _mm_set1_ps(zToStep));
+	step = _mm_min_ps(_mm_max_ps(step, _mm_setzero_ps()), _mm_set1_ps((float)kXYCoeffSteps));
+	const __m128i index = _mm_cvttps_epi32(step);
+	const __m128 frac = _mm_sub_ps(step, _mm_cvtepi32_ps(index));
 	
-	TouchArray out{};
+	alignas(16) int idx[4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(idx), index);
+	const __m128 k0 = _mm_setr_ps(mXYCoeffs[idx[0]], mXYCoeffs[idx[1]], mXYCoeffs[idx[2]], mXYCoeffs[idx[3]]);
+	const __m128 k1 = _mm_setr_ps(mXYCoeffs[idx[0] + 1], mXYCoeffs[idx[1] + 1], mXYCoeffs[idx[2] + 1], mXYCoeffs[idx[3] + 1]);
+	const __m128 b1 = _mm_add_ps(k0, _mm_mul_ps(frac, _mm_sub_ps(k1, k0)));
+	const __m128 a0 = _mm_sub_ps(_mm_set1_ps(1.f), b1);
 	
-	for(int i=0; i<mMaxTouchesPerFrame; ++i)
+	// onepole filters
+	const __m128 x = _mm_load_ps(&touches.x[i]);
+	const __m128 y = _mm_load_ps(&touches.y[i]);
+	const __m128 newX = _mm_add_ps(_mm_mul_ps(x, a0), _mm_mul_ps(_mm_load_ps(&inz1.x[i]), b1));
+	const __m128 newY = _mm_add_ps(_mm_mul_ps(y, a0), _mm_mul_ps(_mm_load_ps(&inz1.y[i]), b1));
+	_mm_store_ps(&touches.x[i], selectLanes(filter, newX, x));
+	_mm_store_ps(&touches.y[i], selectLanes(filter, newY, y));
+#else
+	for(int j = i; j < i + 4; ++j)
 	{
-		float x = in[i].x;
-		float y = in[i].y;
-		float z = in[i].z;
-		int age = in[i].age;
-		
-		float x1 = inz1[i].x;
-		float y1 = inz1[i].y;
-		
-		// filter, or not, based on w from matchTouches
-		float newX, newY;
-		if(age > 0)
-		{
-			// get xy coeffs, adaptive based on z
-			float freq = mapAndClipRange(0., 0.02, kFixedXYFreqMin, kFixedXYFreqMax, z);
-			float omegaXY = freq*kTwoPi/mSampleRate;
-			float kXY = expf(-omegaXY);
-			float a0XY = 1.f - kXY;
-			float b1XY = kXY;
+		if(touches.age[j] > 0)
+		{
+			float step = touches.z[j]*zToStep;
+			step = (step > 0.f) ? std::min(step, (float)kXYCoeffSteps) : 0.f;
+			int index = step;
+			float b1 = lerp(mXYCoeffs[index], mXYCoeffs[index + 1], step - index);
+			float a0 = 1.f - b1;
 			
 			// onepole filters
-			newX = (x*a0XY) + (x1*b1XY);
-			newY = (y*a0XY) + (y1*b1XY);
-		}
-		else
-		{
-			newX = x;
-			newY = y;
+			touches.x[j] = (touches.x[j]*a0) + (inz1.x[j]*b1);
+			touches.y[j] = (touches.y[j]*a0) + (inz1.y[j]*b1);
 		}
-		
-		out[i] = Touch{.x = newX, .y = newY, .z = z, .age = age};
 	}
-	
-	return out;
+#endif
 }
 
-TouchArray TouchTracker::filterTouchesZ(const TouchArray& in, const TouchArray& inz1, float upFreq, float downFreq)
+// the asymmetrical z filter from the user setting, with the gate that makes ages and states,
+// for the four touches from i.
+template< class Traits >
+inline void TouchTrackerT< Traits >::filterTouchesZLanes(int i, const TouchFrame& in, const TouchFrame& inz1, TouchFrame& out)
 {
-	const float omegaUp = upFreq*kTwoPi/mSampleRate;
-	const float kUp = expf(-omegaUp);
-	const float a0Up = 1.f - kUp;
-	const float b1Up = kUp;
-	const float omegaDown = downFreq*kTwoPi/mSampleRate;
-	const float kDown = expf(-omegaDown);
-	const float a0Down = 1.f - kDown;
-	const float b1Down = kDown;
+#if defined(__SSE2__)
+	const __m128i zeroI = _mm_setzero_si128();
+	const __m128 z = _mm_load_ps(&in.z[i]);
+	const __m128 z1 = _mm_load_ps(&inz1.z[i]);
+	const __m128i age1 = loadLanes(inz1.age, i);
 	
-	TouchArray out{};
+	// filter z variable
+	const __m128 dz = _mm_sub_ps(z, z1);
+	const __m128 up = _mm_cmpgt_ps(dz, _mm_setzero_ps());
+	const __m128 zUp = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(mZUpA0)), _mm_mul_ps(z1, _mm_set1_ps(mZUpB1)));
+	const __m128 zDown = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(mZDownA0)), _mm_mul_ps(z1, _mm_set1_ps(mZDownB1)));
+	const __m128 newZ = selectLanes(up, zUp, zDown);
 	
-	for(int i=0; i<mMaxTouchesPerFrame; ++i)
+	// gate with hysteresis. A touch armed by an onset starts at once, and is held on while
+	// its hold lasts.
+	const __m128i gate1 = _mm_cmpgt_epi32(age1, zeroI);
+	const __m128i start = _mm_andnot_si128(gate1, _mm_castps_si128(_mm_cmpgt_ps(_mm_load_ps(&in.dz[i]), _mm_setzero_ps())));
+	const __m128i hold = loadLanes(mOnsetHold, i);
+	const __m128i holding = _mm_cmpgt_epi32(hold, zeroI);
+	const __m128i on = _mm_or_si128(start, _mm_castps_si128(_mm_cmpgt_ps(newZ, _mm_set1_ps(mOnThreshold))));
+	const __m128i off = _mm_andnot_si128(holding, _mm_castps_si128(_mm_cmplt_ps(newZ, _mm_set1_ps(mOffThreshold))));
+	const __m128i newGate = _mm_or_si128(on, _mm_andnot_si128(off, gate1));
+	const __m128i newHold = selectLanes(start, _mm_set1_epi32(kOnsetHoldFrames),
+		_mm_and_si128(_mm_and_si128(newGate, holding), _mm_sub_epi32(hold, _mm_set1_epi32(1))));
+	
+	// the velocity of a touch started by an onset is at least the rise.
+	const __m128 newDz = selectLanes(_mm_castsi128_ps(start), _mm_max_ps(dz, _mm_load_ps(&in.dz[i])), dz);
+	
+	// increment age, and set state
+	const __m128i newAge = _mm_and_si128(newGate, _mm_add_epi32(age1, _mm_set1_epi32(1)));
+	const __m128i newState = selectLanes(newGate,
+		selectLanes(gate1, _mm_set1_epi32(kTouchStateContinue), _mm_set1_epi32(kTouchStateOn)),
+		selectLanes(gate1, _mm_set1_epi32(kTouchStateOff), _mm_set1_epi32(kTouchStateInactive)));
+	
+	_mm_store_ps(&out.x[i], _mm_load_ps(&in.x[i]));
+	_mm_store_ps(&out.y[i], _mm_load_ps(&in.y[i]));
+	_mm_store_ps(&out.z[i], newZ);
+	_mm_store_ps(&out.dz[i], newDz);
+	storeLanes(out.age, i, newAge);
+	storeLanes(out.state, i, newState);
+	storeLanes(mOnsetHold, i, newHold);
+#else
+	for(int j = i; j < i + 4; ++j)
 	{
-		float x = in[i].x;
-		float y = in[i].y;
-		float z = in[i].z;
-		
-		float z1 = inz1[i].z;
-		int age1 = inz1[i].age;
-		
-		float newZ;
+		float z = in.z[j];
+		float z1 = inz1.z[j];
+		int age1 = inz1.age[j];
 		
 		// filter z variable
 		float dz = z - z1;
-		if(dz > 0.f)
-		{
-			newZ = (z*a0Up) + (z1*b1Up);
-		}
-		else
-		{
-			newZ = (z*a0Down) + (z1*b1Down);
-		}
+		float newZ = (dz > 0.f) ? ((z*mZUpA0) + (z1*mZUpB1)) : ((z*mZDownA0) + (z1*mZDownB1));
 		
-		// gate with hysteresis
+		// gate with hysteresis. A touch armed by an onset starts at once, and is held on while
+		// its hold lasts.
 		bool gate1 = (age1 > 0);
-		bool newGate = gate1;
-		if(newZ > mOnThreshold)
-		{
-			newGate = true;
-		}
-		else if (newZ < mOffThreshold)
-		{
-			newGate = false;
-		}
-		
-		// increment age
-		int newAge = newGate ? (age1 + 1) : 0;
+		bool start = !gate1 && (in.dz[j] > 0.f);
+		bool holding = (mOnsetHold[j] > 0);
+		bool newGate = start || (newZ > mOnThreshold) || (gate1 && (holding || !(newZ < mOffThreshold)));
+		mOnsetHold[j] = start ? kOnsetHoldFrames : ((newGate && holding) ? (mOnsetHold[j] - 1) : 0);
 		
-		// set state
-		int newState = newGate ? (gate1 ? kTouchStateContinue : kTouchStateOn) : (gate1 ? kTouchStateOff : kTouchStateInactive);
-		
-		out[i] = Touch{.x=x, .y=y, .z=newZ, .dz=dz, .age=newAge, .state=newState};
+		out.x[j] = in.x[j];
+		out.y[j] = in.y[j];
+		out.z[j] = newZ;
+		out.dz[j] = start ? std::max(dz, in.dz[j]) : dz;
+		out.age[j] = newGate ? (age1 + 1) : 0;
+		out.state[j] = newGate ? (gate1 ? kTouchStateContinue : kTouchStateOn) : (gate1 ? kTouchStateOff : kTouchStateInactive);
 	}
-	
-	return out;
+#endif
 }
 
 // if a touch has decayed below the filter threshold after z filtering, move it off the scene so it won't match to other nearby touches.
-TouchArray TouchTracker::exileUnusedTouches(const TouchArray& preFiltered, const TouchArray& postFiltered)
+template< class Traits >
+inline void TouchTrackerT< Traits >::exileUnusedTouchesLanes(int i, TouchFrame& preFiltered, const TouchFrame& postFiltered)
 {
-	TouchArray out(preFiltered);
-	for(int i = 0; i < mMaxTouchesPerFrame; ++i)
+#if defined(__SSE2__)
+	const __m128 held = _mm_castsi128_ps(_mm_cmpgt_epi32(loadLanes(mOnsetHold, i), _mm_setzero_si128()));
+	const __m128 exile = _mm_andnot_ps(held, _mm_and_ps(_mm_cmpgt_ps(_mm_load_ps(&postFiltered.x[i]), _mm_setzero_ps()),
+		_mm_cmple_ps(_mm_load_ps(&postFiltered.z[i]), _mm_set1_ps(mFilterThreshold))));
+	_mm_store_ps(&preFiltered.x[i], selectLanes(exile, _mm_set1_ps(-1.f), _mm_load_ps(&preFiltered.x[i])));
+	_mm_store_ps(&preFiltered.y[i], selectLanes(exile, _mm_set1_ps(-10.f), _mm_load_ps(&preFiltered.y[i])));
+	_mm_store_ps(&preFiltered.z[i], _mm_andnot_ps(exile, _mm_load_ps(&preFiltered.z[i])));
+#else
+	for(int j = i; j < i + 4; ++j)
 	{
-		Touch a = preFiltered[i];
-		Touch b = postFiltered[i];
-		
-		if(b.x > 0.f)
+		if((postFiltered.x[j] > 0.f) && (postFiltered.z[j] <= mFilterThreshold) && (mOnsetHold[j] <= 0))
 		{
-			if(b.z <= mFilterThreshold)
-			{
-				a.x = (-1.f);
-				a.y = (-10.f);
-				a.z = (0.f);
-			}
+			preFiltered.x[j] = (-1.f);
+			preFiltered.y[j] = (-10.f);
+			preFiltered.z[j] = (0.f);
 		}
-		
-		out[i] = a;
 	}
-	return out;
+#endif
+}
+
+// extrapolate each touch ahead by the predict time, from its filtered position and pressure
+// and a velocity estimated from them by an alpha-beta filter. New touches start still.
+template< class Traits >
+void TouchTrackerT< Traits >::predictTouches(const TouchFrame& in, TouchFrame& out)
+{
+	const float leadFrames = mPredictTime*0.001f*mSampleRate;
+	out = in;
+	for(int i = 0; i < mMaxTouchesPerFrame; ++i)
+	{
+		// a touch that jumps further than a finger can move in a frame has been matched to
+		// another finger, and starts again.
+		const bool jump = (fabsf(in.x[i] - (mPredictPosition.x[i] + mPredictVelocity.x[i])) > kPredictMaxJump) ||
+			(fabsf(in.y[i] - (mPredictPosition.y[i] + mPredictVelocity.y[i])) > kPredictMaxJump);
+		const bool start = mPredictReset || (in.age[i] <= 1) || jump;
+		out.x[i] = predictAlphaBeta(in.x[i], mPredictPosition.x[i], mPredictVelocity.x[i], start, leadFrames);
+		out.y[i] = predictAlphaBeta(in.y[i], mPredictPosition.y[i], mPredictVelocity.y[i], start, leadFrames);
+		out.z[i] = predictAlphaBeta(in.z[i], mPredictPosition.z[i], mPredictVelocity.z[i], start, leadFrames);
+	}
+	mPredictReset = false;
 }
 
 // rotate order of touches, changing order every time there is a new touch in a frame.
 // side effect: writes to mRotateShuffleOrder
-TouchArray TouchTracker::rotateTouches(const TouchArray& in)
+template< class Traits >
+void TouchTrackerT< Traits >::rotateTouches(const TouchFrame& in, TouchFrame& touches)
 {
-	TouchArray touches(in);
-	if(mMaxTouchesPerFrame > 1)
+	if(mMaxTouchesPerFrame <= 1)
+	{
+		touches = in;
+	}
+	else
 	{
 		bool doRotate = false;
 		for(int i = 0; i < mMaxTouchesPerFrame; ++i)
 		{
-			if(in[i].age == 1)
+			if(in.age[i] == 1)
 			{
 				// we have a new touch at index i.
 				doRotate = true;
@@ -785,7 +1498,7 @@ TouchArray TouchTracker::rotateTouches(const TouchArray& in)
 			
 			for(int i=0; i<mMaxTouchesPerFrame; ++i)
 			{
-				if((in[i].z < mFilterThreshold) || (in[i].age == 1))
+				if((in.z[i] < mFilterThreshold) || (in.age[i] == 1))
 				{
 					freeIndexes[nFree++] = i;
 				}
@@ -805,43 +1518,63 @@ TouchArray TouchTracker::rotateTouches(const TouchArray& in)
 		// shuffle
 		for(int i = 0; i < mMaxTouchesPerFrame; ++i)
 		{
-			touches[mRotateShuffleOrder[i]] = in[i];
+			touches.set(mRotateShuffleOrder[i], in.get(i));
+		}
+		for(int i = mMaxTouchesPerFrame; i < kMaxTouches; ++i)
+		{
+			touches.set(i, in.get(i));
 		}
 	}
-	return touches;
 }
 
-TouchArray TouchTracker::clampAndScaleTouches(const TouchArray& in)
+template< class Traits >
+void TouchTrackerT< Traits >::clampAndScaleTouches(const TouchFrame& in, TouchArray& out)
 {
 	const float kTouchOutputScale = 4.f;
-	TouchArray out{};
-	for(int i = 0; i < mMaxTouchesPerFrame; ++i)
+	const int n = roundUpToLanes(mMaxTouchesPerFrame);
+	
+	// positions that are NaN are set to 0, and the pressure of inactive touches to 0.
+	alignas(16) std::array<float, kMaxTouches> x;
+	alignas(16) std::array<float, kMaxTouches> y;
+	alignas(16) std::array<float, kMaxTouches> z;
+#if defined(__SSE2__)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 maxZ = _mm_set1_ps(8.f);
+	const __m128 onThreshold = _mm_set1_ps(mOnThreshold);
+	const __m128 scale = _mm_set1_ps(kTouchOutputScale);
+	for(int i = 0; i < n; i += 4)
 	{
-		Touch t = in[i];
+		const __m128 vx = _mm_load_ps(&in.x[i]);
+		const __m128 vy = _mm_load_ps(&in.y[i]);
+		_mm_store_ps(&x[i], _mm_and_ps(_mm_cmpeq_ps(vx, vx), vx));
+		_mm_store_ps(&y[i], _mm_and_ps(_mm_cmpeq_ps(vy, vy), vy));
 		
-		if(t.x != t.x)
-		{
-			t.x = (0.f);
-		}
-		if(t.y != t.y)
-		{
-			t.y = (0.f);
-		}
-		
-		out[i] = t;
-		float newZ = (clamp((t.z - mOnThreshold)*kTouchOutputScale, 0.f, 8.f));
-		if(t.age == 0)
-		{
-			newZ = 0.f;
-		}
-		out[i].z = (newZ);
+		// clamp in the order that keeps NaN and -0 as clamp() does.
+		const __m128 scaled = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&in.z[i]), onThreshold), scale);
+		const __m128 newZ = _mm_min_ps(maxZ, _mm_max_ps(zero, scaled));
+		const __m128 inactive = _mm_castsi128_ps(_mm_cmpeq_epi32(loadLanes(in.age, i), _mm_setzero_si128()));
+		_mm_store_ps(&z[i], _mm_andnot_ps(inactive, newZ));
 	}
-	return out;
+#else
+	for(int i = 0; i < n; ++i)
+	{
+		x[i] = (in.x[i] != in.x[i]) ? 0.f : in.x[i];
+		y[i] = (in.y[i] != in.y[i]) ? 0.f : in.y[i];
+		z[i] = (in.age[i] == 0) ? 0.f : clamp((in.z[i] - mOnThreshold)*kTouchOutputScale, 0.f, 8.f);
+	}
+#endif
+	for(int i = 0; i < mMaxTouchesPerFrame; ++i)
+	{
+		out[i] = Touch{.x = x[i], .y = y[i], .z = z[i], .dz = in.dz[i], .age = in.age[i], .state = in.state[i]};
+	}
+	clearUnusedTouches(out);
 }
 
-TouchArray TouchTracker::getTestTouches(time_point<system_clock> now, int maxTouches)
+template< class Traits >
+const TouchArray& TouchTrackerT< Traits >::getTestTouches(time_point<system_clock> now, int maxTouches)
 {
-	TouchArray t{};
+	TouchArray& t = mFound;
+	t.fill(Touch{});
 
 	setMaxTouches(maxTouches);
 	
@@ -870,15 +1603,115 @@ TouchArray TouchTracker::getTestTouches(time_point<system_clock> now, int maxTou
 		t[i] = Touch{.x = x, .y = y, .z = amp};
 	}
 	
-	mTouches = t;
 	// asymmetrical z filter from user setting. Ages are created here.
-	mTouches = filterTouchesZ(mTouches, mTouches2, mLopassZ*2.f, mLopassZ*0.25f);
-	mTouches2 = mTouches;
-	mTouches = clampAndScaleTouches(mTouches);
+	touchArrayToFrame(t, mTouchesOut);
+	TouchFrame& touchesZ = mTouchesZ[mZIdx ^ 1];
+	filterTouchesZ(mTouchesOut, mTouchesZ[mZIdx], touchesZ);
+	mZIdx ^= 1;
+	clampAndScaleTouches(touchesZ, mTouches);
 	
 	clearAndSendNextFrameIfNeeded();
 	return mTouches;
 }
 
+// --------------------------------------------------------------------------------
+#pragma mark instantiations
+
+constexpr int SoundplaneATrackerTraits::width;
+constexpr int SoundplaneATrackerTraits::height;
+constexpr int SoundplaneATrackerTraits::smoothPassesX;
+constexpr int SoundplaneATrackerTraits::smoothPassesY;
+constexpr float SoundplaneATrackerTraits::sensorMinX;
+constexpr float SoundplaneATrackerTraits::sensorMaxX;
+constexpr float SoundplaneATrackerTraits::keyMinX;
+constexpr float SoundplaneATrackerTraits::keyMaxX;
+constexpr int SoundplaneATrackerTraits::yMapSize;
+constexpr std::array<float, SoundplaneATrackerTraits::yMapSize> SoundplaneATrackerTraits::sensorYMap;
+constexpr std::array<float, SoundplaneATrackerTraits::yMapSize> SoundplaneATrackerTraits::keyYMap;
+
+void SoundplaneATrackerTraits::getCurvature(const Frame& in, Frame& out) { getCurvatureXYInto(in, out); }
+
+template class TouchTrackerT< SoundplaneATrackerTraits >;
 
+// --------------------------------------------------------------------------------
+#pragma mark output scaling
 
+// c over [0 - 1] fades response from sqrt(x) -> x -> x^2
+//
+float responseCurve(float x, float c)
+{
+	float y;
+	if(c < 0.5f)
+	{
+		y = lerp(x*x, x, c*2.f);
+	}
+	else
+	{
+		y = lerp(x, sqrtf(x), c*2.f - 1.f);
+	}
+	return y;
+}
+
+#if defined(__SSE2__)
+inline __m128 responseCurve(__m128 x, float c)
+{
+	__m128 y;
+	if(c < 0.5f)
+	{
+		const __m128 xx = _mm_mul_ps(x, x);
+		y = _mm_add_ps(xx, _mm_mul_ps(_mm_set1_ps(c*2.f), _mm_sub_ps(x, xx)));
+	}
+	else
+	{
+		y = _mm_add_ps(x, _mm_mul_ps(_mm_set1_ps(c*2.f - 1.f), _mm_sub_ps(_mm_sqrt_ps(x), x)));
+	}
+	return y;
+}
+#endif
+
+TouchArray scaleTouchPressure(const TouchArray& in, float zscale, float zcurve)
+{
+	TouchArray out = in;
+	
+	const float dzScale = 0.125f;
+	
+	alignas(16) std::array<float, kMaxTouches> z;
+	alignas(16) std::array<float, kMaxTouches> dz;
+	for(int i=0; i<kMaxTouches; ++i)
+	{
+		z[i] = in[i].z;
+		dz[i] = in[i].dz;
+	}
+	
+#if defined(__SSE2__)
+	// clamp in the order that keeps NaN and -0 as clamp() does.
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 vZScale = _mm_set1_ps(zscale);
+	for(int i=0; i<kMaxTouches; i += 4)
+	{
+		__m128 vz = _mm_mul_ps(_mm_load_ps(&z[i]), vZScale);
+		vz = _mm_min_ps(_mm_set1_ps(4.f), _mm_max_ps(zero, vz));
+		_mm_store_ps(&z[i], responseCurve(vz, zcurve));
+		
+		// for note-ons, use same z scale controls as pressure
+		__m128 vdz = _mm_mul_ps(_mm_mul_ps(_mm_load_ps(&dz[i]), _mm_set1_ps(dzScale)), vZScale);
+		vdz = _mm_min_ps(_mm_set1_ps(1.f), _mm_max_ps(zero, vdz));
+		_mm_store_ps(&dz[i], responseCurve(vdz, zcurve));
+	}
+#else
+	for(int i=0; i<kMaxTouches; ++i)
+	{
+		z[i] = responseCurve(clamp(z[i]*zscale, 0.f, 4.f), zcurve);
+		
+		// for note-ons, use same z scale controls as pressure
+		dz[i] = responseCurve(clamp(dz[i]*dzScale*zscale, 0.f, 1.f), zcurve);
+	}
+#endif
+	
+	for(int i=0; i<kMaxTouches; ++i)
+	{
+		out[i].z = z[i];
+		out[i].dz = dz[i];
+	}
+	return out;
+}
@@ -5,61 +5,207 @@
 
 #pragma once
 
+#include <bitset>
+
 #include "SensorFrame.h"
 #include "Touch.h"
+#include "TouchTrackerTraits.h"
+#include "SensorFrameKernels.h"
+#include "MinCostAssignment.h"
+#include "TouchFrame.h"
 
 using namespace std::chrono;
 
-class TouchTracker
+// scale the pressure of tracked touches for output, then apply a response curve.
+// zCurve over [0 - 1] fades response from sqrt(x) -> x -> x^2.
+TouchArray scaleTouchPressure(const TouchArray& in, float zScale, float zCurve);
+
+// box filters used by preprocess(): sums of each sensor and its neighbors in x or y.
+SensorFrame smoothPressureX(const SensorFrame& in);
+SensorFrame smoothPressureY(const SensorFrame& in);
+
+// how the tracker finds touches in the curvature.
+enum TouchFinder
+{
+	// local maxima, corrected to positions between sensors. The default.
+	kFindPeaks = 0,
+	
+	// regions of connected sensors over the filter threshold, each at its weighted centroid.
+	kFindBlobs
+};
+
+// how the tracker matches the touches found with those of the previous frame.
+enum TouchMatcher
 {
+	// mutual nearest neighbors, then the remaining touches to the nearest free slots. The default.
+	kMatchNearest = 0,
+	
+	// the assignment with the lowest total distance, including the cost of starting touches.
+	kMatchOptimal
+};
+
+// the tracker for one kind of surface, described by Traits. See TouchTrackerTraits.h.
+template< class Traits >
+class TouchTrackerT
+{
+	// benchmarks time the stages of process() separately.
+	friend class TouchTrackerBenchmark;
+	
 public:
 	
-	TouchTracker();
-	~TouchTracker();
+	typedef typename Traits::Frame Frame;
+	
+	TouchTrackerT();
+	~TouchTrackerT();
 	
 	void clear();
 	void setRotate(bool b);
 	void setThresh(float f);
 	void setLopassZ(float k);
+	void setTouchFinder(TouchFinder f);
+	void setTouchMatcher(TouchMatcher m);
+	
+	// set how far ahead in ms to extrapolate the position and pressure of each touch, to
+	// make up for the lag of the filters and the rest of the pipeline. 0 turns prediction off.
+	void setPredictTime(float ms);
 	
-	// preprocess input to get curvature
-	SensorFrame preprocess(const SensorFrame& in);
+	// set the change in calibrated input below which a tile of the surface is not processed
+	// again, and its previous results are used. 0 turns tiles off, so the whole surface is
+	// processed every frame. The smoothing gains about 30 times, so the curvature of a skipped
+	// tile can be off by up to about 30 times the threshold.
+	void setTileThreshold(float t);
 	
-	// process input and get touches. returns one frame of touch data. changes history of many filters.
-	TouchArray process(const SensorFrame& in, int maxTouches);
+	// the fraction of tiles processed by the last preprocess().
+	float getTileFraction() const { return mTileFraction; }
 	
-	TouchArray getTestTouches(time_point<system_clock> t, int maxTouches);
+	// set the rise in calibrated pressure at one taxel in one frame that starts a touch at
+	// once, before the smoothed curvature reaches the threshold. The touch goes out at the
+	// taxel and is moved by the tracker as usual from then on. 0 turns onset detection off.
+	void setOnsetThreshold(float t);
+	
+	// set the mean sensor values at rest, used by preprocessRaw() to calibrate its input.
+	void setCalibration(const Frame& mean);
+	
+	// preprocess calibrated input to get curvature. The result is kept in the tracker until the next call.
+	const Frame& preprocess(const Frame& in);
+	
+	// calibrate raw input, then preprocess it, in the same pass. If pCalibrated is not null, the
+	// calibrated input is also written there.
+	const Frame& preprocessRaw(const Frame& raw, Frame* pCalibrated = nullptr);
+	
+	// process input and get touches. returns one frame of touch data, kept in the tracker
+	// until the next call. changes history of many filters.
+	// the time taken has a fixed bound: all the stages loop over fixed-size arrays, and no
+	// more than kMaxPeaks peaks are looked at, each in constant time. So the whole surface
+	// pressed at once costs about what a few touches do. soundplane-bench times the worst case.
+	const TouchArray& process(const Frame& in, int maxTouches);
+	
+	const TouchArray& getTestTouches(time_point<system_clock> t, int maxTouches);
 	
 private:
 	
+	static_assert(Traits::width % Traits::tileWidth == 0, "tiles must fit the surface");
+	static constexpr int kTiles = Traits::width/Traits::tileWidth;
+	typedef std::bitset<Traits::width> ColumnMask;
+	
+	// a peak is higher than all its neighbors, so no two peaks are next to each other, and
+	// the first and last columns have none. This is the most the surface can have.
+	static constexpr int kMaxPeaks = ((Traits::width - 1)/2)*((Traits::height + 1)/2);
+	
 	float mSampleRate;
 	int mMaxTouchesPerFrame;
 	bool mClearNextFrame{false};
 	float mLopassZ;
 	bool mRotate;
 	
+	// coefficients of the one pole filters, made when their frequencies are set. The xy
+	// feedback coefficient is at kXYCoeffSteps + 1 evenly spaced values of z, and interpolated.
+	static constexpr int kXYCoeffSteps = 64;
+	std::array<float, kXYCoeffSteps + 2> mXYCoeffs;
+	float mZUpA0;
+	float mZUpB1;
+	float mZDownA0;
+	float mZDownB1;
+	
+	TouchFinder mTouchFinder{kFindPeaks};
+	TouchMatcher mTouchMatcher{kMatchNearest};
+	
 	float mFilterThreshold;
 	float mOnThreshold;
 	float mOffThreshold;
 	
-	SensorFrame mInput{};
-	SensorFrame mInputZ1{};
+	// workspace. Every stage writes into one of these, so a frame makes no temporary
+	// frames or touch arrays. Filter histories are ping-pong pairs: [mMatchIdx] and [mZIdx]
+	// hold the previous frame, and the other of each pair is written with the new one.
+	alignas(16) Frame mCalibrateGain{};
+	Frame mInputZ1{};
+	Frame mSmoothed{};
+	Frame mCurvature{};
+	
+	// tiles. mClipped is the filtered and clipped input, kept for the tiles that are skipped.
+	// mPeakMap is kept in the same way, and the columns in mPeakColumns are found again.
+	float mTileThreshold{0.f};
+	float mTileFraction{1.f};
+	bool mAllTilesDirty{true};
+	bool mPeakMapCurrent{false};
+	Frame mCalibrated{};
+	Frame mClipped{};
+	ColumnMask mPeakColumns;
+	SensorFrameKernels::PeakMap<Traits::width, Traits::height> mPeakMap{};
+	
+	TouchArray mFound{};
+	std::array<TouchFrame, 2> mTouchesMatch{};
+	std::array<TouchFrame, 2> mTouchesZ{};
+	int mMatchIdx{0};
+	int mZIdx{0};
+	
+	// the touches after z filtering and rotation, or the test touches before filtering.
+	TouchFrame mTouchesOut{};
+	
+	// onset detection: the calibrated input of the last frame, and the onsets found in it
+	// with z the rise. A slot started by an onset is held on for mOnsetHold[i] more frames
+	// while the curvature catches up.
+	float mOnsetThreshold{0.f};
+	bool mOnsetPrimed{false};
+	Frame mOnsetZ1{};
+	TouchArray mOnsets{};
+	int mOnsetCount{0};
+	alignas(16) std::array<int, kMaxTouches> mOnsetHold{};
 	
+	// the touches after prediction, and the alpha-beta filter states of each slot.
+	float mPredictTime{0.f};
+	bool mPredictReset{true};
+	TouchFrame mPredicted{};
+	TouchFrame mPredictPosition{};
+	TouchFrame mPredictVelocity{};
 	TouchArray mTouches{};
-	TouchArray mTouchesMatch1{};
-	TouchArray mTouches2{};
+	MinCostAssignment< kMaxTouches > mAssignment;
 	
 	std::array<int, kMaxTouches> mRotateShuffleOrder;
 	
 	void clearAndSendNextFrameIfNeeded();
 	void setMaxTouches(int t);
-	TouchArray findTouches(const SensorFrame& in);
-	TouchArray rotateTouches(const TouchArray& t);
-	TouchArray matchTouches(const TouchArray& x, const TouchArray& x1);
-	TouchArray filterTouchesXYAdaptive(const TouchArray& x, const TouchArray& x1);
-	TouchArray filterTouchesZ(const TouchArray& x, const TouchArray& x1, float upFreq, float downFreq);
-	TouchArray exileUnusedTouches(const TouchArray& x1, const TouchArray& x2);
-	TouchArray clampAndScaleTouches(const TouchArray& x);
+	void clearUnusedTouches(TouchArray& t);
+	void clearUnusedTouches(TouchFrame& t);
+	const Frame& preprocessTiles(const Frame& in);
+	void detectOnsets(const Frame& calibrated);
+	void addOnsetTouches(TouchArray& found);
+	void findTouches(const Frame& in, TouchArray& out);
+	void findTouchesBlobs(const Frame& in, TouchArray& out);
+	void rotateTouches(const TouchFrame& in, TouchFrame& out);
+	void matchTouches(const TouchArray& x, const TouchFrame& x1, TouchFrame& out);
+	void matchTouchesOptimal(const TouchArray& x, const TouchFrame& x1, TouchFrame& out);
+	void keepFreeSlotPositions(const TouchFrame& x1, TouchFrame& out);
+	void filterTouches(TouchFrame& x, const TouchFrame& x1, const TouchFrame& z1, TouchFrame& zOut);
+	void filterTouchesXYAdaptive(TouchFrame& x, const TouchFrame& x1);
+	void filterTouchesZ(const TouchFrame& x, const TouchFrame& x1, TouchFrame& out);
+	void exileUnusedTouches(TouchFrame& x1, const TouchFrame& x2);
+	void filterTouchesXYLanes(int i, TouchFrame& x, const TouchFrame& x1);
+	void filterTouchesZLanes(int i, const TouchFrame& x, const TouchFrame& x1, TouchFrame& out);
+	void exileUnusedTouchesLanes(int i, TouchFrame& x1, const TouchFrame& x2);
+	void predictTouches(const TouchFrame& x, TouchFrame& out);
+	void clampAndScaleTouches(const TouchFrame& x, TouchArray& out);
 	void outputTouches(TouchArray touches);
 };
 
+typedef TouchTrackerT< SoundplaneATrackerTraits > TouchTracker;
@@ -0,0 +1,47 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2017 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <array>
+
+#include "SensorFrame.h"
+
+// the geometry of a surface and how its sensors map to keys, as seen by the tracker.
+// TouchTrackerT and the SensorFrameKernels are templates over one of these, so that all
+// their loop bounds, edge cases and tables are compile-time constants.
+//
+// to support a new surface, add a traits type like this one and instantiate the tracker
+// and kernels for it at the end of TouchTracker.cpp and SensorFrameKernels.cpp.
+struct SoundplaneATrackerTraits
+{
+	typedef SensorFrame Frame;
+
+	static constexpr int width = SensorGeometry::width;
+	static constexpr int height = SensorGeometry::height;
+
+	// box filter passes in each direction done by preprocess(). a lot of filtering is needed
+	// for Soundplane A to make sure peaks are in centers of touches.
+	static constexpr int smoothPassesX = 4;
+	static constexpr int smoothPassesY = 3;
+
+	// width of the tiles that preprocess() can skip when their input is not changing.
+	// tiles are the full height of the surface.
+	static constexpr int tileWidth = 8;
+
+	// sensor x of the centers of the first and last keys, and their key x.
+	static constexpr float sensorMinX = 3.5f;
+	static constexpr float sensorMaxX = 59.5f;
+	static constexpr float keyMinX = 1.f;
+	static constexpr float keyMaxX = 29.f;
+
+	// Soundplane A as measured: piecewise linear map from sensor y to key y.
+	// NOTE: these y locations depend on the amount of smoothing done in preprocess().
+	static constexpr int yMapSize = 6;
+	static constexpr std::array<float, yMapSize> sensorYMap{{0.7, 1.2, 2.7, 4.3, 5.8, 6.3}};
+	static constexpr std::array<float, yMapSize> keyYMap{{0.01, 1., 2., 3., 4., 4.99}};
+
+	// the curvature of in, written to out. out may not be the same frame as in.
+	static void getCurvature(const Frame& in, Frame& out);
+};
@@ -0,0 +1,70 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// TripleBuffer: passes the latest value of T from one writer thread to one reader thread
+// without locks or waiting on either side. The writer fills its buffer and publishes it by
+// swapping it with the middle buffer. The reader takes the middle buffer in the same way
+// when it holds a value newer than its own. Neither side ever touches the other's buffer,
+// so a value is never read while it is being written, and values the reader doesn't get
+// to before the next publish are skipped.
+//
+// Each published value gets the next sequence number, starting from 1, so readers can tell
+// whether anything has changed since they last looked.
+
+template< class T >
+class TripleBuffer
+{
+public:
+	TripleBuffer() {}
+	~TripleBuffer() {}
+
+	// writer: fill the buffer returned here, then publish it.
+	T& getWriteBuffer() { return mBuffers[mWriteIndex].value; }
+
+	void publish()
+	{
+		mBuffers[mWriteIndex].sequence = ++mWriteSequence;
+		int previous = mMiddle.exchange(mWriteIndex | kFreshBit, std::memory_order_acq_rel);
+		mWriteIndex = previous & kIndexMask;
+	}
+
+	// reader: take the most recently published value, if there is a new one. Returns true
+	// if the read buffer changed.
+	bool update()
+	{
+		if(!(mMiddle.load(std::memory_order_relaxed) & kFreshBit)) return false;
+		int previous = mMiddle.exchange(mReadIndex, std::memory_order_acq_rel);
+		mReadIndex = previous & kIndexMask;
+		return true;
+	}
+
+	// the value taken by the last update(), or T() before anything is published.
+	const T& getReadBuffer() const { return mBuffers[mReadIndex].value; }
+
+	// the sequence number of the read buffer, or 0 before anything is published.
+	uint64_t getReadSequence() const { return mBuffers[mReadIndex].sequence; }
+
+private:
+	static constexpr int kIndexMask = 3;
+	static constexpr int kFreshBit = 4;
+
+	struct Slot
+	{
+		T value{};
+		uint64_t sequence{0};
+	};
+
+	Slot mBuffers[3];
+
+	// owned by the writer and the reader, and shared, respectively.
+	int mWriteIndex{0};
+	int mReadIndex{1};
+	std::atomic<int> mMiddle{2};
+	uint64_t mWriteSequence{0};
+};
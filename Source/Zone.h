@@ -64,7 +64,7 @@ const int kZoneValArraySize = 8;
 
 class Zone
 {
-	friend class SoundplaneModel;
+	friend class ZoneSet;
 	
 public:
 	Zone();
@@ -0,0 +1,275 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "ZoneSet.h"
+
+#include <bitset>
+#include <iostream>
+
+ZoneSet::ZoneSet() :
+mZoneIndexMap(kSoundplaneAKeyWidth, kSoundplaneAKeyHeight)
+{
+	for(int i=0; i<kMaxTouches; ++i)
+	{
+		mCurrentKeyX[i] = -1;
+		mCurrentKeyY[i] = -1;
+	}
+	clear();
+}
+
+// remove all zones from the zone list.
+void ZoneSet::clear()
+{
+	mZones.clear();
+	mZoneIndexMap.fill(-1);
+}
+
+bool ZoneSet::loadFromString(const std::string& zoneStr)
+{
+	clear();
+	cJSON* root = cJSON_Parse(zoneStr.c_str());
+	if(!root)
+	{
+		MLConsole() << "zone file parse failed!\n";
+		const char* errStr = cJSON_GetErrorPtr();
+		MLConsole() << "    error at: " << errStr << "\n";
+		return false;
+	}
+	cJSON* pNode = root->child;
+	while(pNode)
+	{
+		if(!strcmp(pNode->string, "zone"))
+		{
+			mZones.emplace_back(Zone());
+			Zone* pz = &mZones.back();
+			
+			cJSON* pZoneType = cJSON_GetObjectItem(pNode, "type");
+			if(pZoneType)
+			{
+				// get zone type and type specific attributes
+				pz->mType = pZoneType->valuestring;
+			}
+			else
+			{
+				MLConsole() << "No type for zone!\n";
+			}
+			
+			// get zone rect in keys
+			cJSON* pZoneRect = cJSON_GetObjectItem(pNode, "rect");
+			if(pZoneRect)
+			{
+				int size = cJSON_GetArraySize(pZoneRect);
+				if(size == 4)
+				{
+					int x = cJSON_GetArrayItem(pZoneRect, 0)->valueint;
+					int y = cJSON_GetArrayItem(pZoneRect, 1)->valueint;
+					int w = cJSON_GetArrayItem(pZoneRect, 2)->valueint;
+					int h = cJSON_GetArrayItem(pZoneRect, 3)->valueint;
+					pz->setBounds(MLRect(x, y, w, h));
+				}
+				else
+				{
+					MLConsole() << "Bad rect for zone!\n";
+				}
+			}
+			else
+			{
+				MLConsole() << "No rect for zone\n";
+			}
+			
+			pz->mName = TextFragment(getJSONString(pNode, "name"));
+			pz->mStartNote = getJSONInt(pNode, "note");
+			pz->mOffset = getJSONInt(pNode, "offset");
+			pz->mControllerNum1 = getJSONInt(pNode, "ctrl1");
+			pz->mControllerNum2 = getJSONInt(pNode, "ctrl2");
+			pz->mControllerNum3 = getJSONInt(pNode, "ctrl3");
+			
+			int zoneIdx = mZones.size() - 1;
+			if(zoneIdx < kSoundplaneAMaxZones)
+			{
+				pz->setZoneID(zoneIdx);
+				
+				MLRect b(pz->getBounds());
+				int x = b.x();
+				int y = b.y();
+				int w = b.width();
+				int h = b.height();
+				
+				for(int j=y; j < y + h; ++j)
+				{
+					for(int i=x; i < x + w; ++i)
+					{
+						mZoneIndexMap(i, j) = zoneIdx;
+					}
+				}
+			}
+			else
+			{
+				MLConsole() << "ZoneSet::loadFromString: out of zones!\n";
+			}
+		}
+		pNode = pNode->next;
+	}
+	cJSON_Delete(root);
+	return true;
+}
+
+void ZoneSet::setParameters(float vibrato, float hysteresis, bool quantize, bool noteLock, int transpose, float snapFreq)
+{
+	for(auto& zone : mZones)
+	{
+		zone.mVibrato = vibrato;
+		zone.mHysteresis = hysteresis;
+		zone.mQuantize = quantize;
+		zone.mNoteLock = noteLock;
+		zone.mTranspose = transpose;
+		zone.setSnapFreq(snapFreq);
+	}
+}
+
+// send raw touches to zones in order to generate touch and controller states within the Zones.
+//
+void ZoneSet::processTouches(const TouchArray& touches, float hysteresis)
+{
+	// clear incoming touches and push touch history in each zone
+	for(auto& zone : mZones)
+	{
+		zone.newFrame();
+	}
+	
+	// add any active touches to the Zones they are over
+	// MLTEST for(int i=0; i<maxTouches; ++i)
+	
+	// iterate on all possible touches so touches will turn off when max_touches is lowered
+	for(int i=0; i<kMaxTouches; ++i)
+	{
+		float x = touches[i].x;
+		float y = touches[i].y;
+		
+		if(touchIsActive(touches[i]))
+		{
+			//std::cout << i << ":" << age << "\n";
+			// get fractional key grid position (Soundplane A)
+			Vec2 keyXY (x, y);
+			
+			// get integer key
+			int ix = (int)x;
+			int iy = (int)y;
+			
+			// apply hysteresis to raw position to get current key
+			// hysteresis: make it harder to move out of current key
+			if(touches[i].state == kTouchStateOn)
+			{
+				mCurrentKeyX[i] = ix;
+				mCurrentKeyY[i] = iy;
+			}
+			else
+			{
+				float hystWidth = hysteresis*0.25f;
+				MLRect currentKeyRect(mCurrentKeyX[i], mCurrentKeyY[i], 1, 1);
+				currentKeyRect.expand(hystWidth);
+				if(!currentKeyRect.contains(keyXY))
+				{
+					mCurrentKeyX[i] = ix;
+					mCurrentKeyY[i] = iy;
+				}
+			}
+			
+			// send index, xyz, dz to zone
+			int zoneIdx = mZoneIndexMap(mCurrentKeyX[i], mCurrentKeyY[i]);
+			if((zoneIdx >= 0) && (zoneIdx < mZones.size()))
+			{
+				Touch t = touches[i];
+				t.kx = mCurrentKeyX[i];
+				t.ky = mCurrentKeyY[i];
+				mZones[zoneIdx].addTouchToFrame(i, t);
+			}
+		}
+	}
+	
+	for(auto& zone : mZones)
+	{
+		zone.storeAnyNewTouches();
+	}
+	
+	std::bitset<kMaxTouches> freedTouches;
+	
+	// process note offs for each zone
+	// this happens before processTouches() to allow touches to be freed for reuse in this frame
+	for(auto& zone : mZones)
+	{
+		zone.processTouchesNoteOffs(freedTouches);
+	}
+	
+	// process touches for each zone
+	for(auto& zone : mZones)
+	{
+		zone.processTouches(freedTouches);
+	}
+}
+
+void ZoneSet::sendToOutput(SoundplaneOutput& output) const
+{
+	for(const auto& zone : mZones)
+	{
+		// touches
+		for(int i=0; i<kMaxTouches; ++i)
+		{
+			const Touch& t = zone.mOutputTouches[i];
+			if(touchIsActive(t))
+			{
+				output.processTouch(i, zone.mOffset, t);
+			}
+		}
+		
+		// controllers
+		if(isControllerZoneType(zone.mType))
+		{
+			output.processController(zone.mZoneID, zone.mOffset, zone.mOutputController);
+		}
+	}
+}
+
+void ZoneSet::dumpOutputs() const
+{
+	// count touches in zones
+	int activeTouches = 0;
+	for(const auto& zone : mZones)
+	{
+		// touches
+		for(int i=0; i<kMaxTouches; ++i)
+		{
+			Touch t = zone.mOutputTouches[i];
+			if(touchIsActive(t))
+			{
+				activeTouches++;
+			}
+		}
+	}
+	
+	if(activeTouches)
+	{
+		int zc = 0;
+		
+		// send messages to outputs about each zone
+		for(const auto& zone : mZones)
+		{
+			
+			std::cout << "[zone " << zc++ << ": ";
+			
+			// touches
+			for(int i=0; i<kMaxTouches; ++i)
+			{
+				Touch t = zone.mOutputTouches[i];
+				if(touchIsActive(t))
+				{
+					std::cout << i << ":" << t.state << ":" << t.z << " ";
+				}
+			}
+
+			std::cout << "]";
+		}
+		std::cout << "\n";
+	}
+}
@@ -0,0 +1,50 @@
+// Part of the Soundplane client software by Madrona Labs.
+// Copyright (c) 2013 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include "Zone.h"
+#include "SoundplaneOutput.h"
+
+// ZoneSet: the zones of one instrument, and the routing of touches to them.
+// Kept apart from the Model so that the tracking pipeline can be run without it.
+
+class ZoneSet
+{
+public:
+	ZoneSet();
+	~ZoneSet() {}
+
+	// remove all zones.
+	void clear();
+
+	// load zones from a zone preset in JSON. On failure there are no zones.
+	bool loadFromString(const std::string& zoneStr);
+
+	void setParameters(float vibrato, float hysteresis, bool quantize, bool noteLock, int transpose, float snapFreq);
+
+	// send raw touches to zones in order to generate touch and controller states within the Zones.
+	void processTouches(const TouchArray& touches, float hysteresis);
+
+	// send the current touch and controller states of each zone to the output.
+	void sendToOutput(SoundplaneOutput& output) const;
+
+	// print the active touches in each zone.
+	void dumpOutputs() const;
+
+	size_t size() const { return mZones.size(); }
+	std::vector< Zone >::const_iterator begin() const { return mZones.begin(); }
+	std::vector< Zone >::const_iterator end() const { return mZones.end(); }
+
+private:
+	std::vector< Zone > mZones;
+	ml::Matrix mZoneIndexMap;
+
+	// store current key for each touch to implement hysteresis.
+	int mCurrentKeyX[kMaxTouches];
+	int mCurrentKeyY[kMaxTouches];
+};